@@ -19,6 +19,7 @@
 #include "pmm.h"
 #include "slab.h"
 #include "task.h"
+#include "sync.h"
 #include "kmachine.h"
 
 IKernel api;
@@ -26,17 +27,34 @@ IKernel api;
 void api_init() {
     api.mem_alloc = pmm_alloc;
     api.mem_free = pmm_free;
-    api.alloc_sys_object = slab_alloc_c;
-    api.free_sys_object = slab_free_c;
+    api.alloc_sys_object = slab_object_alloc_c;
+    api.free_sys_object = slab_object_free_c;
     api.task_current = task_current;
     api.task_init = task_new;
     api.task_schedule = task_schedule;
+    api.task_sleep = task_sleep;
+    api.task_idle = task_idle;
     api.task_signal = task_signal;
     api.task_wait = task_wait;
+    api.task_wait_timeout = task_wait_timeout;
+    api.task_get_stats = task_get_stats;
+    api.sched_trace_read = sched_trace_read;
+    api.task_dump_stats = task_dump_stats;
+    api.sched_trace_dump = sched_trace_dump;
+    api.semaphore_init = semaphore_init;
+    api.semaphore_wait = semaphore_wait;
+    api.semaphore_signal = semaphore_signal;
+    api.mutex_init = mutex_init;
+    api.mutex_lock = mutex_lock;
+    api.mutex_unlock = mutex_unlock;
+    api.port_init = port_init;
+    api.port_put = port_put;
+    api.port_get = port_get;
     api.enable_interrupts = enable_interrupts;
     api.disable_interrupts = disable_interrupts;
     api.register_irq = irq_register_c;
     api.remove_irq = irq_remove_c;
+    api.irq_hits = irq_hits_c;
     api.list_init = list_init_c;
     api.list_add_head = list_add_head_c;
     api.list_delete_head = list_delete_head_c;
@@ -0,0 +1,112 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * The idle task, and tickless idle.
+ *
+ * Built with -DTICKLESS_IDLE, when a tick finds nothing but the
+ * idle task to run, the DUART counter is set to interrupt when
+ * the timer wheel next needs a tick (up to TICKLESS_MAX_TICKS
+ * away) rather than every tick. The interrupt that ends that is
+ * counted as all the ticks it covered, and the counter goes back
+ * to one tick per interrupt.
+ *
+ * Both changes are made in the tick interrupt, just after the
+ * counter has wrapped, and restart it - so all that's lost is
+ * the few microseconds the handler took to get there.
+ *
+ * If an interrupt wakes a task in the meantime, it runs right
+ * away, but isn't preempted (and new timeouts don't fire) until
+ * the long tick ends. TICKLESS_MAX_TICKS trades that off against
+ * the ticks saved.
+ *
+ * This is only for r2.x boards, where the system tick is the
+ * DUART counter / timer.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdnoreturn.h>
+#include <stddef.h>
+
+#include "kmachine.h"
+#include "task.h"
+#include "timer.h"
+
+extern uint8_t runnable_mask;
+
+noreturn void task_idle(void) {
+    for (;;) {
+        disable_interrupts();
+
+        if (runnable_mask) {
+            // Something was woken by an interrupt - no need to
+            // wait for the tick to run it
+            task_yield();
+            enable_interrupts();
+        } else {
+            cpu_idle();
+        }
+    }
+}
+
+#ifdef TICKLESS_IDLE
+#define SDB_UPTICKS         ((volatile uint32_t*)0x40c)
+#define SDB_UARTBASE        ((volatile uint8_t**)0x418)
+
+// DUART registers (r2.x), as offsets from the base in the SDB
+#define DUART_CTUR          0x0c
+#define DUART_CTLR          0x0e
+#define DUART_START         0x1c        // Read to restart the counter
+
+// Counter preload for one tick - 3686400 / 16 / (1152 * 2) = 100Hz
+#define TICK_PRELOAD        1152
+
+// The most ticks the (16-bit) counter can cover
+#define TICKLESS_MAX_TICKS  56
+
+static uint8_t tickless_ticks;          // Ticks the counter is set for, zero if just one
+
+static void set_tick_period(uint16_t ticks) {
+    volatile uint8_t *duart = *SDB_UARTBASE;
+
+    // ticks * 1152, without needing a library multiply
+    uint16_t preload = (ticks << 10) + (ticks << 7);
+
+    duart[DUART_CTUR] = preload >> 8;
+    duart[DUART_CTLR] = preload & 0xff;
+    (void)duart[DUART_START];
+}
+
+uint32_t tickless_elapsed(void) {
+    uint32_t ticks = tickless_ticks;
+
+    if (ticks == 0) {
+        return 1;
+    }
+
+    tickless_ticks = 0;
+    set_tick_period(1);
+
+    // The firmware only counted one of them
+    *SDB_UPTICKS += ticks - 1;
+
+    return ticks;
+}
+
+void tickless_enter(void) {
+    uint32_t ticks = timer_next(TICKLESS_MAX_TICKS);
+
+    if (ticks > 1) {
+        tickless_ticks = ticks;
+        set_tick_period(ticks);
+    }
+}
+#endif
@@ -22,6 +22,7 @@
 
 #include "list.h"
 #include "task.h"
+#include "sync.h"
 #include "kmachine.h"
 
 #define KERNEL_API_ADDRESS      0x400
@@ -36,14 +37,34 @@ typedef Task*       (*task_current_f)(void);
 typedef void        (*task_init_f)(Task*, tid_t, priority_t);
 typedef void        (*task_schedule_f)(Task*, uintptr_t, uintptr_t, task_handler_f);
 
+typedef void        (*task_sleep_f)(uint32_t);
+typedef void        (*task_idle_f)(void);
+
 typedef signals_t   (*task_wait_f)(signals_t);
+typedef signals_t   (*task_wait_timeout_f)(signals_t, uint32_t);
 typedef void        (*task_signal_f)(Task*, signals_t);
 
+typedef void        (*task_get_stats_f)(Task*, TaskStats*);
+typedef uint32_t    (*sched_trace_read_f)(SchedTraceEvent*, uint32_t);
+typedef void        (*task_dump_stats_f)(Task*);
+typedef void        (*sched_trace_dump_f)(void);
+
+typedef void        (*semaphore_init_f)(Semaphore*, int32_t);
+typedef void        (*semaphore_wait_f)(Semaphore*);
+typedef void        (*semaphore_signal_f)(Semaphore*);
+typedef void        (*mutex_init_f)(Mutex*);
+typedef void        (*mutex_lock_f)(Mutex*);
+typedef void        (*mutex_unlock_f)(Mutex*);
+typedef Port*       (*port_init_f)(Port*, void**, uint32_t);
+typedef void        (*port_put_f)(Port*, void*);
+typedef void*       (*port_get_f)(Port*);
+
 typedef void        (*enable_interrupts_f)(void);
 typedef void        (*disable_interrupts_f)(void);
 
-typedef void        (*register_irq_f)(uint8_t, IrqHandler*);
+typedef bool        (*register_irq_f)(uint8_t, IrqHandler*);
 typedef void        (*remove_irq_f)(IrqHandler*);
+typedef uint32_t    (*irq_hits_f)(IrqHandler*);
 
 typedef List*       (*list_init_f)(List*);
 typedef ListNode*   (*list_add_head_f)(List*, ListNode*);
@@ -97,6 +118,36 @@ typedef struct {
 
     // start doing the thing
     start_f                     start;
+
+    // Programs index this table by offset, so new entries only ever
+    // go on the end, after everything that's already here.
+
+    // Sleeping / timeouts
+    task_sleep_f                task_sleep;
+    task_wait_timeout_f         task_wait_timeout;
+
+    // Synchronisation
+    semaphore_init_f            semaphore_init;
+    semaphore_wait_f            semaphore_wait;
+    semaphore_signal_f          semaphore_signal;
+    mutex_init_f                mutex_init;
+    mutex_lock_f                mutex_lock;
+    mutex_unlock_f              mutex_unlock;
+    port_init_f                 port_init;
+    port_put_f                  port_put;
+    port_get_f                  port_get;
+
+    // Statistics / tracing
+    task_get_stats_f            task_get_stats;
+    sched_trace_read_f          sched_trace_read;
+    task_dump_stats_f           task_dump_stats;
+    sched_trace_dump_f          sched_trace_dump;
+
+    // Idle
+    task_idle_f                 task_idle;
+
+    // Interrupt statistics
+    irq_hits_f                  irq_hits;
 } IKernel;
 
 static inline IKernel* get_kernel_api() {
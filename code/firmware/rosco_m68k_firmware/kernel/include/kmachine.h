@@ -22,13 +22,33 @@
 typedef bool        (*interrupt_service_f)(uint8_t, void*);
 
 typedef struct {
-    void*                   next;
-    void*                   prev;
+    void*                   next;       // Not used - the kernel keeps its
+    void*                   prev;       // own node for each handler
     void*                   data;
     interrupt_service_f     handler;    
 } IrqHandler;
 
+// Handlers can be registered for IRQs 1-7, or for these vectors
+#define IRQ_VECTOR_FIRST    0x40
+#define IRQ_VECTOR_COUNT    64
+
+// The most handlers that can be registered at once
+#define IRQ_MAX_HANDLERS    32
+
 #ifdef ROSCO_M68K_KERNEL_BUILD
+/**
+ * What's actually on the handler lists - one for each registered
+ * handler, from a pool in the kernel (so the caller's IrqHandler 
+ * is only ever read).
+ */
+typedef struct {
+    void*                   next;
+    void*                   prev;
+    IrqHandler*             handler;    // NULL if the node is free
+    uint32_t                hits;       // Times the handler claimed an interrupt
+    uint32_t                vec;        // Its vector, or 0 if it's on an IRQ level
+} IrqNode;
+
 noreturn void halt(void);
 
 noreturn void halt_and_catch_fire(void);
@@ -37,12 +57,44 @@ void disable_interrupts(void);
 
 void enable_interrupts(void);
 
+/**
+ * Enable interrupts, and stop the CPU until one comes in.
+ * 
+ * **Must** be called with interrupts disabled (once, not nested).
+ */
+void cpu_idle(void);
+
 void irq_init(void);
 
-void irq_register_c(uint8_t vec, IrqHandler *handler);
+/**
+ * Register an interrupt handler, at the tail of its chain.
+ * 
+ * For IRQs 1-7, the handler is on that level's chain, and is 
+ * tried for any interrupt at that level. For vectors (from 
+ * IRQ_VECTOR_FIRST), it's only tried for that vector - and 
+ * if nothing on the vector claims an interrupt, the level's
+ * chain is tried, and then whatever was on the vector before.
+ * 
+ * The handler that claims an interrupt moves to the front of
+ * its chain, so the busiest ones are tried first.
+ * 
+ * Nothing is registered if IRQ_MAX_HANDLERS already are.
+ * 
+ * @param vec The IRQ (1-7) or vector number
+ * @param handler The handler
+ * @return true if it was registered, false if `vec` is out of
+ *         range, `handler` is NULL, or there's no room for it
+ */
+bool irq_register_c(uint8_t vec, IrqHandler *handler);
 
 void irq_remove_c(IrqHandler *handler);
 
+/**
+ * Get the number of interrupts a handler has claimed since it
+ * was registered (zero if it isn't registered).
+ */
+uint32_t irq_hits_c(IrqHandler *handler);
+
 #endif//ROSCO_M68K_KERNEL_BUILD
 
 #endif//_ROSCOM68K_KERNEL_MACHINE_H
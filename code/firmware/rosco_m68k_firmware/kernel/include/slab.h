@@ -18,6 +18,14 @@
  * chunk, it supports efficient allocation / deallocation
  * of contiguous chunks.
  * 
+ * On top of that there are slab caches, which hand out
+ * fixed-size objects (16 - 256 bytes) from slabs dedicated
+ * to that size. Each cache keeps its own partial list, so
+ * the slab at the head always has room and allocation is
+ * a single bitmap search. Slabs that become empty are kept
+ * around for reuse, up to SLAB_CACHE_MAX_EMPTY per cache,
+ * and are only returned to pmm when it runs short.
+ * 
  * **Note**: The implementation of this is built around pmm
  * managing 1KiB pages - if that should change, this will
  * need some work too!
@@ -37,15 +45,35 @@
 // Get a pointer to the slab metadata given an arbitrary slab address
 #define slab_metadata(addr) (( ((Slab*)slab_base(addr)) + 31 ))
 
+#define SLAB_CACHE_COUNT        5   // Standard caches, for 16, 32, 64, 128 & 256 bytes
+#define SLAB_CACHE_MAX_EMPTY    1   // Empty slabs each cache holds on to
+#define SLAB_OBJECT_MAX_BLOCKS  8   // Biggest sys object (in blocks) that comes from a cache
+
+struct _SlabCache;
+
 typedef volatile struct {
     ListNode            node;
     uint32_t            base_addr;
     uint32_t            bitmap;
-    uint32_t            pad[2];
+    uint32_t            bitmap_hi;      // Objects 32-63 (16-byte caches only)
+    struct _SlabCache   *cache;         // Owning cache, or NULL for block slabs
 } Slab;
 
+typedef volatile struct _SlabCache {
+    List                partial;        // Slabs with at least one free object
+    List                full;
+    List                empty;          // Completely free, kept for reuse
+    uint32_t            object_size;
+    uint32_t            object_shift;
+    uint32_t            init_bitmap;    // Bitmaps for a fresh slab (metadata
+    uint32_t            init_bitmap_hi; // and non-existent objects set)
+    uint32_t            empty_count;
+} SlabCache;
+
+extern SlabCache slab_caches[SLAB_CACHE_COUNT];
+
 /**
- * Initialise the slab system.
+ * Initialise the slab system, including the standard caches.
  * 
  * **Must** be called before it is used!
  */
@@ -68,9 +96,8 @@ void*   slab_alloc_c(uint8_t block_count);
  * Will free the blocks, and where this results in slabs becoming
  * empty, they will also have their physical memory freed.
  * 
- * TODO it's probably worth having some option to keep slabs 
- * around (not free their phys mem) until memory pressure demands
- * it, especially for oft-created-and-destroyed structs 🤔
+ * (Oft-created-and-destroyed structs should use a slab cache
+ * instead, which keeps empty slabs around.)
  * 
  * @param addr base address of first block
  * @param block_count number of blocks (max 31)
@@ -78,4 +105,83 @@ void*   slab_alloc_c(uint8_t block_count);
  */
 void    slab_free_c(void* addr, uint8_t block_count);
 
+/**
+ * Initialise a slab cache for objects of `object_size` bytes.
+ * 
+ * @param cache the cache to initialise
+ * @param object_size one of 16, 32, 64, 128 or 256
+ * @return SlabCache* the cache, or NULL if the size isn't supported
+ */
+SlabCache* slab_cache_init_c(SlabCache *cache, uint32_t object_size);
+
+/**
+ * Find the smallest standard cache whose objects are at least
+ * `size` bytes.
+ * 
+ * @param size required object size
+ * @return SlabCache* the cache, or NULL if size is over 256
+ */
+SlabCache* slab_cache_for_c(uint32_t size);
+
+/**
+ * Allocate an object from the given cache.
+ * 
+ * Takes the first free object in the slab at the head of the
+ * cache's partial list, reusing an empty slab (or allocating a
+ * new one) only when there are no partial slabs.
+ * 
+ * If pmm is out of memory, empty slabs held by all the standard
+ * caches are released and the allocation retried.
+ * 
+ * @param cache the cache to allocate from
+ * @return void* Pointer to the object, or NULL on failure
+ */
+void*   slab_cache_alloc_c(SlabCache *cache);
+
+/**
+ * Free an object allocated from a slab cache.
+ * 
+ * The cache is found from the slab metadata. A slab that becomes
+ * empty is kept on the cache's empty list, unless the cache already
+ * has SLAB_CACHE_MAX_EMPTY of those, when it's returned to pmm.
+ * 
+ * @param object the object to free
+ */
+void    slab_cache_free_c(void *object);
+
+/**
+ * Return all of a cache's empty slabs to pmm.
+ * 
+ * @param cache the cache to reap
+ * @return uint32_t the number of slabs released
+ */
+uint32_t slab_cache_reap_c(SlabCache *cache);
+
+/**
+ * Return the empty slabs held by all the standard caches to pmm.
+ * 
+ * @return uint32_t the number of slabs released
+ */
+uint32_t slab_reap_c(void);
+
+/**
+ * Allocate a system object of `block_count` 32-byte blocks.
+ * 
+ * Objects of up to SLAB_OBJECT_MAX_BLOCKS blocks come from the
+ * standard caches (rounded up to a power of two), bigger ones
+ * from `slab_alloc_c`.
+ * 
+ * @param block_count number of blocks (max 31)
+ * @return void* Pointer to the object, or NULL on failure
+ */
+void*   slab_object_alloc_c(uint8_t block_count);
+
+/**
+ * Free a system object allocated with `slab_object_alloc_c`.
+ * 
+ * @param addr the object
+ * @param block_count number of blocks it was allocated with
+ */
+void    slab_object_free_c(void* addr, uint8_t block_count);
+
 #endif//_ROSCOM68K_KERNEL_SLAB_H
@@ -0,0 +1,140 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Synchronisation - semaphores, mutexes and message ports.
+ * ------------------------------------------------------------
+ */
+#ifndef _ROSCOM68K_KERNEL_SYNC_H
+#define _ROSCOM68K_KERNEL_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "list.h"
+#include "task.h"
+
+/**
+ * A counting semaphore.
+ *
+ * The count is decremented / incremented by a single instruction,
+ * so an uncontended wait or signal doesn't disable interrupts. It
+ * goes negative when tasks are (about to be) waiting.
+ */
+typedef struct {
+    volatile int32_t        count;      // Available, less tasks waiting
+    uint32_t                wakeups;    // Signals that found no task on the queue yet
+    List                    waiters;    // Blocked tasks, highest priority first
+} Semaphore;
+
+/**
+ * A mutex. Tasks waiting for it are woken highest priority first,
+ * and while they wait the owner runs at (at least) their priority.
+ */
+typedef struct {
+    Semaphore               sem;
+    Task*                   owner;
+    priority_t              saved_priority;
+    uint8_t                 boosted;
+    uint8_t                 pad[2];
+} Mutex;
+
+/**
+ * A message port - a fixed-size ring of message pointers. Messages
+ * are not copied, the receiver just gets the pointer that was put.
+ */
+typedef struct {
+    void**                  slots;
+    uint32_t                mask;       // Number of slots, less one
+    uint32_t                head;       // Next to get
+    uint32_t                tail;       // Next to put
+    Semaphore               items;
+    Semaphore               spaces;
+    Semaphore               put_lock;
+    Semaphore               get_lock;
+} Port;
+
+#ifdef ROSCO_M68K_KERNEL_BUILD
+/**
+ * Initialise a semaphore.
+ *
+ * @param sem The semaphore
+ * @param count The initial count
+ */
+void semaphore_init(Semaphore *sem, int32_t count);
+
+/**
+ * Wait on a semaphore - blocks until the count is positive, then
+ * decrements it.
+ *
+ * @param sem The semaphore
+ */
+void semaphore_wait(Semaphore *sem);
+
+/**
+ * Signal a semaphore - increments the count, waking the highest
+ * priority waiting task if there is one.
+ *
+ * Safe to call from interrupt handlers.
+ *
+ * @param sem The semaphore
+ */
+void semaphore_signal(Semaphore *sem);
+
+/**
+ * Initialise a mutex (unlocked).
+ *
+ * @param mutex The mutex
+ */
+void mutex_init(Mutex *mutex);
+
+/**
+ * Lock a mutex, blocking until it's available. Mutexes are **not**
+ * recursive - locking one you already own deadlocks.
+ *
+ * @param mutex The mutex
+ */
+void mutex_lock(Mutex *mutex);
+
+/**
+ * Unlock a mutex. **Must** only be called by the owner.
+ *
+ * @param mutex The mutex
+ */
+void mutex_unlock(Mutex *mutex);
+
+/**
+ * Initialise a message port.
+ *
+ * @param port The port
+ * @param slots Storage for the messages
+ * @param slot_count Number of slots (a power of two)
+ * @return Port* The port, or NULL if slot_count isn't a power of two
+ */
+Port* port_init(Port *port, void **slots, uint32_t slot_count);
+
+/**
+ * Put a message on a port, blocking while it's full.
+ *
+ * @param port The port
+ * @param msg The message
+ */
+void port_put(Port *port, void *msg);
+
+/**
+ * Get the next message from a port, blocking while it's empty.
+ *
+ * @param port The port
+ * @return void* The message
+ */
+void* port_get(Port *port);
+#endif//ROSCO_M68K_KERNEL_BUILD
+
+#endif//_ROSCOM68K_KERNEL_SYNC_H
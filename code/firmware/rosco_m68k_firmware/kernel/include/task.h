@@ -19,6 +19,7 @@
 #include <stdnoreturn.h>
 
 #include "list.h"
+#include "timer.h"
 
 typedef uint32_t signals_t;
 
@@ -28,6 +29,19 @@ typedef void (*task_handler_f)(void);
 
 typedef uint8_t priority_t;
 
+/**
+ * Runtime statistics, kept by the scheduler for each task.
+ *
+ * Times are in ticks (at 100Hz) - multiply by the CPU speed
+ * (in the SDB) over 100 for (approximate) cycles.
+ */
+typedef struct {
+    uint32_t                switches;   // Times switched to
+    uint32_t                ticks;      // Ticks that found it running
+    uint32_t                woken;      // Tick it was last woken, plus one (zero once it's run)
+    uint32_t                max_latency;// Most ticks from wakeup to running
+} TaskStats;
+
 /**
  * A task is an individual thread of execution.
  * 
@@ -40,9 +54,43 @@ typedef struct {
     uint32_t                stack_size;
     uint32_t                stack_bottom;
     priority_t              priority;
-    uint8_t                 pad[3];
+    uint8_t                 state;
+    uint8_t                 pad[2];
+    Timer                   timer;      // Timeout for task_wait_timeout / task_sleep
+    signals_t               sig_pending;// Signals received but not yet waited for
+    TaskStats               stats;
+    void*                   user_data;  // For the task's own use (e.g. its heap), NULL to start
 } Task;
 
+/**
+ * A scheduler trace event - one is recorded in the trace ring
+ * for every task switch.
+ */
+typedef struct {
+    uint32_t                time;       // Tick it happened
+    tid_t                   from;       // Task switched from (SCHED_TRACE_NO_TASK if it exited)
+    tid_t                   to;         // Task switched to
+    uint8_t                 from_state; // State it was left in (or SCHED_TRACE_EXITED)
+    priority_t              to_priority;
+    uint8_t                 pad[2];
+} SchedTraceEvent;
+
+/**
+ * Number of events kept in the trace ring (a power of two).
+ */
+#define SCHED_TRACE_EVENTS  64
+
+#define SCHED_TRACE_NO_TASK 0xFFFFFFFF
+#define SCHED_TRACE_EXITED  0xFF
+
+/**
+ * Task states. The state says which list (if any) a task is on,
+ * so it can be moved without searching for it.
+ */
+#define TASK_STATE_RUNNING  0   // Current task, or not yet scheduled
+#define TASK_STATE_RUNNABLE 1   // On its priority's runnable list
+#define TASK_STATE_WAITING  2   // On the sleeping list, waiting for signals
+
 #ifdef ROSCO_M68K_KERNEL_BUILD
 /**
  * Initialise the task subsystem.
@@ -61,7 +109,7 @@ void task_init(void);
  * Number of slab slots required by a Task structure.
  * 
  */
-#define TASK_SLAB_BLOCKS    2
+#define TASK_SLAB_BLOCKS    3
 
 /**
  * Start the tasking subsystem with the given init task.
@@ -145,23 +193,86 @@ void task_yield(void);
  * Suspend the current task until one or more of the
  * given signals are received.
  * 
+ * If any of them are already pending (i.e. were sent since
+ * the last wait for them) this returns immediately.
+ * 
  * @param sig_mask The mask of signals to wait for
  * @return uint32_t The mask of signals that were actually received
  */
 uint32_t task_wait(uint32_t sig_mask);
 
+/**
+ * Suspend the current task until one or more of the given 
+ * signals are received, or the given number of ticks (at 100Hz)
+ * have passed, whichever comes first.
+ * 
+ * @param sig_mask The mask of signals to wait for
+ * @param ticks The timeout in ticks, or zero to wait forever
+ * @return uint32_t The mask of signals that were actually received (zero on timeout)
+ */
+uint32_t task_wait_timeout(uint32_t sig_mask, uint32_t ticks);
+
+/**
+ * Suspend the current task for the given number of ticks (at 100Hz).
+ * 
+ * The CPU goes to other tasks (or the idle task) in the meantime.
+ * 
+ * @param ticks The number of ticks to sleep (zero is treated as one)
+ */
+void task_sleep(uint32_t ticks);
+
+/**
+ * A ready-made idle task (pass it to start_tasking).
+ * 
+ * Stops the CPU until an interrupt comes in, then runs whatever
+ * that woke - or, with nothing to run, stops again. With 
+ * -DTICKLESS_IDLE, ticks stop too while there's nothing to do.
+ * 
+ * Does not return.
+ */
+noreturn void task_idle(void);
+
 /**
  * Send the given signal(s) to the given task.
  * 
- * Currently, if the given task is not waiting for any of the
- * given signals, nothing will happen (i.e. this does not 
- * function as a generic "interrupt" mechanism right now).
+ * If the given task is not waiting for any of the given 
+ * signals, they are left pending until it next waits for them.
  * 
  * @param task The task to signal
  * @param sig_mask The mask of signals to send.
  */
 void task_signal(Task *task, uint32_t sig_mask);
 
+/**
+ * Get a task's runtime statistics.
+ * 
+ * @param task The task (or NULL for the current task)
+ * @param stats Receives the statistics
+ */
+void task_get_stats(Task *task, TaskStats *stats);
+
+/**
+ * Get the most recent scheduler trace events, oldest first.
+ * 
+ * @param events Receives the events
+ * @param count The most events to get (only the last SCHED_TRACE_EVENTS are kept)
+ * @return uint32_t The number of events actually got
+ */
+uint32_t sched_trace_read(SchedTraceEvent *events, uint32_t count);
+
+/**
+ * Dump a task's statistics to the serial port (as hex).
+ * 
+ * @param task The task (or NULL for the current task)
+ */
+void task_dump_stats(Task *task);
+
+/**
+ * Dump the scheduler trace ring to the serial port (as hex),
+ * oldest first.
+ */
+void sched_trace_dump(void);
+
 
 #ifdef DEBUG_SCHED
 #   include <stdio.h>
@@ -0,0 +1,85 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Kernel timers, driven from the 100Hz system tick.
+ * ------------------------------------------------------------
+ */
+#ifndef _ROSCOM68K_KERNEL_TIMER_H
+#define _ROSCOM68K_KERNEL_TIMER_H
+
+#include <stdint.h>
+
+#include "list.h"
+
+#define NODE_TYPE_TIMER     0x300
+
+// Longest timeout, in ticks (a little over 46 hours) - longer ones are clamped
+#define TIMER_MAX_TICKS     0x00ffffff
+
+struct _Timer;
+
+typedef void (*timer_handler_f)(volatile struct _Timer *timer);
+
+/**
+ * A Timer calls its handler once, from the tick handler (so
+ * with interrupts disabled), when it expires.
+ * 
+ * The node's next pointer is NULL when it isn't armed.
+ */
+typedef volatile struct _Timer {
+    ListNode            node;
+    uint32_t            expires;        // Tick count it fires at
+    timer_handler_f     handler;
+} Timer;
+
+#ifdef ROSCO_M68K_KERNEL_BUILD
+/**
+ * Initialise the timer wheel.
+ * 
+ * **Must** be called before it is used!
+ */
+void timer_init(void);
+
+/**
+ * Arm a timer to fire after the given number of ticks. The handler
+ * must already be set. If the timer is already armed, it's re-armed.
+ * 
+ * @param timer The timer
+ * @param ticks Ticks from now (1 - TIMER_MAX_TICKS, zero means one)
+ */
+void timer_add(Timer *timer, uint32_t ticks);
+
+/**
+ * Disarm a timer. Does nothing if it isn't armed.
+ * 
+ * @param timer The timer
+ */
+void timer_cancel(Timer *timer);
+
+/**
+ * Find how many ticks until the wheel next has anything to do (a
+ * timer might expire, or a level needs bringing down).
+ * 
+ * Only looks as far as the next cascade (at most 64 ticks).
+ * 
+ * @param limit The most ticks to look ahead
+ * @return uint32_t Ticks until the next tick that matters, or limit if none sooner
+ */
+uint32_t timer_next(uint32_t limit);
+
+/**
+ * Advance the wheel by one tick, and call the handlers of any timers
+ * that expire. Called from the tick handler.
+ */
+void timer_tick(void);
+#endif//ROSCO_M68K_KERNEL_BUILD
+
+#endif//_ROSCOM68K_KERNEL_TIMER_H
@@ -19,6 +19,15 @@ IRQ_PREV   equ     $04                    ; values in list.h!
 IRQ_DATA   equ     $08
 IRQ_FUNC   equ     $0C
 
+IRQ_NODE_HANDLER  equ   $08               ; Kernel-private handler nodes, which
+IRQ_NODE_HITS     equ   $0C               ; are what's actually on the lists
+IRQ_NODE_VECTOR   equ   $10               ; (see IrqNode in kmachine.h)
+IRQ_NODE_SIZE     equ   $14
+IRQ_MAX_HANDLERS  equ   32                ; Also in kmachine.h
+
+IRQ_VECTOR_FIRST  equ   $40               ; Also in kmachine.h
+IRQ_VECTOR_COUNT  equ   64
+
 VEC_IRQ1    equ     $64
 VEC_IRQ2    equ     $68
 VEC_IRQ3    equ     $6C
@@ -38,6 +47,18 @@ halt_and_catch_fire::
   bra       halt_and_catch_fire
 
 
+; Re-enable interrupts and stop until one arrives. The stop 
+; does both at once, so one that comes in between can't be 
+; missed (and leave us stopped waiting for the next).
+;
+; **must** be called with interrupts disabled exactly once.
+;
+cpu_idle::
+  subq.w    #1,disable_intr_count         ; Enabled as far as the count goes...
+  stop      #$2000                        ; ... and now for real
+  rts
+
+
 disable_interrupts::
   or.w      #$0700,sr                     ; Disable interrupts before anything else
 
@@ -98,6 +119,20 @@ irq_init::
   move.l    #irq_7_list,a0
   bsr       list_init
 
+  move.l    #irq_vector_lists,a0          ; And the vector lists
+  move.l    #IRQ_VECTOR_COUNT-1,d0
+.init_vector:
+  bsr       list_init
+  add.l     #12,a0
+  dbra      d0,.init_vector
+
+  move.l    #irq_nodes,a0                 ; And free all the handler nodes
+  move.l    #IRQ_MAX_HANDLERS-1,d0
+.init_node:
+  clr.l     IRQ_NODE_HANDLER(a0)
+  add.l     #IRQ_NODE_SIZE,a0
+  dbra      d0,.init_node
+
   move.l    SDB_CPUINFO,d0                ; Get CPU info from SDB
   lsr.l     #8,d0                         ; Just the CPU model bits
   lsr.l     #8,d0
@@ -115,6 +150,8 @@ irq_init::
   move.l    #$0,a0                        ; Is a 68000, vector base is at $0
 
 .install_handlers:
+  move.l    a0,vector_base                ; Keep VBR for vector handlers
+
   bsr       disable_interrupts            ; Ensure no interrupts for a sec
   move.l    VEC_IRQ1,old_irq1             ; Install the handlers
   move.l    #irq_1,VEC_IRQ1(a0)
@@ -254,34 +291,100 @@ irq_7:
   rte
 
 
-; void irq_register_c(uint8_t vec, IrqHandler* handler);
+; bool irq_register_c(uint8_t vec, IrqHandler* handler);
 irq_register_c::
   move.l    4(a7),d0                      ; Vector in d0
   move.l    8(a7),a1                      ; Handler struct pointer in a1
 
 ; Arguments:
-;   d0    - IRQ number (1..7)
+;   d0    - IRQ number (1..7), or vector number (IRQ_VECTOR_FIRST and up)
 ;   a1    - IrqHandler struct pointer
 ;
 ; Modifies:
-;   d0    - trashed
+;   d0    - 1 if registered, 0 if not (and Z set to match)
 ;   a1    - trashed
 ;
+; The handler goes on the list in one of the kernel's own nodes, so 
+; its struct is never written. It isn't registered if the number is
+; out of range, the handler is NULL, or all IRQ_MAX_HANDLERS nodes
+; are in use.
+;
 irq_register::
   move.l    a0,-(a7)                      ; Save regs
 
+  cmp.l     #$0,a1                        ; Refuse a NULL handler
+  beq       .fail
+
+  cmp.l     #IRQ_VECTOR_FIRST,d0          ; Is it a vector rather than an IRQ?
+  bhs       .vector
+
+  tst.l     d0                            ; Refuse anything that isn't IRQ 1-7
+  beq       .fail
+  cmp.l     #7,d0
+  bhi       .fail
+
   subq.l    #1,d0                         ; Make IRQ 0-based
   mulu.w    #12,d0                        ; Multiply by 12 (bytes in a List struct)
   move.l    #irq_1_list,a0                ; Get the base address of irq 1 list
   add.l     d0,a0                         ; And add d0 to get to our target list
 
   bsr       disable_interrupts
-  bsr       list_add_tail                 ; Add this handler to the tail
+  bsr       irq_node_alloc                ; Get a node for this handler...
+  cmp.l     #$0,a1
+  beq       .full
+  clr.l     IRQ_NODE_VECTOR(a1)           ; (not on a vector)
+  bsr       list_add_tail                 ; ... and add it to the tail
   bsr       enable_interrupts
 
-  move.l    (a7)+,a0                      ; And we're done..
+.ok:
+  moveq.l   #1,d0                         ; Registered
+  move.l    (a7)+,a0
+  rts
+
+.full:
+  bsr       enable_interrupts
+
+.fail:
+  moveq.l   #0,d0                         ; Not registered
+  move.l    (a7)+,a0
   rts
 
+.vector:
+  sub.l     #IRQ_VECTOR_FIRST,d0          ; Make vector 0-based
+  cmp.l     #IRQ_VECTOR_COUNT,d0          ; Refuse it if out of range
+  bhs       .fail
+
+  bsr       disable_interrupts
+  bsr       irq_node_alloc                ; Get a node for the handler first,
+  cmp.l     #$0,a1                        ; so nothing's installed if there isn't one
+  beq       .full
+  move.l    d0,IRQ_NODE_VECTOR(a1)        ; Note the vector, for irq_remove
+  add.l     #IRQ_VECTOR_FIRST,IRQ_NODE_VECTOR(a1)
+
+  movem.l   d0-d1/a2,-(a7)
+  lsl.l     #2,d0                         ; Index the stubs (four bytes each)...
+  move.l    #vector_stubs,a0
+  add.l     d0,a0                         ; ... to get this vector's stub
+  move.l    vector_base,a2
+  add.l     #IRQ_VECTOR_FIRST*4,a2
+  add.l     d0,a2                         ; ... and its slot in the vector table
+
+  cmp.l     (a2),a0                       ; Already installed?
+  beq       .installed
+  move.l    #old_vectors,d1               ; Not yet - keep the current handler to chain to...
+  exg       d1,a0
+  move.l    (a2),(a0,d0.l)
+  move.l    d1,(a2)                       ; ... and install the stub
+
+.installed:
+  movem.l   (a7)+,d0-d1/a2
+  mulu.w    #12,d0                        ; Multiply by 12 (bytes in a List struct)
+  move.l    #irq_vector_lists,a0
+  add.l     d0,a0                         ; Get this vector's list
+  bsr       list_add_tail                 ; ... and add the node to the tail
+  bsr       enable_interrupts
+  bra       .ok
+
 
 ; void irq_remove_c(IrqHandler* handler);
 irq_remove_c::
@@ -291,12 +394,138 @@ irq_remove_c::
 ;   a0    - IrqHandler struct pointer
 ;
 ; Modifies:
-;   a1    - Removed handler
+;   a0    - Trashed
+;   a1    - Removed handler (NULL if it wasn't registered)
+;
+; When the last handler on a vector is removed, whatever was on the
+; vector before the first one was registered is put back.
 ;
 irq_remove::
-  bsr     disable_interrupts
-  bra     list_node_delete                ; Just branch off to list_node_delete
-  bsr     enable_interrupts
+  bsr       disable_interrupts
+  move.l    a0,a1                         ; Handler in a1...
+  cmp.l     #$0,a1
+  beq       .done
+  bsr       irq_node_find                 ; ... and its node in a0
+  cmp.l     #$0,a0
+  beq       .notfound
+
+  bsr       list_node_delete              ; Remove it from whichever list...
+
+  movem.l   d0/a2,-(a7)
+  move.l    IRQ_NODE_VECTOR(a1),d0        ; Was it on a vector?
+  beq       .freenode
+  sub.l     #IRQ_VECTOR_FIRST,d0          ; It was - make vector 0-based
+  move.l    d0,a2
+  mulu.w    #12,d0                        ; Multiply by 12 (bytes in a List struct)
+  move.l    #irq_vector_lists,a0
+  add.l     d0,a0                         ; Get this vector's list...
+  move.l    (a0),a0
+  tst.l     (a0)                          ; ... and if its first node isn't the tail,
+  bne       .freenode                     ; it still has handlers
+
+  move.l    a2,d0
+  lsl.l     #2,d0                         ; Index the stubs (four bytes each)...
+  move.l    #vector_stubs,a0
+  add.l     d0,a0                         ; ... to get this vector's stub
+  move.l    vector_base,a2
+  add.l     #IRQ_VECTOR_FIRST*4,a2
+  add.l     d0,a2                         ; ... and its slot in the vector table
+  cmp.l     (a2),a0                       ; Leave it if something's replaced the stub
+  bne       .freenode
+  move.l    #old_vectors,a0
+  move.l    (a0,d0.l),(a2)                ; Otherwise, put the old handler back
+
+.freenode:
+  movem.l   (a7)+,d0/a2
+  move.l    IRQ_NODE_HANDLER(a1),a0
+  clr.l     IRQ_NODE_HANDLER(a1)          ; ... free the node...
+  move.l    a0,a1                         ; ... and return the handler
+  bra       enable_interrupts
+
+.notfound:
+  move.l    #$0,a1
+.done:
+  bra       enable_interrupts
+
+
+; uint32_t irq_hits_c(IrqHandler* handler);
+irq_hits_c::
+  move.l    4(a7),a1                      ; Handler struct pointer in a1
+
+; Arguments:
+;   a1    - IrqHandler struct pointer
+;
+; Modifies:
+;   d0    - Times the handler has claimed an interrupt (0 if not registered)
+;   a0    - Trashed
+;
+irq_hits::
+  moveq.l   #0,d0
+  cmp.l     #$0,a1
+  beq       .done
+  bsr       irq_node_find
+  cmp.l     #$0,a0
+  beq       .done
+  move.l    IRQ_NODE_HITS(a0),d0
+.done:
+  rts
+
+
+; Take a free node for a handler. Interrupts must be disabled.
+;
+; Arguments:
+;   a1    - IrqHandler struct pointer
+;
+; Modifies:
+;   a1    - The node (NULL if they're all in use)
+;
+irq_node_alloc:
+  movem.l   d1/a2,-(a7)
+  move.l    #irq_nodes,a2
+  move.l    #IRQ_MAX_HANDLERS-1,d1
+
+.loop:
+  tst.l     IRQ_NODE_HANDLER(a2)          ; Is this one free?
+  beq       .found
+  add.l     #IRQ_NODE_SIZE,a2
+  dbra      d1,.loop
+
+  move.l    #$0,a1                        ; None are
+  bra       .done
+
+.found:
+  move.l    a1,IRQ_NODE_HANDLER(a2)       ; Take it for this handler
+  clr.l     IRQ_NODE_HITS(a2)             ; No hits yet
+  move.l    a2,a1
+
+.done:
+  movem.l   (a7)+,d1/a2
+  rts
+
+
+; Find the node for a handler.
+;
+; Arguments:
+;   a1    - IrqHandler struct pointer (not NULL)
+;
+; Modifies:
+;   a0    - The node (NULL if the handler isn't registered)
+;
+irq_node_find:
+  move.l    d1,-(a7)
+  move.l    #irq_nodes,a0
+  move.l    #IRQ_MAX_HANDLERS-1,d1
+
+.loop:
+  cmp.l     IRQ_NODE_HANDLER(a0),a1       ; Is this the one?
+  beq       .done
+  add.l     #IRQ_NODE_SIZE,a0
+  dbra      d1,.loop
+
+  move.l    #$0,a0                        ; Not registered
+
+.done:
+  move.l    (a7)+,d1
   rts
 
   ifd UNIT_TESTS
@@ -316,39 +545,162 @@ run_handler_chain::
   cmp.l     #7,d0                         ; If it's higher than 7, just return
   bhi       .justreturn
 
-  movem.l   d0-d1/a0-a2,-(a7)             ; Save regs
+  movem.l   d0-d1/a0-a1,-(a7)             ; Save regs
+  bsr       run_level_list
+  movem.l   (a7)+,d0-d1/a0-a1             ; Restore regs
 
-  subq.l    #1,d0                         ; Make IRQ 0-based
-  mulu.w    #12,d0                        ; Multiply by 12 (bytes in a List struct)
+.justreturn:
+  rts
+
+
+; Run the handlers for an IRQ level.
+;
+; Arguments:
+;   d0    - IRQ number (1..7)
+;
+; Modifies:
+;   d0    - Non-zero if a handler claimed the interrupt
+;   d1    - Trashed
+;   a0    - Trashed
+;   a1    - Trashed
+;
+run_level_list:
+  move.l    d0,d1
+  subq.l    #1,d1                         ; Make IRQ 0-based
+  mulu.w    #12,d1                        ; Multiply by 12 (bytes in a List struct)
   move.l    #irq_1_list,a0                ; Get the base address of irq 1 list
-  add.l     d0,a0                         ; And add d0 to get to our target list
-  move.l    a0,a1                         ; Also put into a1
-  addq.l    #4,a1                         ; And point to list tail
+  add.l     d1,a0                         ; And add to get to our target list
+
+; Run the handlers in a list until one claims the interrupt. That 
+; one's hit count goes up, and it moves to the front of the list, 
+; so the busiest handlers are tried first.
+;
+; Arguments:
+;   a0    - The handler list
+;   d0    - IRQ / vector number, passed to the handlers
+;
+; Modifies:
+;   d0    - Non-zero if a handler claimed the interrupt
+;   d1    - Trashed
+;   a0    - Trashed
+;   a1    - Trashed
+;
+run_list:
+  movem.l   d2/a2-a3,-(a7)                ; These survive the C calls
+  move.l    a0,a2                         ; List in a2
+  move.l    d0,d2                         ; Number in d2
+  move.l    a0,a3                         ; Start at the head
 
 .loop:
-  move.l    (a7),d0                       ; Restore d0 (don't pop)
-  move.l    IRQ_NEXT(a0),a0               ; Get next handler
-  cmp.l     a1,a0                         ; Are we pointing at list tail?
-  beq       .done                         ; We're done if so
-
-  movem.l   d1/a0-a1,-(a7)                ; Save regs for potential C call
-  move.l    IRQ_DATA(a0),-(a7)            ; Otherwise, push handler data onto stack
-  move.l    d0,-(a7)                      ; followed by vector number
-  move.l    IRQ_FUNC(a0),a2               ; Get function pointer  
-  jsr       (a2)                          ; Call function
-  add.l     #8,a7                         ; Restore stack
-  movem.l   (a7)+,d1/a0-a1                ; Restore regs after potential C call
+  move.l    IRQ_NEXT(a3),a3               ; Get next node
+  tst.l     IRQ_NEXT(a3)                  ; Are we pointing at list tail?
+  beq       .none                         ; We're done if so
+
+  move.l    IRQ_NODE_HANDLER(a3),a0       ; Otherwise, get its handler...
+  move.l    IRQ_DATA(a0),-(a7)            ; ... push handler data onto stack
+  move.l    d2,-(a7)                      ; followed by vector number
+  move.l    IRQ_FUNC(a0),a0               ; Get function pointer  
+  jsr       (a0)                          ; Call function
+  addq.l    #8,a7                         ; Restore stack
 
   tst.b     d0                            ; Did function return true?
-  bne       .done                         ; We're done if so
-  bra       .loop                         ; else, loop
+  beq       .loop                         ; Try the next one if not
+
+  addq.l    #1,IRQ_NODE_HITS(a3)          ; It did - count it...
+  cmp.l     IRQ_NEXT(a2),a3               ; ... and unless it's already first...
+  beq       .claimed
+  move.l    a3,a0
+  bsr       list_node_delete
+  move.l    a2,a0
+  bsr       list_add_head                 ; ... move it to the front
+
+.claimed:
+  moveq.l   #1,d0
+  bra       .done
+
+.none:
+  moveq.l   #0,d0
+
+.done:
+  movem.l   (a7)+,d2/a2-a3
+  rts
+
+
+  ifd UNIT_TESTS
+run_vector_chain_c::
+  move.l    4(a7),d0
+  movem.l   d2-d7/a2-a6,-(a7)
+  bsr       run_vector_chain
+  movem.l   (a7)+,d2-d7/a2-a6
+  rts
+  endif
+
+; Run the handlers for a vector. If none of them claim it, 
+; fall back to the handlers for the current IRQ level (from 
+; the SR, so none if we're not in an interrupt).
+;
+; Arguments:
+;   d0    - Vector number (IRQ_VECTOR_FIRST and up)
+;
+; Modifies:
+;   d0    - Non-zero if a handler claimed the interrupt
+;   d1    - Trashed
+;   a0    - Trashed
+;   a1    - Trashed
+;
+run_vector_chain:
+  move.l    d0,d1
+  sub.l     #IRQ_VECTOR_FIRST,d1          ; Make vector 0-based
+  mulu.w    #12,d1                        ; Multiply by 12 (bytes in a List struct)
+  move.l    #irq_vector_lists,a0
+  add.l     d1,a0                         ; Get this vector's list
+  bsr       run_list
+  tst.b     d0                            ; Claimed?
+  bne       .done
+
+  move.w    sr,d0                         ; No - what level are we at?
+  lsr.w     #8,d0
+  and.l     #7,d0
+  beq       .done                         ; Not in an interrupt, so nothing to fall back on
+  bra       run_level_list
 
 .done:
-  movem.l   (a7)+,d0-d1/a0-a2             ; Save regs
-.justreturn:
   rts
 
 
+; Handlers for vectored interrupts. Each vector with handlers registered
+; points at one of these stubs, which just calls vector_entry - the 
+; return address tells it which vector this is.
+;
+vector_stubs:
+  rept      IRQ_VECTOR_COUNT
+  bsr.w     vector_entry
+  endr
+
+vector_entry:
+  movem.l   d0-d1/a0-a1,-(a7)             ; Save the registers the C handlers can trash
+  move.l    $10(a7),d0                    ; Get the stub's return address...
+  sub.l     #vector_stubs+4,d0            ; ... and from that, the vector
+  lsr.l     #2,d0
+  add.l     #IRQ_VECTOR_FIRST,d0
+  bsr       run_vector_chain              ; Run its handlers
+
+  tst.b     d0                            ; Did something claim it?
+  beq       .chain
+
+  movem.l   (a7)+,d0-d1/a0-a1             ; It did - we're done
+  addq.l    #4,a7                         ; Drop the stub's return address
+  rte
+
+.chain:
+  move.l    $10(a7),d0                    ; Nothing did - chain to the vector's old handler,
+  sub.l     #vector_stubs+4,d0            ; by replacing the stub's return address with it
+  move.l    #old_vectors,a0
+  move.l    (a0,d0.l),$10(a7)
+  movem.l   (a7)+,d0-d1/a0-a1
+  rts                                     ; Off to the old handler, with the frame intact
+
+
   ifd       DEBUG_INTEN
 do_report_disable:
   movem.l   d0-d7/a0-a6,-(a7)
@@ -414,6 +766,8 @@ old_irq5                ds.l    1
 old_irq6                ds.l    1
 old_irq7                ds.l    1
 
+vector_base::           ds.l    1         ; Where the vector table is (VBR)
+
 irq_1_list::
 irq_1_head              ds.l    1
 irq_1_tail              ds.l    2
@@ -435,3 +789,10 @@ irq_6_tail              ds.l    2
 irq_7_list::
 irq_7_head              ds.l    1
 irq_7_tail              ds.l    2
+
+irq_vector_lists::                        ; One list per vector, from IRQ_VECTOR_FIRST
+                        ds.l    3*IRQ_VECTOR_COUNT
+old_vectors             ds.l    IRQ_VECTOR_COUNT
+
+irq_nodes                                 ; The handlers' nodes, free if no handler
+                        ds.l    5*IRQ_MAX_HANDLERS
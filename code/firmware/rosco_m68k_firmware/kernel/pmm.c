@@ -62,6 +62,31 @@
  *     _bad things_ are likely to happen. It doesn't currently
  *     check this (but maybe should?)
  * 
+ * Segregated bins mode:
+ * 
+ * Building with `-DPMM_SEGREGATED_BINS` swaps the two sorted lists
+ * for an allocator where both alloc and free are O(log n) (in the
+ * number of bins, not the number of free blocks) regardless of how
+ * fragmented memory gets:
+ * 
+ *   * Free blocks are kept in power-of-two size class bins (bin n
+ *     holds blocks of 2**n to 2**(n+1)-1 pages), with a mask of
+ *     non-empty bins.
+ *   * Each free block has a header (the list node) at the start and
+ *     a boundary tag (its size) in its last longword, so a neighbour
+ *     can be found from either end without walking anything.
+ *   * A bitmap with one bit per 1KiB page marks the first and last
+ *     pages of free blocks, which is how free knows whether the pages
+ *     either side of the block are free (and so safe to read the 
+ *     header / tag from). That's 2KiB for the full 16MiB.
+ * 
+ * Allocated blocks still carry no metadata at all, and alloc takes
+ * the first block from the lowest bin that's guaranteed to fit - only
+ * if there isn't one does it search the bin the size falls in.
+ * 
+ * The sorted lists remain the default (the slab tests, among others,
+ * are written against their first-fit placement).
+ * 
  * Ideas for investigation / enhancement:
  * 
  *   * Don't use free in alloc when splitting blocks
@@ -98,6 +123,205 @@
 #   define NODEBUG_STATIC   static
 #endif
 
+#ifdef PMM_SEGREGATED_BINS
+
+#ifndef PMM_MAX_ADDRESS
+#   define PMM_MAX_ADDRESS  0x01000000  /* Memory above this isn't managed */
+#endif
+
+#define PMM_PAGE_SHIFT      10
+#define PMM_PAGE_COUNT      (PMM_MAX_ADDRESS >> PMM_PAGE_SHIFT)
+#define PMM_BIN_COUNT       23          /* Enough for 4GiB of 1KiB pages */
+
+NODEBUG_STATIC List     pmm_bins[PMM_BIN_COUNT];
+NODEBUG_STATIC uint32_t pmm_bin_mask;
+NODEBUG_STATIC uint32_t pmm_edge_bitmap[PMM_PAGE_COUNT / 32];
+
+static inline bool edge_test(uint32_t page) {
+    return (pmm_edge_bitmap[page >> 5] & (1UL << (page & 0x1f))) != 0;
+}
+
+static inline void edge_set(uint32_t page) {
+    pmm_edge_bitmap[page >> 5] |= (1UL << (page & 0x1f));
+}
+
+static inline void edge_clear(uint32_t page) {
+    pmm_edge_bitmap[page >> 5] &= ~(1UL << (page & 0x1f));
+}
+
+static inline uint8_t bin_for(uintptr_t size) {
+    uintptr_t pages = size >> PMM_PAGE_SHIFT;
+    uint8_t bin = 0;
+
+    while (pages >>= 1) {
+        bin++;
+    }
+
+    return bin;
+}
+
+static inline bool bin_empty(uint8_t bin) {
+    return pmm_bins[bin].head == (ListNode*)&pmm_bins[bin].tail;
+}
+
+static void bin_insert(uintptr_t addr, uintptr_t size) {
+    ListNode *block = (ListNode*)addr;
+    uint8_t bin = bin_for(size);
+
+    debugf("Bin 0x%08x:%04x in bin %d\n", addr, size, bin);
+
+    block->size = size;
+    *((uint32_t*)(addr + size - sizeof(uint32_t))) = size;
+
+    list_add_head_c(&pmm_bins[bin], block);
+    pmm_bin_mask |= (1UL << bin);
+
+    edge_set(addr >> PMM_PAGE_SHIFT);
+    edge_set((addr + size - 1) >> PMM_PAGE_SHIFT);
+}
+
+static void bin_remove(ListNode *block) {
+    uintptr_t addr = (uintptr_t)block;
+    uint8_t bin = bin_for(block->size);
+
+    list_node_delete_c(block);
+
+    if (bin_empty(bin)) {
+        pmm_bin_mask &= ~(1UL << bin);
+    }
+
+    edge_clear(addr >> PMM_PAGE_SHIFT);
+    edge_clear((addr + block->size - 1) >> PMM_PAGE_SHIFT);
+}
+
+void pmm_init() {
+    for (int i = 0; i < PMM_BIN_COUNT; i++) {
+        list_init_c(&pmm_bins[i]);
+    }
+
+    for (int i = 0; i < PMM_PAGE_COUNT / 32; i++) {
+        pmm_edge_bitmap[i] = 0;
+    }
+
+    pmm_bin_mask = 0;
+}
+
+void pmm_free(uintptr_t addr, uintptr_t size) {
+    uintptr_t alloc_size = size & PMM_SIZE_MASK;
+    if (alloc_size < size) {
+        size = alloc_size + PMM_MIN_SIZE;
+    }
+
+    if (addr >= PMM_MAX_ADDRESS) {
+        debugf("FREE: Ignoring unmanaged block at 0x%08x\n", addr);
+        return;
+    }
+
+    if (size > PMM_MAX_ADDRESS - addr) {
+        size = PMM_MAX_ADDRESS - addr;
+    }
+
+    disable_interrupts();
+
+    debugf("FREE: %d bytes at 0x%08x\n", size, addr);
+
+    uintptr_t end = addr + size;
+
+    // A free block ending on the page below has its last page marked (it
+    // can't be the first page of a block, as that block would overlap this
+    // one) so its boundary tag is safe to read.
+    //
+    uint32_t page = addr >> PMM_PAGE_SHIFT;
+    if (page > 0 && edge_test(page - 1)) {
+        uintptr_t below_size = *((uint32_t*)(addr - sizeof(uint32_t)));
+        debugf("Coalesce 0x%08x:%04x and lower  0x%08x:%04x\n", addr, size, addr - below_size, below_size);
+
+        addr -= below_size;
+        bin_remove((ListNode*)addr);
+    }
+
+    // Likewise, a marked page directly above must be the start of a free block
+    //
+    page = end >> PMM_PAGE_SHIFT;
+    if (page < PMM_PAGE_COUNT && edge_test(page)) {
+        ListNode *above = (ListNode*)end;
+        debugf("Coalesce 0x%08x:%04x and higher 0x%08x:%04x\n", addr, end - addr, end, above->size);
+
+        end += above->size;
+        bin_remove(above);
+    }
+
+    bin_insert(addr, end - addr);
+
+    enable_interrupts();
+}
+
+uintptr_t pmm_alloc(uintptr_t size) {
+    debugf("ALLOCATE 0x%08x\n", size);
+
+    uintptr_t alloc_size = size & PMM_SIZE_MASK;
+    if (alloc_size < size) {
+        size = alloc_size + PMM_MIN_SIZE;
+    }
+
+    if (size == 0 || size >= PMM_MAX_ADDRESS) {
+        return 0;
+    }
+
+    disable_interrupts();
+
+    ListNode *block = NULL;
+    uint8_t bin = bin_for(size);
+
+    // Every block in the bins above the one this size falls in is big enough
+    // (and so is everything in that bin, if the size is a power of two) so 
+    // the first one we find will do...
+    //
+    uint8_t first = (size & (size - 1)) ? bin + 1 : bin;
+    uint32_t mask = pmm_bin_mask >> first;
+
+    for (uint8_t i = first; mask; i++, mask >>= 1) {
+        if (mask & 1) {
+            block = pmm_bins[i].head;
+            break;
+        }
+    }
+
+    // ... otherwise, there might still be a big enough block in its own bin
+    //
+    if (block == NULL && first != bin) {
+        for (ListNode *current = pmm_bins[bin].head; current->next; current = current->next) {
+            if (current->size >= size) {
+                block = current;
+                break;
+            }
+        }
+    }
+
+    if (block == NULL) {
+        // Out of memory (or too fragmented)
+        enable_interrupts();
+        return 0;
+    }
+
+    uintptr_t addr = (uintptr_t)block;
+    uintptr_t block_size = block->size;
+
+    debugf("Check block at 0x%08x [size 0x%08x]\n", addr, block_size);
+
+    bin_remove(block);
+
+    if (block_size > size) {
+        debugf("Will split this block\n");
+        bin_insert(addr + size, block_size - size);
+    }
+
+    enable_interrupts();
+    return addr;
+}
+
+#else
+
 NODEBUG_STATIC List pmm_addr_list;
 NODEBUG_STATIC List pmm_size_list;
 
@@ -269,3 +493,4 @@ uintptr_t pmm_alloc(uintptr_t size) {
     return 0;
 }
 
+#endif//PMM_SEGREGATED_BINS
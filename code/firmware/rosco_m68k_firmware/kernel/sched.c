@@ -34,6 +34,9 @@ extern List runnable_list_0;
 extern List sleeping_list;
 extern Task *current_task_var;
 
+extern uint32_t sched_trace_count;
+extern SchedTraceEvent sched_trace_ring[SCHED_TRACE_EVENTS];
+
 // Internal API - set up a task to be runnable (just makes the stack right)
 //
 void task_tee(
@@ -44,6 +47,10 @@ void task_tee(
     task_handler_f exithandler
 );
 
+// Internal API - Put a task at the head of its priority's runnable list
+//
+void task_ready(Task *task);
+
 // Internal API - Kick off the tee'd-up init task to get the show on the road
 //
 noreturn void task_kick_off(Task *init);
@@ -61,7 +68,13 @@ void task_new(Task *task, tid_t tid, priority_t priority) {
     task->node.type = NODE_TYPE_TASK;
     task->node.size = sizeof(Task);
     task->priority = priority & 3;
+    task->state = TASK_STATE_RUNNING;
     task->tid = tid;
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
 }
 
 // This gets set up as the return for tasks. It's responsible for
@@ -77,7 +90,7 @@ static noreturn void task_done(void) {
     // memory ordering (freeing our stack, then using it for one call to free the task).
     disable_interrupts();
     pmm_free(this->stack_bottom, this->stack_size);
-    slab_free_c(this, TASK_SLAB_BLOCKS);
+    slab_object_free_c(this, TASK_SLAB_BLOCKS);
     enable_interrupts();
 
     // Do this as a jump to stop the compiler pushing a return address to the
@@ -103,20 +116,8 @@ void task_schedule(Task *task, uintptr_t stack_addr, size_t stack_size, task_han
     task->stack_bottom = stack_addr;
     task_tee(task, stack_addr + stack_size, task_trampoline, entrypoint, task_done);
 
-    uint8_t priority = task->priority & 3;
-    List *target_list;
-    if (priority == 3) {
-        target_list = &runnable_list_3;
-    } else if (priority == 2) {
-        target_list = &runnable_list_2;
-    } else if (priority == 1) {
-        target_list = &runnable_list_1;
-    } else {
-        target_list = &runnable_list_0;
-    }
-
     disable_interrupts();
-    list_add_head_c(target_list, (ListNode*)task);
+    task_ready(task);
     enable_interrupts();
 
     debug_task(task);
@@ -129,6 +130,12 @@ static void setup_init_task(Task *task, tid_t tid) {
     task->node.size = sizeof(Task);
     task->tid = tid;
     task->priority = 4;
+    task->state = TASK_STATE_RUNNING;
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
 }
 
 // Set up the idle task
@@ -138,6 +145,12 @@ static void setup_idle_task(Task *task, tid_t tid) {
     task->node.size = sizeof(Task);
     task->tid = tid;
     task->priority = 0;
+    task->state = TASK_STATE_RUNNING;
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
 }
 
 noreturn void start_tasking(
@@ -149,7 +162,7 @@ noreturn void start_tasking(
     task_handler_f idle_task
 ) {
     debugf("Set up init task...\n");
-    tinit = (Task*)pmm_alloc(sizeof(Task));
+    tinit = (Task*)slab_object_alloc_c(TASK_SLAB_BLOCKS);
     setup_init_task(tinit, 0);
     tinit->stack_size = init_stack_size;
     tinit->stack_bottom = init_stack;
@@ -168,6 +181,76 @@ noreturn void start_tasking(
     task_kick_off(tinit);
 }
 
+// No printf (or division) in here, so dumps are hex
+static void send_str(const char *str) {
+    while (*str) {
+        FW_SENDCHAR_C(*str++);
+    }
+}
+
+static void send_hex(uint32_t value, uint8_t digits) {
+    while (digits--) {
+        FW_SENDCHAR_C("0123456789abcdef"[(value >> (digits << 2)) & 0xf]);
+    }
+}
+
+// Public API: Dump a task's statistics to serial
+void task_dump_stats(Task *task) {
+    TaskStats stats;
+
+    if (task == NULL) {
+        task = task_current();
+    }
+
+    task_get_stats(task, &stats);
+
+    send_str("task ");
+    send_hex(task->tid, 8);
+    send_str(" pri ");
+    send_hex(task->priority, 1);
+    send_str(" switches ");
+    send_hex(stats.switches, 8);
+    send_str(" ticks ");
+    send_hex(stats.ticks, 8);
+    send_str(" max latency ");
+    send_hex(stats.max_latency, 8);
+    send_str("\r\n");
+}
+
+// Public API: Dump the trace ring to serial
+void sched_trace_dump(void) {
+    disable_interrupts();
+    uint32_t end = sched_trace_count;
+    enable_interrupts();
+
+    uint32_t i = end < SCHED_TRACE_EVENTS ? 0 : end - SCHED_TRACE_EVENTS;
+
+    for (; i != end; i++) {
+        SchedTraceEvent event;
+
+        // Printing is slow, and switches carry on being recorded 
+        // meanwhile - skip any that have been overwritten already
+        disable_interrupts();
+        if (sched_trace_count - i > SCHED_TRACE_EVENTS) {
+            enable_interrupts();
+            continue;
+        }
+        event = sched_trace_ring[i & (SCHED_TRACE_EVENTS - 1)];
+        enable_interrupts();
+
+        send_hex(event.time, 8);
+        send_str(": ");
+        send_hex(event.from, 8);
+        send_str(" [");
+        send_hex(event.from_state, 2);
+        send_str("] -> ");
+        send_hex(event.to, 8);
+        send_str(" (pri ");
+        send_hex(event.to_priority, 1);
+        send_str(")\r\n");
+    }
+}
+
 #ifdef DEBUG_SCHED
 uint32_t volatile *upticks = (uint32_t*)0x40c;
 #ifdef TRACE_SCHED
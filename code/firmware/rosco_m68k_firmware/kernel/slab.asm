@@ -13,6 +13,10 @@
 ;* 
 ;* Manages slabs of 1KiB, which are split into blocks of
 ;* 32 bytes (for 32 blocks per slab).
+;*
+;* Slab caches split their slabs into objects of a single
+;* power-of-two size instead, with per-cache partial / full /
+;* empty lists. See slab.h for details.
 ;* ------------------------------------------------------------
 ;*
 
@@ -26,6 +30,22 @@ LIST_NEXT   equ     $00                   ; These need to be kept in-step with
 
 SLAB_BASE   equ     $10                   ; These need to be kept in-step with
 SLAB_BMP    equ     $14                   ; values in slab.h!
+SLAB_BMP_HI equ     $18
+SLAB_CACHE  equ     $1C
+
+CACHE_PARTIAL     equ     $00             ; SlabCache - also in slab.h
+CACHE_FULL        equ     $0C
+CACHE_EMPTY       equ     $18
+CACHE_OBJ_SIZE    equ     $24
+CACHE_OBJ_SHIFT   equ     $28
+CACHE_INIT_BMP    equ     $2C
+CACHE_INIT_BMP_HI equ     $30
+CACHE_EMPTY_COUNT equ     $34
+CACHE_SIZEOF      equ     $38
+
+SLAB_CACHE_COUNT        equ   5           ; Also in slab.h
+SLAB_CACHE_MAX_EMPTY    equ   1
+SLAB_OBJECT_MAX_BLOCKS  equ   8
 
 NODE_NEXT   equ     $00                   ; These need to be kept in-step with
 NODE_PREV   equ     $04                   ; values in list.h!
@@ -45,12 +65,23 @@ SLAB_BASE_MASK    equ     $fffffc00
 ; is used, that must be initialized too.
 ;
 slab_init::
-  move.l    a0,-(a7)
+  movem.l   d0-d2/a0,-(a7)
   move.l    #partial_slabs,a0
   bsr       list_init
   move.l    #full_slabs,a0
   bsr       list_init
-  move.l    (a7)+,a0
+
+  move.l    #slab_caches,a0               ; Set up the standard caches...
+  moveq.l   #16,d2                        ; ... starting at 16 bytes
+.cache_loop:
+  move.l    d2,d0
+  bsr       slab_cache_init
+  add.l     #CACHE_SIZEOF,a0              ; Next cache...
+  add.l     d2,d2                         ; ... is for objects twice the size
+  cmp.l     #slab_caches_end,a0
+  blo       .cache_loop
+
+  movem.l   (a7)+,d0-d2/a0
   rts
 
 
@@ -116,6 +147,7 @@ slab_alloc::
   move.l    #SLAB_SIZE,NODE_SIZE(a1)      ; and size field (whole slab size)
   move.l    d0,SLAB_BASE(a1)              ; Set up slab base address
   move.l    #SLAB_INIT_BMP,SLAB_BMP(a1)   ; And bitmap (top block always allocated to metadata)
+  clr.l     SLAB_CACHE(a1)                ; Not owned by a cache
 
   move.l    #partial_slabs,a0             ; Partial list head into a0
   bsr       list_add_head                 ; And add the new slab at head
@@ -238,7 +270,404 @@ slab_free::
   move.l    (a7)+,a1
   rts
 
+
+; SlabCache* slab_cache_init_c(SlabCache *cache, uint32_t object_size);
+slab_cache_init_c::
+  move.l    4(a7),a0
+  move.l    8(a7),d0
+
+; Arguments:
+;   a0    - The cache to initialise
+;   d0    - Object size (16, 32, 64, 128 or 256)
+;
+; Modifies:
+;   d0    - The cache, or NULL if the size isn't supported - return value
+;
+slab_cache_init::
+  movem.l   d1-d2/a0-a1,-(a7)
+  moveq.l   #4,d1                         ; Find the shift for this size
+  moveq.l   #16,d2                        ; starting at 16 bytes
+
+.find_shift:
+  cmp.l     d2,d0                         ; Is it this one?
+  beq       .found_shift
+  add.l     d2,d2                         ; Else try the next power of two...
+  addq.l    #1,d1
+  cmp.l     #8,d1                         ; ... up to 256 bytes
+  bls       .find_shift
+
+  clr.l     d0                            ; Not a supported size
+  bra       .done
+
+.found_shift:
+  move.l    d0,CACHE_OBJ_SIZE(a0)
+  move.l    d1,CACHE_OBJ_SHIFT(a0)
+  clr.l     CACHE_EMPTY_COUNT(a0)
+
+  subq.l    #4,d1                         ; Index the initial bitmaps table...
+  lsl.l     #3,d1                         ; ... at eight bytes per entry
+  move.l    #cache_init_bitmaps,a1
+  move.l    (a1,d1.l),CACHE_INIT_BMP(a0)
+  move.l    4(a1,d1.l),CACHE_INIT_BMP_HI(a0)
+
+  move.l    a0,d0                         ; Cache is the return value
+  bsr       list_init                     ; Partial list is at the start...
+  add.l     #CACHE_FULL,a0
+  bsr       list_init                     ; ... then full...
+  add.l     #CACHE_EMPTY-CACHE_FULL,a0
+  bsr       list_init                     ; ... and empty
+
+.done:
+  movem.l   (a7)+,d1-d2/a0-a1
+  rts
+
+
+; SlabCache* slab_cache_for_c(uint32_t size);
+slab_cache_for_c::
+  move.l    4(a7),d0
+
+; Arguments:
+;   d0    - Required object size
+;
+; Modifies:
+;   d0    - Standard cache, or NULL if size is too big - return value
+;
+slab_cache_for::
+  move.l    a0,-(a7)
+  move.l    #slab_caches,a0
+
+.loop:
+  cmp.l     CACHE_OBJ_SIZE(a0),d0         ; Will it fit in this cache's objects?
+  bls       .found                        ; Smallest that fits, so done if so
+
+  add.l     #CACHE_SIZEOF,a0              ; Else try next cache
+  cmp.l     #slab_caches_end,a0
+  blo       .loop
+
+  clr.l     d0                            ; Too big for any of them
+  move.l    (a7)+,a0
+  rts
+
+.found:
+  move.l    a0,d0
+  move.l    (a7)+,a0
+  rts
+
+
+; void*   slab_cache_alloc_c(SlabCache *cache);
+slab_cache_alloc_c::
+  move.l    4(a7),a0
+
+; Arguments:
+;   a0    - The cache
+;
+; Modifies:
+;   a0    - trashed
+;   d0    - Address of the object, or NULL - return value
+;
+slab_cache_alloc::
+  movem.l   d1-d2/a1-a2,-(a7)             ; Save regs
+  move.l    a0,a2                         ; Cache lives in a2
+  jsr       disable_interrupts            ; disable interrupts while we fiddle with lists
+
+  move.l    CACHE_PARTIAL(a2),a1          ; Head of the partial list always has space...
+  tst.l     NODE_NEXT(a1)                 ; ... unless it's the tail
+  bne       .have_slab
+
+  lea       CACHE_EMPTY(a2),a0            ; No partial slabs - do we have an empty one?
+  bsr       list_delete_head
+  cmp.l     #0,a1
+  beq       .new_slab                     ; No, need a new slab
+
+  subq.l    #1,CACHE_EMPTY_COUNT(a2)      ; Yes, one less empty
+  bra       .add_partial
+
+.new_slab:
+  move.l    #SLAB_SIZE,-(a7)              ; Allocate a 1KiB block...
+  bsr       pmm_alloc                     ; ...from the pmm
+  tst.l     d0
+  bne       .init_slab
+
+  bsr       slab_reap                     ; Out of memory - release empty slabs...
+  tst.l     d0                            ; ... if there were any...
+  beq       .nomem
+
+  bsr       pmm_alloc                     ; ... and try again (size is still stacked)
+  tst.l     d0
+  beq       .nomem
+
+.init_slab:
+  add.l     #4,a7                         ; Cleanup stack
+
+  move.l    d0,a1                         ; Metadata in the top 32 bytes, as usual
+  add.l     #SLAB_META_START,a1
+
+  move.l    #NODE_TYPE_SLAB,NODE_TYPE(a1) ; Set up type field
+  move.l    #SLAB_SIZE,NODE_SIZE(a1)      ; and size field (whole slab size)
+  move.l    d0,SLAB_BASE(a1)              ; Set up slab base address
+  move.l    CACHE_INIT_BMP(a2),SLAB_BMP(a1)
+  move.l    CACHE_INIT_BMP_HI(a2),SLAB_BMP_HI(a1)
+  move.l    a2,SLAB_CACHE(a1)             ; And owning cache
+
+.add_partial:
+  move.l    a2,a0                         ; Partial list head into a0
+  bsr       list_add_head                 ; And add the slab at head
+
+.have_slab:
+  ; Here:
+  ;    a1 - points to slab metadata (slab has a free object)
+  ;    a2 - points to cache
+  ;
+  move.l    SLAB_BMP(a1),d1               ; Anything free in the low bitmap?
+  cmp.l     #$ffffffff,d1
+  beq       .find_hi
+
+  bsr       bitmap_find_clear             ; Yes, find it
+  move.l    d0,d2
+  bra       .mark
+
+.find_hi:
+  move.l    SLAB_BMP_HI(a1),d1            ; No, must be in the high bitmap
+  bsr       bitmap_find_clear
+  moveq.l   #32,d2
+  add.l     d0,d2
+
+.mark:
+  move.l    d2,d0                         ; Object number in d2
+  add.l     #SLAB_BMP,a1                  ; a1 points to bitmap
+  bsr       bitmap_set                    ; Mark object as used
+  sub.l     #SLAB_BMP,a1                  ; Point a1 back to start of metadata
+
+  cmp.l     #$ffffffff,SLAB_BMP(a1)       ; Is this slab full?
+  bne       .return_addr
+  cmp.l     #$ffffffff,SLAB_BMP_HI(a1)
+  bne       .return_addr
+
+  move.l    a1,a0                         ; Full - move from partial...
+  bsr       list_node_delete
+  lea       CACHE_FULL(a2),a0             ; ... to full list
+  bsr       list_add_head
+
+.return_addr:
+  move.l    CACHE_OBJ_SHIFT(a2),d1
+  lsl.l     d1,d2                         ; Object number to offset...
+  add.l     SLAB_BASE(a1),d2              ; ... plus slab base
+  move.l    d2,d0                         ; is the return value
+
+  jsr       enable_interrupts             ; Re-enable interrupts
+  movem.l   (a7)+,d1-d2/a1-a2             ; Restore regs
+  rts
+
+.nomem:
+  add.l     #4,a7                         ; Cleanup stack
+  jsr       enable_interrupts             ; No memory - re-enable interrupts
+  movem.l   (a7)+,d1-d2/a1-a2             ; Restore regs
+  clr.l     d0                            ; Set return to null
+  rts
+
+
+; void    slab_cache_free_c(void *object);
+slab_cache_free_c::
+  move.l    4(a7),a0
+
+; Arguments:
+;   a0    - The object
+;
+; Modifies:
+;   a0    - trashed
+;   d0    - trashed
+;
+slab_cache_free::
+  movem.l   d1-d2/a1-a2,-(a7)             ; Save regs
+
+  move.l    a0,d0                         ; Object address into d0
+  and.l     #SLAB_BASE_MASK,d0            ; Get slab base address
+  move.l    d0,a1
+  add.l     #SLAB_META_START,a1           ; a1 points to slab metadata
+  move.l    SLAB_CACHE(a1),a2             ; a2 points to owning cache
+
+  move.l    a0,d2                         ; Object address...
+  sub.l     d0,d2                         ; ... minus slab base...
+  move.l    CACHE_OBJ_SHIFT(a2),d1
+  lsr.l     d1,d2                         ; ... divided by size is object number
+
+  jsr       disable_interrupts            ; disable interrupts while we fiddle with lists
+
+  cmp.l     #$ffffffff,SLAB_BMP(a1)       ; Is this slab currently full?
+  bne       .clear
+  cmp.l     #$ffffffff,SLAB_BMP_HI(a1)
+  bne       .clear
+
+  move.l    a1,a0                         ; It was - move from full...
+  bsr       list_node_delete
+  move.l    a2,a0                         ; ... back to partial
+  bsr       list_add_head
+
+.clear:
+  move.l    d2,d0
+  add.l     #SLAB_BMP,a1                  ; a1 points to bitmap
+  bsr       bitmap_clear                  ; Mark object as free
+  sub.l     #SLAB_BMP,a1                  ; Point a1 back to start of metadata
+
+  move.l    SLAB_BMP(a1),d0               ; Is this slab now empty?
+  cmp.l     CACHE_INIT_BMP(a2),d0
+  bne       .done
+  move.l    SLAB_BMP_HI(a1),d0
+  cmp.l     CACHE_INIT_BMP_HI(a2),d0
+  bne       .done
+
+  move.l    a1,a0                         ; It is - remove from partial list
+  bsr       list_node_delete
+
+  cmp.l     #SLAB_CACHE_MAX_EMPTY,CACHE_EMPTY_COUNT(a2)
+  bhs       .release                      ; Already holding enough empties?
+
+  lea       CACHE_EMPTY(a2),a0            ; No - keep this one for reuse
+  bsr       list_add_head
+  addq.l    #1,CACHE_EMPTY_COUNT(a2)
+  bra       .done
+
+.release:
+  sub.l     #SLAB_META_START,a1           ; point a1 back to start of slab
+  move.l    #SLAB_SIZE,-(a7)              ; Stack the size for pmm call
+  move.l    a1,-(a7)                      ; Stack the slab start address for pmm call
+  bsr       pmm_free                      ; free it
+  add.l     #8,a7                         ; Tidy up stack
+
+.done:
+  jsr       enable_interrupts             ; re-enable interrupts
+  movem.l   (a7)+,d1-d2/a1-a2             ; restore regs
+  rts
+
+
+; uint32_t slab_cache_reap_c(SlabCache *cache);
+slab_cache_reap_c::
+  move.l    4(a7),a0
+
+; Arguments:
+;   a0    - The cache
+;
+; Modifies:
+;   a0    - trashed
+;   d0    - Number of slabs released - return value
+;
+slab_cache_reap::
+  movem.l   d1-d2/a1-a2,-(a7)             ; Save regs
+  move.l    a0,a2                         ; Cache lives in a2
+  clr.l     d2                            ; Count in d2
+  jsr       disable_interrupts
+
+.loop:
+  lea       CACHE_EMPTY(a2),a0            ; Any (more) empty slabs?
+  bsr       list_delete_head
+  cmp.l     #0,a1
+  beq       .done                         ; Done if not
+
+  sub.l     #SLAB_META_START,a1           ; point a1 back to start of slab
+  move.l    #SLAB_SIZE,-(a7)              ; Stack the size for pmm call
+  move.l    a1,-(a7)                      ; Stack the slab start address for pmm call
+  bsr       pmm_free                      ; free it
+  add.l     #8,a7                         ; Tidy up stack
+
+  addq.l    #1,d2
+  bra       .loop
+
+.done:
+  clr.l     CACHE_EMPTY_COUNT(a2)
+  jsr       enable_interrupts
+  move.l    d2,d0
+  movem.l   (a7)+,d1-d2/a1-a2             ; Restore regs
+  rts
+
+
+; uint32_t slab_reap_c(void);
+slab_reap_c::
+
+; Modifies:
+;   d0    - Number of slabs released - return value
+;
+slab_reap::
+  movem.l   d1-d2/a0-a1,-(a7)
+  clr.l     d1                            ; Total count in d1
+  move.l    #slab_caches,a1               ; For each standard cache...
+
+.loop:
+  move.l    a1,a0
+  movem.l   d1/a1,-(a7)                   ; (pmm_free trashes these)
+  bsr       slab_cache_reap               ; ... reap it
+  movem.l   (a7)+,d1/a1
+  add.l     d0,d1
+
+  add.l     #CACHE_SIZEOF,a1
+  cmp.l     #slab_caches_end,a1
+  blo       .loop
+
+  move.l    d1,d0
+  movem.l   (a7)+,d1-d2/a0-a1
+  rts
+
+
+; void*   slab_object_alloc_c(uint8_t block_count);
+slab_object_alloc_c::
+  move.l    4(a7),d0
+
+; Arguments:
+;   d0    - block count
+;
+; Modifies:
+;   a0    - trashed
+;   d0    - address of object - return value
+;   d1    - trashed
+;
+slab_object_alloc::
+  tst.b     d0                            ; Zero blocks - slab_alloc will return null
+  beq       slab_alloc
+  cmp.b     #SLAB_OBJECT_MAX_BLOCKS,d0    ; Too big for the caches?
+  bhi       slab_alloc                    ; Use contiguous blocks if so
+
+  and.l     #$ff,d0
+  lsl.l     #5,d0                         ; Blocks to bytes
+  bsr       slab_cache_for                ; Find the cache...
+  move.l    d0,a0
+  bra       slab_cache_alloc              ; ... and allocate from it
+
+
+; void    slab_object_free_c(void* addr, uint8_t block_count);
+slab_object_free_c::
+  move.l    4(a7),a0
+  move.l    8(a7),d1
+
+; Arguments:
+;   a0    - Address of object
+;   d1    - block count
+;
+; Modifies:
+;   a0    - trashed
+;   d0    - trashed
+;
+slab_object_free::
+  tst.b     d1                            ; Same rules as slab_object_alloc
+  beq       slab_free
+  cmp.b     #SLAB_OBJECT_MAX_BLOCKS,d1
+  bhi       slab_free
+  bra       slab_cache_free
+
+
+  section .data
+  ; Initial (low, high) bitmaps for cache slabs, from 16 to 256 bytes.
+  ; Metadata takes the top 32 bytes, and objects past the end of the
+  ; slab are marked used so they're never allocated.
+cache_init_bitmaps:
+  dc.l      $00000000,$c0000000           ; 64 objects, top two are metadata
+  dc.l      $80000000,$ffffffff           ; 32 objects, top one is metadata
+  dc.l      $ffff8000,$ffffffff           ; 16 objects
+  dc.l      $ffffff80,$ffffffff           ; 8 objects
+  dc.l      $fffffff8,$ffffffff           ; 4 objects
+
   section .bss
+slab_caches::     ds.b    CACHE_SIZEOF*SLAB_CACHE_COUNT
+slab_caches_end:
+
 partial_slabs::
 partial_head:     ds.l    1
 partial_tail:     ds.l    2
@@ -0,0 +1,225 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Semaphores, mutexes and message ports.
+ *
+ * There's no compare-and-swap on the 68000, but with only one
+ * CPU a single read-modify-write instruction can't be split by
+ * an interrupt - so semaphore counts are changed with subq / addq,
+ * and the flags say whether anyone is (or might be) waiting. Only
+ * then do we disable interrupts and touch the wait queue.
+ *
+ * A task that counts down may be preempted before it gets onto
+ * the queue. If a signal comes in that window, it finds the
+ * queue empty and leaves a wakeup, which the task takes instead
+ * of blocking.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kmachine.h"
+#include "list.h"
+#include "task.h"
+#include "sync.h"
+
+void task_block(void);
+void task_unblock(Task *task);
+void task_set_priority(Task *task, priority_t priority);
+
+// Decrement, returning true if the count was positive (i.e. we got one)
+static inline bool count_down(Semaphore *sem) {
+    uint8_t waiting;
+
+    __asm__ volatile (
+        "subq.l  #1,%1\n\t"
+        "smi     %0\n\t"
+        : "=d"(waiting), "+m"(sem->count)
+        :
+        : "cc"
+    );
+
+    return !waiting;
+}
+
+// Increment, returning true if there are (or will be) waiters to wake
+static inline bool count_up(Semaphore *sem) {
+    uint8_t waiters;
+
+    __asm__ volatile (
+        "addq.l  #1,%1\n\t"
+        "sle     %0\n\t"
+        : "=d"(waiters), "+m"(sem->count)
+        :
+        : "cc"
+    );
+
+    return waiters;
+}
+
+// Block the current task on the semaphore's queue, in priority order.
+// Interrupts must be disabled.
+static void wait_on(Semaphore *sem) {
+    Task *current = task_current();
+    ListNode *node = sem->waiters.head;
+
+    while (node->next != NULL && ((Task*)node)->priority >= current->priority) {
+        node = node->next;
+    }
+
+    current->state = TASK_STATE_WAITING;
+    current->sig_wait = 0;
+    list_node_insert_after_c(node->prev, (ListNode*)current);
+
+    task_block();
+}
+
+// Wake the first waiting task, or leave a wakeup if there isn't one yet.
+// Interrupts must be disabled.
+static Task* wake_one(Semaphore *sem) {
+    ListNode *node = sem->waiters.head;
+
+    if (node->next == NULL) {
+        sem->wakeups++;
+        return NULL;
+    }
+
+    task_unblock((Task*)node);
+    return (Task*)node;
+}
+
+void semaphore_init(Semaphore *sem, int32_t count) {
+    sem->count = count;
+    sem->wakeups = 0;
+    list_init_c(&sem->waiters);
+}
+
+void semaphore_wait(Semaphore *sem) {
+    if (count_down(sem)) {
+        return;
+    }
+
+    disable_interrupts();
+
+    if (sem->wakeups) {
+        sem->wakeups--;
+    } else {
+        wait_on(sem);
+    }
+
+    enable_interrupts();
+}
+
+void semaphore_signal(Semaphore *sem) {
+    if (!count_up(sem)) {
+        return;
+    }
+
+    disable_interrupts();
+    wake_one(sem);
+    enable_interrupts();
+}
+
+void mutex_init(Mutex *mutex) {
+    semaphore_init(&mutex->sem, 1);
+    mutex->owner = NULL;
+    mutex->boosted = false;
+}
+
+void mutex_lock(Mutex *mutex) {
+    Task *current = task_current();
+
+    if (!count_down(&mutex->sem)) {
+        disable_interrupts();
+
+        if (mutex->sem.wakeups) {
+            mutex->sem.wakeups--;
+        } else {
+            // Lend the owner our priority, so it can't be held up by
+            // anything between it and us while we wait
+            Task *owner = mutex->owner;
+
+            if (owner != NULL && owner->priority < current->priority) {
+                if (!mutex->boosted) {
+                    mutex->saved_priority = owner->priority;
+                    mutex->boosted = true;
+                }
+
+                task_set_priority(owner, current->priority);
+            }
+
+            wait_on(&mutex->sem);
+        }
+
+        enable_interrupts();
+    }
+
+    mutex->owner = current;
+}
+
+void mutex_unlock(Mutex *mutex) {
+    // No-one will boost us once this is clear
+    mutex->owner = NULL;
+
+    if (mutex->boosted) {
+        disable_interrupts();
+        task_set_priority(task_current(), mutex->saved_priority);
+        mutex->boosted = false;
+        enable_interrupts();
+    }
+
+    if (count_up(&mutex->sem)) {
+        disable_interrupts();
+        mutex->owner = wake_one(&mutex->sem);
+        enable_interrupts();
+    }
+}
+
+Port* port_init(Port *port, void **slots, uint32_t slot_count) {
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        return NULL;
+    }
+
+    port->slots = slots;
+    port->mask = slot_count - 1;
+    port->head = 0;
+    port->tail = 0;
+    semaphore_init(&port->items, 0);
+    semaphore_init(&port->spaces, slot_count);
+    semaphore_init(&port->put_lock, 1);
+    semaphore_init(&port->get_lock, 1);
+
+    return port;
+}
+
+void port_put(Port *port, void *msg) {
+    semaphore_wait(&port->spaces);
+
+    semaphore_wait(&port->put_lock);
+    port->slots[port->tail++ & port->mask] = msg;
+    semaphore_signal(&port->put_lock);
+
+    semaphore_signal(&port->items);
+}
+
+void* port_get(Port *port) {
+    semaphore_wait(&port->items);
+
+    semaphore_wait(&port->get_lock);
+    void *msg = port->slots[port->head++ & port->mask];
+    semaphore_signal(&port->get_lock);
+
+    semaphore_signal(&port->spaces);
+
+    return msg;
+}
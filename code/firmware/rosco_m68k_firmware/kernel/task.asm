@@ -23,8 +23,29 @@ TASK_STACK  equ     $10
 TASK_PID    equ     $14
 TASK_WAITS  equ     $18
 TASK_PRIO   equ     $24
+TASK_STATE  equ     $25
+TASK_TIMER  equ     $28
+TASK_PENDS  equ     $40
+TASK_SWITCHES equ   $44
+TASK_TICKS  equ     $48
+TASK_WOKEN  equ     $4C
+TASK_LATENCY equ    $50
+
+TIMER_HANDLER       equ   $14             ; Also in timer.h
+
+TASK_STATE_RUNNING  equ   0               ; Also in task.h
+TASK_STATE_RUNNABLE equ   1
+TASK_STATE_WAITING  equ   2
+
+NODE_NEXT   equ     $00                   ; These need to be kept in-step with
+NODE_PREV   equ     $04                   ; values in list.h!
+
+TRACE_SHIFT equ     4                     ; SchedTraceEvent is 16 bytes, see task.h
+TRACE_EVENTS equ    64                    ; SCHED_TRACE_EVENTS, a power of two
+TRACE_EXITED equ    $FF                   ; SCHED_TRACE_EXITED
 
 VEC_TIMER   equ     $114
+SDB_UPTICKS equ     $40c
 SDB_CPUINFO equ     $41c
 
 ; Number of ticks per quantum. The scheduler will be invoked after
@@ -44,7 +65,7 @@ QUANTUM_TICKS  equ   1
 ; Must be called before using other functions.
 ;
 task_init::
-  move.l    a0,-(a7)
+  movem.l   d0-d1/a0-a1,-(a7)
   move.l    #runnable_list_3,a0
   bsr       list_init
   move.l    #runnable_list_2,a0
@@ -55,7 +76,9 @@ task_init::
   bsr       list_init
   move.l    #sleeping_list,a0
   bsr       list_init
-  move.l    (a7)+,a0
+  clr.b     runnable_mask                 ; Nothing runnable yet
+  bsr       timer_init                    ; And no timeouts
+  movem.l   (a7)+,d0-d1/a0-a1
   rts
 
 ; Initialise a task. This must be called on a new task structure
@@ -164,7 +187,7 @@ idle_trampoline::
   rte
 
 
-; Get the correct runnale priority queue for the task in 
+; Get the correct runnable priority queue for the task in 
 ; a1 into a0.
 ;
 ; Arguments:
@@ -174,34 +197,58 @@ idle_trampoline::
 ;   a0      - The appropriate queue head
 ;
 runnable_priority_queue_ptr:
-  move.w  d0,-(a7)  
-  move.b  TASK_PRIO(a1),d0
-  and.b   #3,d0
-  bne     .notzero
-
-  move.l  #runnable_list_0,a0
-  move.w  (a7)+,d0
+  move.l  d0,-(a7)
+  moveq.l #3,d0
+  and.b   TASK_PRIO(a1),d0                ; Priority...
+  lsl.w   #2,d0                           ; ... indexes the queue table
+  move.l  #runnable_queues,a0
+  move.l  (a0,d0.w),a0
+  move.l  (a7)+,d0
   rts
 
-.notzero
-  cmp.b   #1,d0
-  bne     .notone
 
-  move.l  #runnable_list_1,a0
-  move.w  (a7)+,d0
-  rts
+; Make the task in a1 runnable, at the tail (runnable_add_tail) or
+; head (runnable_add_head) of its priority's queue, and mark that
+; queue as non-empty in the runnable mask.
+;
+; Arguments:
+;   a1      - The task
+;
+; Modifies:
+;   a0      - Trashed
+;   d0      - Trashed
+;
+runnable_add_tail:
+  bsr       runnable_priority_queue_ptr
+  bsr       list_add_tail
+  bra       runnable_mark
 
-.notone
-  cmp.b   #2,d0
-  bne     .three
+runnable_add_head:
+  bsr       runnable_priority_queue_ptr
+  bsr       list_add_head
 
-  move.l  #runnable_list_2,a0
-  move.w  (a7)+,d0
+runnable_mark:
+  move.b    #TASK_STATE_RUNNABLE,TASK_STATE(a1)
+  moveq.l   #3,d0
+  and.b     TASK_PRIO(a1),d0
+  bset      d0,runnable_mask              ; This priority has something to run
   rts
 
-.three
-  move.l  #runnable_list_3,a0
-  move.w  (a7)+,d0
+
+; Make a (new) task runnable, at the head of its priority queue.
+;
+; C-callable:
+;   void task_ready(Task *task);
+;
+; **must** be called with interrupts disabled.
+;
+; Internal API.
+;
+task_ready::
+  move.l    a1,-(a7)
+  move.l    8(a7),a1
+  bsr       runnable_add_head
+  move.l    (a7)+,a1
   rts
 
 
@@ -228,8 +275,7 @@ task_yield::
   cmp.l     #tidle,a1                     ; Never add the idle task to the runnable list
   beq       task_switch_next                
 
-  bsr       runnable_priority_queue_ptr   ; Not the idle task, so add to the end of the list
-  bsr       list_add_tail
+  bsr       runnable_add_tail             ; Not the idle task, so add to the end of the list
 
 ; Find and switch to the next task.
 ;
@@ -248,36 +294,84 @@ task_switch_next::
   endif
   endif
 
-  move.l    #runnable_list_3,a0           ; Starting at the priority 3 list head
-  bsr       task_find_next                ; Dequeue next task
-  cmp.l     #0,a1                         ; Is there one?  
-  bne       switch_a1                     ; Else, switch to it
+  moveq.l   #0,d1
+  move.b    runnable_mask,d1              ; Is anything runnable?
+  beq       .idle                         ; Just the idle task if not
 
-  move.l    #runnable_list_2,a0           ; Starting at the priority 2 list head
-  bsr       task_find_next                ; Dequeue next task
-  cmp.l     #0,a1                         ; Is there one?  
-  bne       switch_a1                     ; Else, switch to it
+  move.l    #highest_priority,a0          ; Else, look up the highest non-empty priority
+  move.b    (a0,d1.w),d1
+  move.w    d1,d0
+  lsl.w     #2,d0
+  move.l    #runnable_queues,a0           ; ... and get its queue
+  move.l    (a0,d0.w),a0
 
-  move.l    #runnable_list_1,a0           ; Starting at the priority 1 list head
-  bsr       task_find_next                ; Dequeue next task
-  cmp.l     #0,a1                         ; Is there one?  
-  bne       switch_a1                     ; Else, switch to it
+  move.l    a0,-(a7)
+  bsr       list_delete_head              ; Dequeue next task (never NULL, queue isn't empty)
+  move.l    (a7)+,a0
+
+  move.l    NODE_NEXT(a0),a0              ; Did that empty the queue?
+  tst.l     NODE_NEXT(a0)
+  bne       .switch
+  bclr      d1,runnable_mask              ; Clear its bit if so
 
-  move.l    #runnable_list_0,a0           ; Starting at the priority 0 list head
-  bsr       task_find_next                ; Dequeue next task
-  cmp.l     #0,a1                         ; Is there one?  
-  bne       switch_a1                     ; Else, switch to it
+.switch:
+  move.b    #TASK_STATE_RUNNING,TASK_STATE(a1)
+  bra       switch_a1
 
+.idle:
   move.l    #tidle,a1                     ; Nothing runnable, so "schedule" the idle task
 
 ; Switch to the task pointed to by a1. Local to this module
 ;
 ; switch_next  falls through to this.
 ;
+; The outgoing task's context is already saved, so this is 
+; free to trash registers while it updates the new task's 
+; statistics and records the switch in the trace ring.
+;
 ; Arguments:
 ;   a1    - The new task
 ;
 switch_a1:
+  move.l    SDB_UPTICKS,d0
+  addq.l    #1,TASK_SWITCHES(a1)
+  move.l    TASK_WOKEN(a1),d1             ; Running because it was woken?
+  beq       .trace
+
+  clr.l     TASK_WOKEN(a1)                ; If so, it's taken (now - woken) ticks
+  sub.l     d0,d1                         ; to get here (woken is stored plus one,
+  neg.l     d1                            ; so zero can mean it wasn't)...
+  addq.l    #1,d1
+  cmp.l     TASK_LATENCY(a1),d1
+  bls       .trace
+  move.l    d1,TASK_LATENCY(a1)           ; ... which is the longest yet
+
+.trace:
+  move.l    sched_trace_count,d1          ; Next slot in the trace ring
+  addq.l    #1,sched_trace_count
+  and.w     #TRACE_EVENTS-1,d1
+  lsl.w     #TRACE_SHIFT,d1
+  lea       sched_trace_ring,a0
+  add.w     d1,a0
+
+  move.l    d0,(a0)+                      ; When...
+  move.l    current_task_var,d0           ; ... from where (if it's still there)...
+  beq       .exited
+  move.l    d0,a2
+  move.l    TASK_PID(a2),(a0)+
+  move.b    TASK_STATE(a2),d1
+  bra       .to
+
+.exited:
+  moveq.l   #-1,d0
+  move.l    d0,(a0)+
+  move.b    #TRACE_EXITED,d1
+
+.to:
+  move.l    TASK_PID(a1),(a0)+            ; ... and to where
+  move.b    d1,(a0)+
+  move.b    TASK_PRIO(a1),(a0)
+
   move.l    a1,current_task_var           ; Store new task in the current_task variable
   move.l    TASK_STACK(a1),a7             ; Switch stacks to the new task's stack
   movem.l   (a7)+,d0-d7/a0-a6             ; Restore GP registers
@@ -313,48 +407,71 @@ suspend:
 
   
   section .text
-; Find the next runnable task from the given queue,
-; remove it from the queue and return it.
+; Wait for signals.
 ;
-; Arguments:
-;   a0    - The list head
+; Returns immediately if any of them are already pending.
 ;
-; Modifies:
-;   a0    - Trashed
-;   a1    - The new task, or NULL if no runnable task
+; C-callable:
+;   uint32_t task_wait(uint32_t sig_mask);
 ;
-task_find_next:
-  move.l    a0,-(a7)
+task_wait::
+  bsr       disable_interrupts            ; Single tasking...
+  move.l    4(a7),d0                      ; Any of the signals already pending?
+  bsr       take_pending
+  bne       .reenable_return              ; If so, no need to wait - just return them
+
+  move.l    #.reenable_return,-(a7)       ; We need to come back to this function when signalled
+  bsr       suspend                       ; Load current task, and suspend it  
 
-  move.l    a0,a1                         ; Point a1 at the tail node
-  add.l     #4,a1
+  move.l    $46(a7),d0                    ; Get signal mask argument
+  move.l    d0,TASK_WAITS(a1)             ; And store it in the task
+  move.b    #TASK_STATE_WAITING,TASK_STATE(a1)
 
-  move.l    TASK_NEXT(a0),a0
-  cmp.l     a1,a0                         ; Is is pointing to the list tail?
-  beq       .empty                        ; If not, we found our next task
+  move.l    #sleeping_list,a0             ; Put current task on the sleeping list
+  bsr       list_add_head
 
-  move.l    (a7)+,a0
-  bsr       list_delete_head              ; Else, pop the list head into a1
-  rts
+  bsr       task_switch_next              ; Switch to the runnable task
 
-.empty
-  add.l     #4,a7
-  move.l    #0,a1
-  rts
+.reenable_return:
+                                          ; New task return address is on the stack at this point...  
+  bra       enable_interrupts             ; so enable interrupts...                                    
+  rts                                     ; ... and return to the new task
 
 
-; Wait for signals.
+; Wait for signals, with a timeout.
+;
+; Works like task_wait, except that if the timeout is
+; non-zero the task's timer is armed too. If that expires
+; first, the return value is zero.
 ;
 ; C-callable:
-;   uint32_t task_wait(uint32_t sig_mask);
+;   uint32_t task_wait_timeout(uint32_t sig_mask, uint32_t ticks);
 ;
-task_wait::
+task_wait_timeout::
   bsr       disable_interrupts            ; Single tasking...
+  move.l    4(a7),d0                      ; Any of the signals already pending?
+  bsr       take_pending
+  bne       .reenable_return              ; If so, no need to wait (or arm the timer)
+
   move.l    #.reenable_return,-(a7)       ; We need to come back to this function when signalled
   bsr       suspend                       ; Load current task, and suspend it  
 
+  move.l    $4a(a7),d0                    ; Get timeout argument
+  beq       .wait                         ; Zero means no timeout
+
+  lea       TASK_TIMER(a1),a0             ; Arm the task's timer
+  move.l    #task_timeout,TIMER_HANDLER(a0)
+  move.l    a1,-(a7)
+  move.l    d0,-(a7)
+  move.l    a0,-(a7)
+  bsr       timer_add
+  addq.l    #8,a7
+  move.l    (a7)+,a1
+
+.wait:
   move.l    $46(a7),d0                    ; Get signal mask argument
   move.l    d0,TASK_WAITS(a1)             ; And store it in the task
+  move.b    #TASK_STATE_WAITING,TASK_STATE(a1)
 
   move.l    #sleeping_list,a0             ; Put current task on the sleeping list
   bsr       list_add_head
@@ -364,11 +481,176 @@ task_wait::
 .reenable_return:
                                           ; New task return address is on the stack at this point...  
   bra       enable_interrupts             ; so enable interrupts...                                    
-  rts                                     ; ... and return to the new task
+
+
+; Take signals from the current task's pending signals.
+;
+; Arguments:
+;   d0 - Signal mask
+;
+; Returns:
+;   d0 - Signals in the mask that were pending (now cleared), Z set if none
+;
+; Modifies:
+;   a0
+;
+; **must** be called with interrupts disabled.
+;
+take_pending:
+  move.l    current_task_var,a0
+  and.l     TASK_PENDS(a0),d0             ; Which of them are pending?
+  beq       .done
+  eor.l     d0,TASK_PENDS(a0)             ; Those are taken, clear them
+  tst.l     d0                            ; (and set flags for the caller)
+
+.done:
+  rts
+
+
+; Sleep for a number of ticks (at least one).
+;
+; C-callable:
+;   void task_sleep(uint32_t ticks);
+;
+task_sleep::
+  move.l    4(a7),d0                      ; Get ticks argument
+  bne       .sleep
+  moveq.l   #1,d0                         ; Zero would mean forever - make it one
+
+.sleep:
+  move.l    d0,-(a7)                      ; Wait with that timeout...
+  clr.l     -(a7)                         ; ... for no signals
+  bsr       task_wait_timeout
+  addq.l    #8,a7
+  rts
+
+
+; Timer handler for task_wait_timeout. If the task is still
+; waiting, takes it off the sleeping list and makes it runnable,
+; with wait returning zero.
+;
+; Called from the tick handler (via timer_tick), so interrupts
+; are already disabled, and the timer is already off the wheel.
+;
+; C-callable:
+;   void task_timeout(Timer *timer);
+;
+task_timeout:
+  move.l    4(a7),a0                      ; Get the timer...
+  sub.l     #TASK_TIMER,a0                ; ... and from that, its task
+  cmp.b     #TASK_STATE_WAITING,TASK_STATE(a0)
+  bne       .done                         ; Nothing to do if it isn't waiting
+
+  bsr       list_node_delete              ; Remove the task from the sleeping list
+  move.l    TASK_STACK(a1),a0             ; No signals received...
+  clr.l     (a0)                          ; ... into D0 slot on its stack
+  bsr       runnable_add_head             ; And add it to run next (in it's respective priority)
+
+.done:
+  rts
+
+
+; Block the current task, until something calls task_unblock
+; on it. It must already be on whatever wait queue it's waiting 
+; in, with state TASK_STATE_WAITING.
+;
+; C-callable:
+;   void task_block(void);
+;
+; **must** be called with interrupts disabled, and returns with
+; them still disabled.
+;
+; Internal API.
+;
+task_block::
+  move.l    #.return,-(a7)                ; We come back here when unblocked
+  bsr       suspend                       ; Suspend current task...
+  bra       task_switch_next              ; ... and switch to the next one
+
+.return:
+  rts
+
+
+; Take a blocked task off its wait queue, and make it runnable
+; (next, within its priority).
+;
+; C-callable:
+;   void task_unblock(Task *task);
+;
+; **must** be called with interrupts disabled.
+;
+; Internal API.
+;
+task_unblock::
+  move.l    a1,-(a7)
+  move.l    8(a7),a0
+  bsr       list_node_delete              ; Off the wait queue (task into a1)
+  bsr       stamp_woken
+  bsr       runnable_add_head             ; And onto its runnable queue
+  move.l    (a7)+,a1
+  rts
+
+
+; Record when the task in a1 was woken, for its latency
+; statistics. Stored plus one, so zero means "not woken".
+;
+; Modifies:
+;   d0      - Trashed
+;
+stamp_woken:
+  move.l    SDB_UPTICKS,d0
+  addq.l    #1,d0
+  move.l    d0,TASK_WOKEN(a1)
+  rts
+
+
+; Change a task's priority. If it's runnable, it's moved to
+; the tail of the new priority's queue.
+;
+; C-callable:
+;   void task_set_priority(Task *task, priority_t priority);
+;
+; **must** be called with interrupts disabled.
+;
+; Internal API.
+;
+task_set_priority::
+  move.l    a1,-(a7)
+  move.l    8(a7),a1                      ; Get the task
+  move.l    12(a7),d1                     ; And the new priority
+
+  cmp.b     #TASK_STATE_RUNNABLE,TASK_STATE(a1)
+  bne       .set                          ; Not on a runnable queue, just set it
+
+  move.l    a1,a0                         ; Take it off its current queue...
+  bsr       list_node_delete
+  bsr       runnable_priority_queue_ptr
+  move.l    NODE_NEXT(a0),a0              ; ... did that empty the queue?
+  tst.l     NODE_NEXT(a0)
+  bne       .move
+  moveq.l   #3,d0                         ; Clear its bit if so
+  and.b     TASK_PRIO(a1),d0
+  bclr      d0,runnable_mask
+
+.move:
+  move.b    d1,TASK_PRIO(a1)              ; Now put it on the new one
+  bsr       runnable_add_tail
+  bra       .done
+
+.set:
+  move.b    d1,TASK_PRIO(a1)
+
+.done:
+  move.l    (a7)+,a1
+  rts
 
 
 ; Signal a task.
 ;
+; The signals are latched in the task's pending signals. If
+; it's waiting for any of those, it's woken and they're taken,
+; otherwise they're left there for its next wait.
+;
 ; C-callable:
 ;   void task_signal(Task *task, uint32_t sig_mask);
 ;
@@ -387,27 +669,37 @@ task_signal::
   move.l    d1,-(a7)
   move.l    d0,-(a7)
 
-  move.l    $56(a7),a1                    ; Get the target task argument
+  move.l    $56(a7),a0                    ; Get the target task argument
   move.l    $5a(a7),d0                    ; Get the signal mask
-  move.l    d0,.temp                      ; Stash signal argument for wait's return value
-
-  move.l    sleeping_list,a0              ; Start at head of sleeping list
-.loop
-  cmp.l     a0,a1                         ; Is this sleeping task our target?
-  beq       .check_sig                    ; Check its signal mask if so...
-  cmp.l     #sleeping_tail,a0             ; Else, did we reach the end of the list?
-  beq       .notfound                     ; No matching task if so...
-  move.l    TASK_NEXT(a0),a0              ; Otherwise, try next task...
-  bra       .loop                         ; ... and loop
-
-.check_sig:
-  and.l     TASK_WAITS(a0),d0             ; Matching task - is it waiting for the right signal(s)?
+  or.l      d0,TASK_PENDS(a0)             ; Latch them, in case it isn't waiting for them (yet)
+
+  cmp.b     #TASK_STATE_WAITING,TASK_STATE(a0)  ; Is the target waiting at all?
+  bne       .notfound                     ; Nothing to do if not...
+
+  move.l    TASK_WAITS(a0),d0             ; It is - is it waiting for any pending signal(s)?
+  and.l     TASK_PENDS(a0),d0
   beq       .notfound                     ; If zero, right task but wrong signals - just quit
 
+  eor.l     d0,TASK_PENDS(a0)             ; Taking those...
+  move.l    d0,.temp                      ; ... stash for wait's return value
+
 .found:
   bsr       list_node_delete              ; Found it - remove it from the sleeping list
+
+  lea       TASK_TIMER(a1),a0             ; Does it have a timeout armed?
+  tst.l     NODE_NEXT(a0)
+  beq       .no_timeout
+
+  move.l    a1,-(a7)                      ; It does - cancel it
+  move.l    a0,-(a7)
+  bsr       timer_cancel
+  addq.l    #4,a7
+  move.l    (a7)+,a1
+
+.no_timeout:
   move.l    TASK_STACK(a1),a2             ; Get actual signals back from temp variable...
   move.l    .temp,(a2)                    ; ... and put into D0 slot on target task's stack
+  bsr       stamp_woken
 
   ; Not using switch_a1 etc here, we need to fiddle the registers for wait's return value...
   ifd       DEBUG_SCHED                   ; Debug tracing task switches
@@ -435,11 +727,11 @@ task_signal::
   cmp       #tidle,a1                     ; Never add the idle task to the runnable list
   beq       .do_switch
 
-  bsr       runnable_priority_queue_ptr   ; Not the idle task, so add to the end of the list
-  bsr       list_add_tail                 ; ...
+  bsr       runnable_add_tail             ; Not the idle task, so add to the end of the list
 
 .do_switch:
   move.l    a2,a1                         ; Get next task back into a1 for switch
+  move.b    #TASK_STATE_RUNNING,TASK_STATE(a1)
 
   move.l    a1,current_task_var           ; Store new task in the current_task variable
   move.l    TASK_STACK(a1),a7             ; Switch stacks to the new task's stack  
@@ -458,8 +750,7 @@ task_signal::
 ;; Conditional - only if -DSIG_IMMED - switch immediately on signal
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
-  bsr       runnable_priority_queue_ptr   ; Find the right priority list for it
-  bsr       list_add_head                 ; And add it to run next (in it's respective priority)
+  bsr       runnable_add_head             ; And add it to run next (in it's respective priority)
 
 .notfound:
   move.l    (a7)+,d0                      ; No matching (waiting) task - abort switch.
@@ -529,6 +820,81 @@ task_kick_off::
   rts                                     ; return to the new task
 
 
+; Get a task's statistics. They're copied with interrupts
+; disabled, since the tick handler updates them.
+;
+; C-callable:
+;   void task_get_stats(Task *task, TaskStats *stats);
+;
+; A NULL task means the current one.
+;
+task_get_stats::
+  bsr       disable_interrupts
+  move.l    4(a7),d0                      ; Get the task...
+  bne       .copy
+  move.l    current_task_var,d0           ; ... or the current one
+
+.copy:
+  move.l    d0,a0
+  lea       TASK_SWITCHES(a0),a0
+  move.l    8(a7),a1                      ; And copy the stats out
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  bra       enable_interrupts
+
+
+; Get the most recent events from the trace ring, oldest first.
+;
+; C-callable:
+;   uint32_t sched_trace_read(SchedTraceEvent *events, uint32_t count);
+;
+; Returns the number of events copied - no more than asked
+; for, or than are kept (TRACE_EVENTS).
+;
+sched_trace_read::
+  bsr       disable_interrupts
+  move.l    d2,-(a7)
+  move.l    8(a7),a1                      ; Get events buffer
+  move.l    12(a7),d0                     ; And count
+
+  move.l    sched_trace_count,d1          ; How many are kept?
+  moveq.l   #TRACE_EVENTS,d2
+  cmp.l     d2,d1
+  bcc       .clamp
+  move.l    d1,d2                         ; (all of them, if the ring hasn't wrapped)
+
+.clamp:
+  cmp.l     d2,d0                         ; Don't copy more than that
+  bls       .start
+  move.l    d2,d0
+
+.start:
+  move.l    d0,-(a7)                      ; That's the return value
+  sub.l     d0,d1                         ; Start that far back from the end
+  bra       .next
+
+.copy:
+  move.l    d1,d2
+  and.w     #TRACE_EVENTS-1,d2
+  lsl.w     #TRACE_SHIFT,d2
+  lea       sched_trace_ring,a0
+  add.w     d2,a0
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  move.l    (a0)+,(a1)+
+  addq.l    #1,d1
+
+.next:
+  dbra      d0,.copy
+
+  move.l    (a7)+,d0
+  move.l    (a7)+,d2
+  bra       enable_interrupts
+
+
 ; Returns the current task in d0
 ;
 ; Arguments:
@@ -561,8 +927,12 @@ trace_switch:
 ; kernel came along (which is needed for e.g. EOI on the timer device, 
 ; as well as the blinkenlights...)
 ; 
+; It's also where tickless idle (with -DTICKLESS_IDLE) starts and
+; ends - see idle.c.
+;
 tick_handler:
   movem.l   d0-d7/a0-a6,-(a7)
+  move.l    SDB_UPTICKS,upticks_before    ; So we can tell if the chained handler counted a tick
   move.w    #$45,-(a7)                    ; Set up fake exception frame for chained handler rte
   move.l    #post_jump,-(a7)
   move.w    sr,-(a7)
@@ -572,12 +942,45 @@ chain_jump:
   jmp       (a0)
 
 post_jump:
+  move.l    SDB_UPTICKS,d0                ; Was it actually a tick? Other devices
+  cmp.l     upticks_before,d0             ; may share the vector...
+  beq       .not_tick                     ; ... and there's nothing to do if not
+
   bsr       disable_interrupts
+  ifd       TICKLESS_IDLE
+  bsr       tickless_elapsed              ; How many ticks did that cover?
+  move.l    d0,d2
+  else
+  moveq.l   #1,d2                         ; Just the one
+  endif
+
+  move.l    current_task_var,d0           ; Charge them to whoever it interrupted
+  beq       .ticked
+  move.l    d0,a0
+  add.l     d2,TASK_TICKS(a0)
+
+.ticked:
+  subq.w    #1,d2
+
+.timers:
+  bsr       timer_tick                    ; Run any timers that are due
+  dbra      d2,.timers
+
   subq.w    #1,tick_counter               ; Decrease the tick counter by 1
   bne       .tick_handler_done            ; If it's not zero, skip the switch
 
-.switch:
   move.w    #QUANTUM_TICKS,tick_counter   ; Otherwise, reset the counter
+  cmp.l     #tidle,current_task_var       ; Is there anything to switch to?
+  bne       .switch
+  tst.b     runnable_mask
+  bne       .switch
+
+  ifd       TICKLESS_IDLE                 ; Nope, just idle - so no need for
+  bsr       tickless_enter                ; ticks until a timer needs one
+  endif
+  bra       .tick_handler_done
+
+.switch:
   bsr       task_yield                    ; And do a switch
 
 .tick_handler_done:
@@ -585,6 +988,23 @@ post_jump:
   bsr       enable_interrupts
   rte
 
+.not_tick:
+  movem.l   (a7)+,d0-d7/a0-a6
+  rte
+
+
+;;;;;; Constants
+  section .data
+runnable_queues:                          ; Runnable list for each priority
+  dc.l      runnable_list_0
+  dc.l      runnable_list_1
+  dc.l      runnable_list_2
+  dc.l      runnable_list_3
+
+highest_priority:                         ; Highest set bit in the runnable mask
+  dc.b      0,0,1,1,2,2,2,2
+  dc.b      3,3,3,3,3,3,3,3
+
 
 ;;;;;; Variables
   section .bss
@@ -612,4 +1032,10 @@ sleeping_list::                           ; The sleeping list, head & tail for c
 sleeping_head         ds.l    1
 sleeping_tail         ds.l    2
 
+runnable_mask::       ds.b    1           ; Bit n set when runnable_list_n isn't empty
+
+sched_trace_count::   ds.l    1           ; Events ever recorded - the next goes in (count % TRACE_EVENTS)
+sched_trace_ring::    ds.b    TRACE_EVENTS<<TRACE_SHIFT
+
 saved_tick_handler    ds.l    1
+upticks_before        ds.l    1
@@ -26,6 +26,11 @@ extern List irq_4_list;
 extern List irq_5_list;
 extern List irq_6_list;
 extern List irq_7_list;
+extern List irq_vector_lists[IRQ_VECTOR_COUNT];
+extern uint32_t vector_base;
+
+#define TEST_VECTOR         0x50
+#define test_vector_list    irq_vector_lists[TEST_VECTOR - IRQ_VECTOR_FIRST]
 
 static uint8_t nums[4];
 static uint8_t numi;
@@ -43,6 +48,9 @@ static void* test_data_1 = (void*)0x000000AA;
         assert_that(list.head != (ListNode*)&list.tail);    \
     } while (0)
 
+// The handler at the head of a list (which holds the kernel's nodes)
+#define head_handler(list)  (((IrqNode*)list.head)->handler)
+
 #define assert_nums(val0, val1, val2, val3)             \
     do {                                                \
         assert_that(nums[0] == val0);                   \
@@ -89,7 +97,7 @@ static int test_register_irq_1() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(1, &handler);
+    assert_true(irq_register_c(1, &handler));
 
     assert_not_empty(irq_1_list);
 
@@ -110,7 +118,7 @@ static int test_register_irq_2() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(2, &handler);
+    assert_true(irq_register_c(2, &handler));
 
     assert_empty(irq_1_list);
 
@@ -132,7 +140,7 @@ static int test_register_irq_3() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(3, &handler);
+    assert_true(irq_register_c(3, &handler));
 
     assert_empty(irq_1_list);
     assert_empty(irq_2_list);
@@ -154,7 +162,7 @@ static int test_register_irq_4() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(4, &handler);
+    assert_true(irq_register_c(4, &handler));
 
     assert_empty(irq_1_list);
     assert_empty(irq_2_list);
@@ -176,7 +184,7 @@ static int test_register_irq_5() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(5, &handler);
+    assert_true(irq_register_c(5, &handler));
 
     assert_empty(irq_1_list);
     assert_empty(irq_2_list);
@@ -198,7 +206,7 @@ static int test_register_irq_6() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(6, &handler);
+    assert_true(irq_register_c(6, &handler));
 
     assert_empty(irq_1_list);
     assert_empty(irq_2_list);
@@ -220,7 +228,7 @@ static int test_register_irq_7() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(7, &handler);
+    assert_true(irq_register_c(7, &handler));
 
     assert_empty(irq_1_list);
     assert_empty(irq_2_list);
@@ -241,7 +249,7 @@ static int test_remove() {
 
     handler.handler = test_handler_empty_false;
 
-    irq_register_c(7, &handler);
+    assert_true(irq_register_c(7, &handler));
     
     assert_not_empty(irq_7_list);
 
@@ -279,7 +287,7 @@ static int test_run_chain_one_none_succeed() {
     IrqHandler handler;
 
     handler.handler = test_handler_one_false;
-    irq_register_c(1, &handler);
+    assert_true(irq_register_c(1, &handler));
 
     run_handler_chain_c(1);
 
@@ -297,9 +305,9 @@ static int test_run_chain_three_none_succeed() {
     handler0.handler = test_handler_one_false;
     handler1.handler = test_handler_two_false;
     handler2.handler = test_handler_three_false;
-    irq_register_c(1, &handler0);
-    irq_register_c(1, &handler1);
-    irq_register_c(1, &handler2);
+    assert_true(irq_register_c(1, &handler0));
+    assert_true(irq_register_c(1, &handler1));
+    assert_true(irq_register_c(1, &handler2));
 
     run_handler_chain_c(1);
 
@@ -316,9 +324,9 @@ static int test_run_chain_three_two_succeeds() {
     handler0.handler = test_handler_one_false;
     handler1.handler = test_handler_two_true;
     handler2.handler = test_handler_three_false;
-    irq_register_c(1, &handler0);
-    irq_register_c(1, &handler1);
-    irq_register_c(1, &handler2);
+    assert_true(irq_register_c(1, &handler0));
+    assert_true(irq_register_c(1, &handler1));
+    assert_true(irq_register_c(1, &handler2));
 
     run_handler_chain_c(1);
 
@@ -337,8 +345,8 @@ static int test_run_chain_correct_data_1() {
     handler1.handler = test_handler_data_test;
     handler1.data = test_data_1;
 
-    irq_register_c(1, &handler0);
-    irq_register_c(1, &handler1);
+    assert_true(irq_register_c(1, &handler0));
+    assert_true(irq_register_c(1, &handler1));
 
     run_handler_chain_c(1);
 
@@ -356,8 +364,8 @@ static int test_run_chain_correct_data_5() {
     handler1.handler = test_handler_data_test;
     handler1.data = test_data_1;
 
-    irq_register_c(5, &handler0);
-    irq_register_c(5, &handler1);
+    assert_true(irq_register_c(5, &handler0));
+    assert_true(irq_register_c(5, &handler1));
 
     run_handler_chain_c(5);
 
@@ -366,6 +374,218 @@ static int test_run_chain_correct_data_5() {
     return RTEST_PASS;
 }
 
+static int test_run_chain_moves_claimer_to_front() {
+    IrqHandler handler0;
+    IrqHandler handler1;
+    IrqHandler handler2;
+
+    handler0.handler = test_handler_one_false;
+    handler1.handler = test_handler_two_true;
+    handler2.handler = test_handler_three_false;
+    assert_true(irq_register_c(1, &handler0));
+    assert_true(irq_register_c(1, &handler1));
+    assert_true(irq_register_c(1, &handler2));
+
+    run_handler_chain_c(1);
+
+    assert_that(irq_hits_c(&handler1) == 1);
+    assert_that(irq_hits_c(&handler0) == 0);
+    assert_that(head_handler(irq_1_list) == &handler1);
+
+    // Second time, two is tried (and claims) first
+    run_handler_chain_c(1);
+
+    assert_nums(1, 2, 2, 0);
+    assert_that(irq_hits_c(&handler1) == 2);
+
+    return RTEST_PASS;
+}
+
+bool run_vector_chain_c(uint8_t vec);
+
+static int test_register_vector() {
+    IrqHandler handler;
+
+    handler.handler = test_handler_empty_false;
+
+    assert_true(irq_register_c(TEST_VECTOR, &handler));
+
+    assert_not_empty(test_vector_list);
+
+    assert_empty(irq_1_list);
+    assert_empty(irq_2_list);
+    assert_empty(irq_3_list);
+    assert_empty(irq_4_list);
+    assert_empty(irq_5_list);
+    assert_empty(irq_6_list);
+    assert_empty(irq_7_list);
+
+    irq_remove_c(&handler);
+
+    assert_empty(test_vector_list);
+
+    return RTEST_PASS;
+}
+
+static int test_register_out_of_range() {
+    IrqHandler handler;
+
+    handler.handler = test_handler_empty_false;
+
+    assert_false(irq_register_c(0, &handler));
+    assert_false(irq_register_c(8, &handler));
+    assert_false(irq_register_c(IRQ_VECTOR_FIRST + IRQ_VECTOR_COUNT, &handler));
+    assert_false(irq_register_c(1, NULL));
+
+    assert_empty(irq_1_list);
+    assert_empty(irq_7_list);
+    assert_empty(irq_vector_lists[0]);
+    assert_empty(irq_vector_lists[IRQ_VECTOR_COUNT - 1]);
+
+    return RTEST_PASS;
+}
+
+static int test_run_vector_claimed() {
+    IrqHandler handler0;
+    IrqHandler handler1;
+    IrqHandler handler2;
+
+    handler0.handler = test_handler_one_false;
+    handler1.handler = test_handler_two_true;
+    handler2.handler = test_handler_data_test;
+    assert_true(irq_register_c(TEST_VECTOR, &handler0));
+    assert_true(irq_register_c(TEST_VECTOR, &handler1));
+
+    // Not on this vector, so never run
+    assert_true(irq_register_c(TEST_VECTOR + 1, &handler2));
+
+    assert_that(run_vector_chain_c(TEST_VECTOR));
+
+    assert_nums(1, 2, 0, 0);
+    assert_that(irq_hits_c(&handler1) == 1);
+    assert_that(head_handler(test_vector_list) == &handler1);
+
+    return RTEST_PASS;
+}
+
+static int test_run_vector_gets_vector() {
+    IrqHandler handler;
+
+    handler.handler = test_handler_data_test;
+    handler.data = test_data_1;
+    assert_true(irq_register_c(TEST_VECTOR, &handler));
+
+    // Not claimed - and not in an interrupt, so no level to fall back to
+    assert_that(!run_vector_chain_c(TEST_VECTOR));
+
+    assert_nums(TEST_VECTOR, 0xaa, 0, 0);
+
+    return RTEST_PASS;
+}
+
+static int test_handler_not_written() {
+    // Callers built against an older (smaller) IrqHandler must not
+    // have anything after it overwritten
+    struct {
+        IrqHandler handler;
+        uint32_t guard;
+    } h;
+
+    h.handler.handler = test_handler_two_true;
+    h.guard = 0xC0FFEE42;
+    assert_true(irq_register_c(1, &h.handler));
+
+    run_handler_chain_c(1);
+
+    assert_nums(2, 0, 0, 0);
+    assert_that(h.guard == 0xC0FFEE42);
+    assert_that(irq_hits_c(&h.handler) == 1);
+
+    irq_remove_c(&h.handler);
+
+    assert_empty(irq_1_list);
+    assert_that(h.guard == 0xC0FFEE42);
+
+    return RTEST_PASS;
+}
+
+static int test_register_full() {
+    IrqHandler handlers[IRQ_MAX_HANDLERS + 1];
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        handlers[i].handler = test_handler_empty_false;
+        assert_true(irq_register_c(2, &handlers[i]));
+    }
+
+    // The last one doesn't fit, on a level or a vector...
+    handlers[IRQ_MAX_HANDLERS].handler = test_handler_empty_false;
+    assert_false(irq_register_c(2, &handlers[IRQ_MAX_HANDLERS]));
+    assert_false(irq_register_c(TEST_VECTOR, &handlers[IRQ_MAX_HANDLERS]));
+    assert_empty(test_vector_list);
+
+    irq_remove_c(&handlers[IRQ_MAX_HANDLERS]);
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        irq_remove_c(&handlers[i]);
+    }
+
+    // ... so removing the others empties the list
+    assert_empty(irq_2_list);
+
+    // And a node that's freed can be used again
+    handlers[0].handler = test_handler_one_false;
+    assert_true(irq_register_c(2, &handlers[0]));
+    run_handler_chain_c(2);
+
+    assert_nums(1, 0, 0, 0);
+
+    return RTEST_PASS;
+}
+
+static int test_remove_not_registered() {
+    IrqHandler handler0;
+    IrqHandler handler1;
+
+    handler0.handler = test_handler_one_false;
+    assert_true(irq_register_c(3, &handler0));
+
+    irq_remove_c(&handler1);
+    irq_remove_c(NULL);
+
+    run_handler_chain_c(3);
+
+    assert_nums(1, 0, 0, 0);
+    assert_that(irq_hits_c(&handler1) == 0);
+
+    return RTEST_PASS;
+}
+
+static int test_remove_vector_restores() {
+    IrqHandler handler0;
+    IrqHandler handler1;
+
+    // A vector no other test registers on, so it has its original handler
+    volatile uint32_t *slot = (uint32_t*)vector_base + TEST_VECTOR + 2;
+    uint32_t original = *slot;
+
+    handler0.handler = test_handler_empty_false;
+    handler1.handler = test_handler_empty_false;
+    assert_true(irq_register_c(TEST_VECTOR + 2, &handler0));
+    assert_true(irq_register_c(TEST_VECTOR + 2, &handler1));
+
+    assert_that(*slot != original);
+
+    // Still one handler, so the kernel's stub stays...
+    irq_remove_c(&handler0);
+    assert_that(*slot != original);
+
+    // ... until that's gone too
+    irq_remove_c(&handler1);
+    assert_that(*slot == original);
+
+    return RTEST_PASS;
+}
+
 static void setup() {
     irq_init();
 
@@ -397,6 +617,17 @@ static RTest tests[] = {
 
     { "/irq/run_chain_argument_test_irq1",  test_run_chain_correct_data_1,      setup,              NULL },
     { "/irq/run_chain_argument_test_irq5",  test_run_chain_correct_data_5,      setup,              NULL },
+    { "/irq/run_chain_moves_claimer_front", test_run_chain_moves_claimer_to_front, setup,           NULL },
+
+    { "/irq/register_vector",               test_register_vector,               setup,              NULL },
+    { "/irq/register_out_of_range",         test_register_out_of_range,         setup,              NULL },
+    { "/irq/run_vector_claimed",            test_run_vector_claimed,            setup,              NULL },
+    { "/irq/run_vector_gets_vector",        test_run_vector_gets_vector,        setup,              NULL },
+
+    { "/irq/handler_not_written",           test_handler_not_written,           setup,              NULL },
+    { "/irq/register_full",                 test_register_full,                 setup,              NULL },
+    { "/irq/remove_not_registered",         test_remove_not_registered,         setup,              NULL },
+    { "/irq/remove_vector_restores",        test_remove_vector_restores,        setup,              NULL },
 
     { NULL, NULL, NULL, NULL },
 };
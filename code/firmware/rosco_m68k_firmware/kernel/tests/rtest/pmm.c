@@ -19,6 +19,223 @@
 #include "list.h"
 #include "pmm.h"
 
+#ifdef PMM_SEGREGATED_BINS
+extern List pmm_bins[];
+extern uint32_t pmm_bin_mask;
+extern uint32_t pmm_edge_bitmap[];
+
+#define page_edge(addr)     ((pmm_edge_bitmap[((addr) >> 10) >> 5] & (1UL << (((addr) >> 10) & 0x1f))) != 0)
+#define tag_of(addr, size)  (*((uint32_t*)((addr) + (size) - 4)))
+#define bin_empty(bin)      (pmm_bins[(bin)].head == (ListNode*)&pmm_bins[(bin)].tail)
+
+static int test_free_first_block() {
+    // Should just add - first block
+    pmm_free(0x40000, 0x100);
+
+    // It's the only block in bin 0, and rounded up to the minimum size
+    assert_that((uint32_t)pmm_bins[0].head == 0x40000);
+    assert_that((ListNode*)pmm_bins[0].head->next == (ListNode*)&pmm_bins[0].tail);
+    assert_that(pmm_bins[0].head->size == 0x400);
+    assert_that(pmm_bin_mask == 0x1);
+
+    // Boundary tag is in the last longword
+    assert_that(tag_of(0x40000, 0x400) == 0x400);
+
+    // And its (only) page is marked
+    assert_that(page_edge(0x40000));
+    assert_false(page_edge(0x3fc00));
+    assert_false(page_edge(0x40400));
+
+    return RTEST_PASS;
+}
+
+static int test_free_coalesce_lower() {
+    pmm_free(0x40000, 0x400);
+
+    // Should get coalesced with block below
+    pmm_free(0x40400, 0x400);
+
+    // One two-page block, in bin 1
+    assert_true(bin_empty(0));
+    assert_that((uint32_t)pmm_bins[1].head == 0x40000);
+    assert_that((ListNode*)pmm_bins[1].head->next == (ListNode*)&pmm_bins[1].tail);
+    assert_that(pmm_bins[1].head->size == 0x800);
+    assert_that(tag_of(0x40000, 0x800) == 0x800);
+    assert_that(pmm_bin_mask == 0x2);
+
+    assert_that(page_edge(0x40000));
+    assert_that(page_edge(0x40400));
+
+    return RTEST_PASS;
+}
+
+static int test_free_coalesce_higher() {
+    pmm_free(0x40400, 0x400);
+
+    // Should get coalesced with block above
+    pmm_free(0x40000, 0x400);
+
+    assert_true(bin_empty(0));
+    assert_that((uint32_t)pmm_bins[1].head == 0x40000);
+    assert_that((ListNode*)pmm_bins[1].head->next == (ListNode*)&pmm_bins[1].tail);
+    assert_that(pmm_bins[1].head->size == 0x800);
+    assert_that(tag_of(0x40000, 0x800) == 0x800);
+    assert_that(pmm_bin_mask == 0x2);
+
+    return RTEST_PASS;
+}
+
+static int test_free_non_contig() {
+    pmm_free(0x40000, 0x400);
+    pmm_free(0x50000, 0x400);
+
+    // Both in bin 0, most recently freed first
+    assert_that((uint32_t)pmm_bins[0].head == 0x50000);
+    assert_that((uint32_t)pmm_bins[0].head->next == 0x40000);
+    assert_that((ListNode*)pmm_bins[0].head->next->next == (ListNode*)&pmm_bins[0].tail);
+    assert_that(pmm_bin_mask == 0x1);
+
+    return RTEST_PASS;
+}
+
+static int test_free_coalesce_gap_filled() {
+    pmm_free(0x40000, 0x800);
+    pmm_free(0x3f800, 0x400);
+
+    // Two separate blocks
+    assert_that((uint32_t)pmm_bins[0].head == 0x3f800);
+    assert_that((uint32_t)pmm_bins[1].head == 0x40000);
+    assert_that(pmm_bin_mask == 0x3);
+
+    // Should cause all blocks to coalesce as it fills the gap
+    pmm_free(0x3fc00, 0x400);
+
+    // Now we're back to one block, of four pages
+    assert_true(bin_empty(0));
+    assert_true(bin_empty(1));
+    assert_that((uint32_t)pmm_bins[2].head == 0x3f800);
+    assert_that((ListNode*)pmm_bins[2].head->next == (ListNode*)&pmm_bins[2].tail);
+    assert_that(pmm_bins[2].head->size == 0x1000);
+    assert_that(tag_of(0x3f800, 0x1000) == 0x1000);
+    assert_that(pmm_bin_mask == 0x4);
+
+    // Only the outer pages are marked
+    assert_that(page_edge(0x3f800));
+    assert_false(page_edge(0x3fc00));
+    assert_false(page_edge(0x40000));
+    assert_that(page_edge(0x40400));
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_whole_block() {
+    // Should just take the 1024-byte block at 0x50000
+    uintptr_t x50000 = pmm_alloc(0x400);
+    assert_that(x50000 == 0x50000);
+
+    assert_true(bin_empty(0));
+    assert_that(pmm_bin_mask == 0xa);
+    assert_false(page_edge(0x50000));
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_split_large_block() {
+    // Three pages - only bin 3 is sure to fit, so should split the 8KiB block
+    uintptr_t x42000 = pmm_alloc(0xc00);
+    assert_that(x42000 == 0x42000);
+
+    // Remaining five pages are now in bin 2
+    assert_true(bin_empty(3));
+    assert_that((uint32_t)pmm_bins[2].head == 0x42c00);
+    assert_that(pmm_bins[2].head->size == 0x1400);
+    assert_that(tag_of(0x42c00, 0x1400) == 0x1400);
+    assert_that(pmm_bin_mask == 0x7);
+
+    assert_false(page_edge(0x42000));
+    assert_that(page_edge(0x42c00));
+    assert_that(page_edge(0x43c00));
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_search_own_bin() {
+    pmm_free(0x40000, 0xc00);
+
+    // Nothing in a higher bin, but the three-page block in bin 1 fits
+    uintptr_t x40000 = pmm_alloc(0xc00);
+    assert_that(x40000 == 0x40000);
+
+    assert_that(pmm_bin_mask == 0);
+    assert_false(page_edge(0x40000));
+    assert_false(page_edge(0x40800));
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_too_fragmented() {
+    // 11KiB free in total, but no block big enough
+    assert_that(pmm_alloc(0x2400) == 0);
+
+    // Nothing changed
+    assert_that(pmm_bin_mask == 0xb);
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_free_roundtrip() {
+    uintptr_t x42000 = pmm_alloc(0x1800);
+    assert_that(x42000 == 0x42000);
+
+    assert_that((uint32_t)pmm_bins[1].head == 0x43800);
+    assert_that((uint32_t)pmm_bins[1].head->next == 0x40000);
+
+    // Should coalesce straight back into the 8KiB block
+    pmm_free(x42000, 0x1800);
+
+    assert_that((uint32_t)pmm_bins[3].head == 0x42000);
+    assert_that(pmm_bins[3].head->size == 0x2000);
+    assert_that(tag_of(0x42000, 0x2000) == 0x2000);
+    assert_that((uint32_t)pmm_bins[1].head == 0x40000);
+    assert_that((ListNode*)pmm_bins[1].head->next == (ListNode*)&pmm_bins[1].tail);
+
+    return RTEST_PASS;
+}
+
+void setup() {
+    pmm_init();
+}
+
+void setup_alloc() {
+    pmm_init();
+
+    // Just set up three blocks for the tests:
+    //
+    //    0x40000   - 0x800 bytes   (bin 1)
+    //    0x42000   - 0x2000 bytes  (bin 3)
+    //    0x50000   - 0x400 bytes   (bin 0)
+    //
+    pmm_free(0x40000, 0x800);
+    pmm_free(0x42000, 0x2000);
+    pmm_free(0x50000, 0x40);
+}
+
+static RTest tests[] = {
+    { "/pmm/bins/free_first_block",         test_free_first_block,              setup, NULL },
+    { "/pmm/bins/free_coalesce_lower",      test_free_coalesce_lower,           setup, NULL },
+    { "/pmm/bins/free_coalesce_higher",     test_free_coalesce_higher,          setup, NULL },
+    { "/pmm/bins/free_non_contig",          test_free_non_contig,               setup, NULL },
+    { "/pmm/bins/free_coalesce_filled_gap", test_free_coalesce_gap_filled,      setup, NULL },
+
+    { "/pmm/bins/alloc_whole_block",        test_alloc_whole_block,             setup_alloc, NULL },
+    { "/pmm/bins/alloc_split_large_block",  test_alloc_split_large_block,       setup_alloc, NULL },
+    { "/pmm/bins/alloc_search_own_bin",     test_alloc_search_own_bin,          setup, NULL },
+    { "/pmm/bins/alloc_too_fragmented",     test_alloc_too_fragmented,          setup_alloc, NULL },
+    { "/pmm/bins/alloc_free_roundtrip",     test_alloc_free_roundtrip,          setup_alloc, NULL },
+    { NULL, NULL, NULL, NULL },
+};
+
+#else
 extern List pmm_addr_list;
 extern List pmm_size_list;
 
@@ -374,6 +591,7 @@ static RTest tests[] = {
     { "/pmm/alloc_multiple",                test_alloc_multiple,                setup_alloc, NULL },
     { NULL, NULL, NULL, NULL },
 };
+#endif//PMM_SEGREGATED_BINS
 
 void pmm_suite(void) {
     rtest_main(tests);
@@ -0,0 +1,101 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Benchmark: pmm allocator under fragmentation
+ *
+ * Frees every other page of a 512KiB region, then repeatedly
+ * frees one of the gaps (coalescing three pages), allocates
+ * the resulting block and frees its ends again, so every
+ * operation happens with ~256 free blocks around.
+ *
+ * Timing is from the 100Hz tick, scaled by the CPU speed the
+ * firmware measured at boot, so cycle counts are approximate.
+ * Compare the figures from `units.bin` and `units_bins.bin`.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "pmm.h"
+
+#define BENCH_BASE          0x60000
+#define BENCH_PAGES         512
+#define BENCH_PASSES        2
+
+static volatile uint32_t * const upticks = (uint32_t*)0x40c;
+static volatile uint32_t * const cpuinfo = (uint32_t*)0x41c;
+
+#define page_addr(n)        (BENCH_BASE + ((n) << 10))
+
+static int test_bench_fragmented() {
+    // Carve the region up into single pages, then free the even ones
+    pmm_free(BENCH_BASE, BENCH_PAGES << 10);
+
+    for (int i = 0; i < BENCH_PAGES; i++) {
+        assert_that(pmm_alloc(0x400) != 0);
+    }
+
+    for (int i = 0; i < BENCH_PAGES; i += 2) {
+        pmm_free(page_addr(i), 0x400);
+    }
+
+    uint32_t ops = 0;
+    uint32_t start = *upticks;
+
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        for (int i = 1; i < BENCH_PAGES - 1; i += 2) {
+            // Fill the gap, coalescing with the pages either side...
+            pmm_free(page_addr(i), 0x400);
+
+            // ... that's now the only block big enough
+            uintptr_t block = pmm_alloc(0xc00);
+            assert_that(block == page_addr(i - 1));
+
+            // ... and put the fragments back
+            pmm_free(block, 0x400);
+            pmm_free(block + 0x800, 0x400);
+
+            ops += 4;
+        }
+    }
+
+    uint32_t ticks = *upticks - start;
+    uint32_t hz = *cpuinfo & 0x1FFFFFFF;
+
+#ifdef PMM_SEGREGATED_BINS
+    rt_printf("\n    segregated bins: ");
+#else
+    rt_printf("\n    sorted lists: ");
+#endif
+    rt_printf("%d ops in %d ticks", ops, ticks);
+
+    if (hz != 0 && ops != 0) {
+        rt_printf(" (~%d cycles/op)", ticks * (hz / 100) / ops);
+    }
+
+    rt_printf("\n%-40s", "");
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    pmm_init();
+}
+
+static RTest tests[] = {
+    { "/pmm/bench/fragmented",              test_bench_fragmented,              setup, NULL },
+    { NULL, NULL, NULL, NULL },
+};
+
+void pmm_bench_suite(void) {
+    rtest_main(tests);
+}
@@ -0,0 +1,242 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Unit tests: slab caches
+ *
+ * These only check the memory given back to pmm by asking
+ * for all of it again, so they work with either pmm mode.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "pmm.h"
+#include "slab.h"
+
+#define TEST_BASE       0x50000
+#define TEST_SIZE       0x8000
+
+#define list_empty(l)   ((l).head == (ListNode*)&(l).tail)
+
+static SlabCache test_cache;
+static void *objects[64];
+
+static int all_memory_free() {
+    uintptr_t block = pmm_alloc(TEST_SIZE);
+
+    if (block != TEST_BASE) {
+        return 0;
+    }
+
+    pmm_free(block, TEST_SIZE);
+    return 1;
+}
+
+static int test_init_sizes() {
+    assert_that(slab_cache_init_c(&test_cache, 24) == NULL);
+    assert_that(slab_cache_init_c(&test_cache, 512) == NULL);
+    assert_that(slab_cache_init_c(&test_cache, 64) == &test_cache);
+
+    assert_that(test_cache.object_size == 64);
+    assert_that(test_cache.object_shift == 6);
+    assert_that(list_empty(test_cache.partial));
+    assert_that(list_empty(test_cache.full));
+    assert_that(list_empty(test_cache.empty));
+
+    return RTEST_PASS;
+}
+
+static int test_cache_for() {
+    assert_that(slab_cache_for_c(1) == &slab_caches[0]);
+    assert_that(slab_cache_for_c(16) == &slab_caches[0]);
+    assert_that(slab_cache_for_c(17) == &slab_caches[1]);
+    assert_that(slab_cache_for_c(64) == &slab_caches[2]);
+    assert_that(slab_cache_for_c(200) == &slab_caches[4]);
+    assert_that(slab_cache_for_c(256) == &slab_caches[4]);
+    assert_that(slab_cache_for_c(257) == NULL);
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_fills_slab() {
+    SlabCache *cache = &slab_caches[0];
+
+    // 16-byte objects, less two for the metadata
+    for (int i = 0; i < 62; i++) {
+        objects[i] = slab_cache_alloc_c(cache);
+        assert_that(objects[i] != NULL);
+        assert_that(objects[i] == (uint8_t*)objects[0] + i * 16);
+    }
+
+    Slab *meta = slab_metadata(objects[0]);
+    assert_that(meta->node.type == NODE_TYPE_SLAB);
+    assert_that(meta->cache == cache);
+    assert_that(meta->bitmap == 0xffffffff);
+    assert_that(meta->bitmap_hi == 0xffffffff);
+
+    assert_that(list_empty(cache->partial));
+    assert_that(cache->full.head == (ListNode*)meta);
+
+    // Next one needs a new slab
+    void *next = slab_cache_alloc_c(cache);
+    assert_that(next != NULL);
+    assert_that(slab_base(next) != slab_base(objects[0]));
+    assert_that(cache->partial.head == (ListNode*)slab_metadata(next));
+
+    return RTEST_PASS;
+}
+
+static int test_free_reuses_object() {
+    SlabCache *cache = &slab_caches[1];
+
+    for (int i = 0; i < 31; i++) {
+        objects[i] = slab_cache_alloc_c(cache);
+    }
+
+    assert_that(list_empty(cache->partial));
+
+    // Freeing from a full slab puts it back on partial...
+    slab_cache_free_c(objects[7]);
+    assert_that(cache->partial.head == (ListNode*)slab_metadata(objects[0]));
+    assert_that(list_empty(cache->full));
+
+    // ... and the next alloc gets the same object back
+    assert_that(slab_cache_alloc_c(cache) == objects[7]);
+
+    return RTEST_PASS;
+}
+
+static int test_empty_slab_kept() {
+    SlabCache *cache = &slab_caches[2];
+
+    void *obj = slab_cache_alloc_c(cache);
+    assert_that(obj != NULL);
+
+    slab_cache_free_c(obj);
+
+    // Kept on the empty list, not returned to pmm...
+    assert_that(cache->empty_count == 1);
+    assert_that(cache->empty.head == (ListNode*)slab_metadata(obj));
+    assert_that(list_empty(cache->partial));
+    assert_that(!all_memory_free());
+
+    // ... and used again for the next alloc
+    assert_that(slab_cache_alloc_c(cache) == obj);
+    assert_that(cache->empty_count == 0);
+
+    slab_cache_free_c(obj);
+
+    // Reaping gives it back
+    assert_that(slab_cache_reap_c(cache) == 1);
+    assert_that(cache->empty_count == 0);
+    assert_that(list_empty(cache->empty));
+    assert_that(all_memory_free());
+
+    return RTEST_PASS;
+}
+
+static int test_extra_empty_slabs_released() {
+    SlabCache *cache = &slab_caches[4];
+
+    // 256-byte objects, three per slab - fill two slabs
+    for (int i = 0; i < 6; i++) {
+        objects[i] = slab_cache_alloc_c(cache);
+        assert_that(objects[i] != NULL);
+    }
+
+    for (int i = 0; i < 6; i++) {
+        slab_cache_free_c(objects[i]);
+    }
+
+    // One is kept, the other went straight back
+    assert_that(cache->empty_count == SLAB_CACHE_MAX_EMPTY);
+
+    assert_that(slab_reap_c() == SLAB_CACHE_MAX_EMPTY);
+    assert_that(all_memory_free());
+
+    return RTEST_PASS;
+}
+
+static int test_alloc_reaps_when_out_of_memory() {
+    // Leave an empty slab in the 32-byte cache...
+    slab_cache_free_c(slab_cache_alloc_c(&slab_caches[1]));
+    assert_that(slab_caches[1].empty_count == 1);
+
+    // ... and take all the rest of the memory
+    uintptr_t rest = pmm_alloc(TEST_SIZE - 0x400);
+    assert_that(rest != 0);
+
+    // A different cache can still get a slab
+    void *obj = slab_cache_alloc_c(&slab_caches[3]);
+    assert_that(obj != NULL);
+    assert_that(slab_caches[1].empty_count == 0);
+
+    // But now there really is nothing left
+    assert_that(slab_cache_alloc_c(&slab_caches[0]) == NULL);
+
+    slab_cache_free_c(obj);
+    slab_reap_c();
+    pmm_free(rest, TEST_SIZE - 0x400);
+    assert_that(all_memory_free());
+
+    return RTEST_PASS;
+}
+
+static int test_object_alloc() {
+    // Up to eight blocks come from the caches...
+    void *task = slab_object_alloc_c(2);
+    assert_that(task != NULL);
+    assert_that(slab_metadata(task)->cache == &slab_caches[2]);
+
+    void *big = slab_object_alloc_c(8);
+    assert_that(slab_metadata(big)->cache == &slab_caches[4]);
+
+    // ... bigger ones are contiguous blocks
+    void *huge = slab_object_alloc_c(9);
+    assert_that(huge != NULL);
+    assert_that(slab_metadata(huge)->cache == NULL);
+
+    assert_that(slab_object_alloc_c(0) == NULL);
+    assert_that(slab_object_alloc_c(32) == NULL);
+
+    slab_object_free_c(task, 2);
+    slab_object_free_c(big, 8);
+    slab_object_free_c(huge, 9);
+
+    slab_reap_c();
+    assert_that(all_memory_free());
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    pmm_init();
+    pmm_free(TEST_BASE, TEST_SIZE);
+    slab_init();
+}
+
+static RTest tests[] = {
+    { "/slab_cache/init_sizes",             test_init_sizes,                    setup,       NULL },
+    { "/slab_cache/cache_for",              test_cache_for,                     setup,       NULL },
+    { "/slab_cache/alloc_fills_slab",       test_alloc_fills_slab,              setup,       NULL },
+    { "/slab_cache/free_reuses_object",     test_free_reuses_object,            setup,       NULL },
+    { "/slab_cache/empty_slab_kept",        test_empty_slab_kept,               setup,       NULL },
+    { "/slab_cache/extra_empties_released", test_extra_empty_slabs_released,    setup,       NULL },
+    { "/slab_cache/alloc_reaps_on_oom",     test_alloc_reaps_when_out_of_memory,setup,       NULL },
+    { "/slab_cache/object_alloc",           test_object_alloc,                  setup,       NULL },
+    { NULL, NULL, NULL, NULL },
+};
+
+void slab_cache_suite(void) {
+    rtest_main(tests);
+}
@@ -15,16 +15,33 @@
 
 void list_suite();
 void pmm_suite();
+void pmm_bench_suite();
 void bitmap_suite();
 void slab_suite();
+void slab_cache_suite();
 void interrupts_suite();
+void timer_suite();
+void task_suite();
+void task_bench_suite();
+void sync_suite();
+void sync_bench_suite();
 
 int main(void) {
     list_suite();
     pmm_suite();
+    pmm_bench_suite();
     bitmap_suite();
+#ifndef PMM_SEGREGATED_BINS
+    // Slab tests are written against the sorted-list pmm
     slab_suite();
+#endif
+    slab_cache_suite();
     interrupts_suite();
+    timer_suite();
+    task_suite();
+    task_bench_suite();
+    sync_suite();
+    sync_bench_suite();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,252 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Unit tests: semaphores, mutexes and message ports
+ *
+ * The test runs as a task (without the tick handler installed)
+ * and yields to let the other task get to where it blocks.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "kmachine.h"
+#include "task.h"
+#include "sync.h"
+
+#define TEST_STACK_SIZE     1024
+
+void task_tee(
+    Task *task,
+    uintptr_t stack_addr,
+    task_handler_f entryhandler,
+    task_handler_f entrypoint,
+    task_handler_f exithandler
+);
+void task_ready(Task *task);
+void task_trampoline(void);
+
+extern Task *current_task_var;
+
+static Task test_main;
+static Task test_task;
+static uint32_t test_stack[TEST_STACK_SIZE / 4];
+static volatile uint32_t done;
+
+static Semaphore sem;
+static Mutex mutex;
+static Port port;
+static void *slots[2];
+static int msgs[3];
+
+static void yield_now() {
+    disable_interrupts();
+    task_yield();
+    enable_interrupts();
+}
+
+static noreturn void wait_forever() {
+    for (;;) {
+        task_wait(0);
+    }
+}
+
+static void sem_task(void) {
+    semaphore_wait(&sem);
+    done++;
+    wait_forever();
+}
+
+static void mutex_task(void) {
+    mutex_lock(&mutex);
+    done++;
+    mutex_unlock(&mutex);
+    wait_forever();
+}
+
+static void put_task(void) {
+    for (int i = 0; i < 3; i++) {
+        port_put(&port, &msgs[i]);
+        done++;
+    }
+
+    wait_forever();
+}
+
+static void init_task(Task *task, tid_t tid, priority_t priority) {
+    task->node.next = NULL;
+    task->node.prev = NULL;
+    task->node.type = NODE_TYPE_TASK;
+    task->node.size = sizeof(Task);
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
+    task->priority = priority;
+    task->state = TASK_STATE_RUNNING;
+    task->tid = tid;
+}
+
+static void start_task(task_handler_f entrypoint, priority_t priority) {
+    init_task(&test_task, 1, priority);
+    task_tee(&test_task, (uintptr_t)&test_stack[TEST_STACK_SIZE / 4], task_trampoline, entrypoint, halt_and_catch_fire);
+
+    disable_interrupts();
+    task_ready(&test_task);
+    enable_interrupts();
+
+    // Let it get to where it blocks
+    yield_now();
+}
+
+static int test_semaphore_counts() {
+    semaphore_init(&sem, 2);
+
+    semaphore_wait(&sem);
+    semaphore_wait(&sem);
+    assert_that(sem.count == 0);
+
+    semaphore_signal(&sem);
+    assert_that(sem.count == 1);
+    assert_that(sem.wakeups == 0);
+
+    return RTEST_PASS;
+}
+
+static int test_semaphore_blocks() {
+    semaphore_init(&sem, 0);
+
+    start_task(sem_task, 1);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+    assert_that(sem.waiters.head == (ListNode*)&test_task);
+    assert_that(sem.count == -1);
+
+    // Signals don't wake it
+    task_signal(&test_task, 0xffffffff);
+    yield_now();
+    assert_that(done == 0);
+
+    semaphore_signal(&sem);
+    assert_that(test_task.state == TASK_STATE_RUNNABLE);
+    assert_that(sem.count == 0);
+
+    yield_now();
+    assert_that(done == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_mutex_handoff() {
+    mutex_init(&mutex);
+
+    mutex_lock(&mutex);
+    assert_that(mutex.owner == &test_main);
+
+    start_task(mutex_task, 1);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+
+    // Unlocking hands it straight to the waiter
+    mutex_unlock(&mutex);
+    assert_that(mutex.owner == &test_task);
+    assert_that(test_task.state == TASK_STATE_RUNNABLE);
+
+    yield_now();
+    assert_that(done == 1);
+    assert_that(mutex.owner == NULL);
+    assert_that(mutex.sem.count == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_mutex_lends_priority() {
+    mutex_init(&mutex);
+    mutex_lock(&mutex);
+
+    // Higher priority than us, so it runs (and blocks) before we get back...
+    start_task(mutex_task, 2);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+
+    // ... and we now run at its priority
+    assert_that(test_main.priority == 2);
+    assert_that(mutex.boosted);
+
+    mutex_unlock(&mutex);
+    assert_that(test_main.priority == 1);
+    assert_that(!mutex.boosted);
+
+    yield_now();
+    assert_that(done == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_port_order() {
+    assert_that(port_init(&port, slots, 3) == NULL);
+    assert_that(port_init(&port, slots, 2) == &port);
+
+    port_put(&port, &msgs[0]);
+    port_put(&port, &msgs[1]);
+    assert_that(port_get(&port) == &msgs[0]);
+
+    port_put(&port, &msgs[2]);
+    assert_that(port_get(&port) == &msgs[1]);
+    assert_that(port_get(&port) == &msgs[2]);
+
+    return RTEST_PASS;
+}
+
+static int test_port_blocks_when_full() {
+    port_init(&port, slots, 2);
+
+    start_task(put_task, 1);
+    assert_that(done == 2);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+
+    assert_that(port_get(&port) == &msgs[0]);
+    assert_that(test_task.state == TASK_STATE_RUNNABLE);
+
+    yield_now();
+    assert_that(done == 3);
+
+    assert_that(port_get(&port) == &msgs[1]);
+    assert_that(port_get(&port) == &msgs[2]);
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    task_init();
+    init_task(&test_main, 0, 1);
+    current_task_var = &test_main;
+    done = 0;
+}
+
+static void teardown() {
+    // Abandon the task where it is - it'll never run again
+    current_task_var = NULL;
+}
+
+static RTest tests[] = {
+    { "/sync/semaphore_counts",             test_semaphore_counts,              setup,       teardown },
+    { "/sync/semaphore_blocks",             test_semaphore_blocks,              setup,       teardown },
+    { "/sync/mutex_handoff",                test_mutex_handoff,                 setup,       teardown },
+    { "/sync/mutex_lends_priority",         test_mutex_lends_priority,          setup,       teardown },
+    { "/sync/port_order",                   test_port_order,                    setup,       teardown },
+    { "/sync/port_blocks_when_full",        test_port_blocks_when_full,         setup,       teardown },
+    { NULL, NULL, NULL, NULL },
+};
+
+void sync_suite(void) {
+    rtest_main(tests);
+}
@@ -0,0 +1,158 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Benchmark: uncontended synchronisation
+ *
+ * Compares a critical section (and a message ring) protected 
+ * by disabling interrupts with the same protected by a mutex,
+ * a semaphore and a message port. Nothing else is running, so
+ * everything takes the fast path.
+ *
+ * Timing is from the 100Hz tick, scaled by the CPU speed the
+ * firmware measured at boot, so cycle counts are approximate.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "kmachine.h"
+#include "task.h"
+#include "sync.h"
+
+#define BENCH_OPS           10000
+#define BENCH_SLOTS         16
+
+extern Task *current_task_var;
+
+static volatile uint32_t * const upticks = (uint32_t*)0x40c;
+static volatile uint32_t * const cpuinfo = (uint32_t*)0x41c;
+
+static Task bench_main;
+static volatile uint32_t counter;
+static uint32_t message;
+
+static void *ring[BENCH_SLOTS];
+static uint32_t ring_head;
+static uint32_t ring_tail;
+
+static void report(char *what, uint32_t ops, uint32_t ticks) {
+    uint32_t hz = *cpuinfo & 0x1FFFFFFF;
+
+    rt_printf("\n    %s: %d in %d ticks", what, ops, ticks);
+
+    if (hz != 0 && ops != 0) {
+        rt_printf(" (~%d cycles each)", ticks * (hz / 100) / ops);
+    }
+
+    rt_printf("\n%-40s", "");
+}
+
+static int test_bench_critical_section() {
+    Mutex mutex;
+    Semaphore sem;
+
+    mutex_init(&mutex);
+    semaphore_init(&sem, 1);
+
+    uint32_t start = *upticks;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        disable_interrupts();
+        counter++;
+        enable_interrupts();
+    }
+
+    report("disable / enable", BENCH_OPS, *upticks - start);
+    start = *upticks;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        mutex_lock(&mutex);
+        counter++;
+        mutex_unlock(&mutex);
+    }
+
+    report("mutex lock / unlock", BENCH_OPS, *upticks - start);
+    start = *upticks;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        semaphore_wait(&sem);
+        counter++;
+        semaphore_signal(&sem);
+    }
+
+    report("semaphore wait / signal", BENCH_OPS, *upticks - start);
+
+    assert_that(counter == BENCH_OPS * 3);
+    assert_that(mutex.sem.count == 1);
+    assert_that(sem.count == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_bench_messages() {
+    Port port;
+    void *slots[BENCH_SLOTS];
+    void *msg = &message;
+
+    port_init(&port, slots, BENCH_SLOTS);
+
+    uint32_t start = *upticks;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        disable_interrupts();
+        ring[ring_tail++ & (BENCH_SLOTS - 1)] = msg;
+        enable_interrupts();
+
+        disable_interrupts();
+        msg = ring[ring_head++ & (BENCH_SLOTS - 1)];
+        enable_interrupts();
+    }
+
+    report("masked ring put / get", BENCH_OPS, *upticks - start);
+    start = *upticks;
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        port_put(&port, msg);
+        msg = port_get(&port);
+    }
+
+    report("port put / get", BENCH_OPS, *upticks - start);
+
+    assert_that(msg == &message);
+    assert_that(port.items.count == 0);
+    assert_that(port.spaces.count == BENCH_SLOTS);
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    task_init();
+    bench_main.priority = 1;
+    bench_main.state = TASK_STATE_RUNNING;
+    current_task_var = &bench_main;
+    counter = 0;
+}
+
+static void teardown() {
+    current_task_var = NULL;
+}
+
+static RTest tests[] = {
+    { "/sync/bench/critical_section",       test_bench_critical_section,        setup,       teardown },
+    { "/sync/bench/messages",               test_bench_messages,                setup,       teardown },
+    { NULL, NULL, NULL, NULL },
+};
+
+void sync_bench_suite(void) {
+    rtest_main(tests);
+}
@@ -0,0 +1,317 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Unit tests: task timeouts, pending signals and statistics
+ *
+ * The test runs as a task, without the tick handler installed,
+ * and calls timer_tick itself to move time on.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "kmachine.h"
+#include "task.h"
+#include "timer.h"
+
+#define TEST_STACK_SIZE     1024
+
+void task_tee(
+    Task *task,
+    uintptr_t stack_addr,
+    task_handler_f entryhandler,
+    task_handler_f entrypoint,
+    task_handler_f exithandler
+);
+void task_ready(Task *task);
+void task_trampoline(void);
+
+extern Task *current_task_var;
+
+// task.asm switches to this when nothing's runnable (normally in sched.c)
+Task tidle;
+
+static Task test_main;
+static Task test_task;
+static uint32_t test_stack[TEST_STACK_SIZE / 4];
+static volatile uint32_t done;
+static volatile uint32_t result;
+
+static void yield_now() {
+    disable_interrupts();
+    task_yield();
+    enable_interrupts();
+}
+
+static void ticks(uint32_t count) {
+    while (count--) {
+        disable_interrupts();
+        timer_tick();
+        enable_interrupts();
+    }
+}
+
+static noreturn void wait_forever() {
+    for (;;) {
+        task_wait(0);
+    }
+}
+
+static void timeout_task(void) {
+    result = task_wait_timeout(1, 3);
+    done++;
+    wait_forever();
+}
+
+static void no_timeout_task(void) {
+    result = task_wait_timeout(1, 0);
+    done++;
+    wait_forever();
+}
+
+static void sleep_task(void) {
+    task_sleep(2);
+    done++;
+    wait_forever();
+}
+
+static void init_task(Task *task, tid_t tid) {
+    task->node.next = NULL;
+    task->node.prev = NULL;
+    task->node.type = NODE_TYPE_TASK;
+    task->node.size = sizeof(Task);
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
+    task->priority = 1;
+    task->state = TASK_STATE_RUNNING;
+    task->tid = tid;
+}
+
+static void start_task(task_handler_f entrypoint) {
+    init_task(&test_task, 1);
+    task_tee(&test_task, (uintptr_t)&test_stack[TEST_STACK_SIZE / 4], task_trampoline, entrypoint, halt_and_catch_fire);
+
+    disable_interrupts();
+    task_ready(&test_task);
+    enable_interrupts();
+
+    // Let it get to its wait
+    yield_now();
+}
+
+static int test_wait_times_out() {
+    start_task(timeout_task);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+    assert_that(test_task.timer.node.next != NULL);
+
+    ticks(2);
+    yield_now();
+    assert_that(done == 0);
+
+    ticks(1);
+    assert_that(test_task.state == TASK_STATE_RUNNABLE);
+
+    yield_now();
+    assert_that(done == 1);
+    assert_that(result == 0);
+
+    return RTEST_PASS;
+}
+
+static int test_signal_cancels_timeout() {
+    start_task(timeout_task);
+
+    task_signal(&test_task, 1);
+    assert_that(test_task.timer.node.next == NULL);
+
+    // It's off the wheel too, so its expiry isn't a tick that matters
+    assert_that(timer_next(4) == 4);
+
+    yield_now();
+    assert_that(done == 1);
+    assert_that(result == 1);
+
+    // Now waiting forever - the timeout mustn't wake it
+    ticks(10);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+
+    return RTEST_PASS;
+}
+
+static int test_zero_waits_forever() {
+    start_task(no_timeout_task);
+    assert_that(test_task.timer.node.next == NULL);
+
+    ticks(100);
+    yield_now();
+    assert_that(done == 0);
+
+    task_signal(&test_task, 1);
+    yield_now();
+    assert_that(done == 1);
+    assert_that(result == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_sleep() {
+    start_task(sleep_task);
+
+    // Signals don't wake a sleeping task
+    task_signal(&test_task, 0xffffffff);
+    assert_that(test_task.state == TASK_STATE_WAITING);
+
+    ticks(1);
+    yield_now();
+    assert_that(done == 0);
+
+    ticks(1);
+    yield_now();
+    assert_that(done == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_signal_before_wait_is_kept() {
+    // Signal ourselves - we're not waiting, so it's latched...
+    task_signal(&test_main, 0x06);
+    assert_that(test_main.sig_pending == 0x06);
+
+    // ... and a wait for it returns straight away, taking only what it asked for
+    assert_that(task_wait(0x02) == 0x02);
+    assert_that(test_main.sig_pending == 0x04);
+
+    assert_that(task_wait(0x0c) == 0x04);
+    assert_that(test_main.sig_pending == 0);
+
+    return RTEST_PASS;
+}
+
+static int test_pending_wait_timeout() {
+    task_signal(&test_main, 0x01);
+
+    assert_that(task_wait_timeout(0x01, 10) == 0x01);
+    assert_that(test_main.timer.node.next == NULL);
+
+    return RTEST_PASS;
+}
+
+static int test_wake_leaves_others_pending() {
+    start_task(timeout_task);
+
+    task_signal(&test_task, 0x03);
+    assert_that(test_task.state == TASK_STATE_RUNNABLE);
+    assert_that(test_task.sig_pending == 0x02);
+
+    yield_now();
+    assert_that(done == 1);
+    assert_that(result == 0x01);
+
+    return RTEST_PASS;
+}
+
+static int test_switch_stats() {
+    SchedTraceEvent events[2];
+
+    start_task(no_timeout_task);
+
+    // Switched to it, then back when it waited...
+    assert_that(test_task.stats.switches == 1);
+    assert_that(test_main.stats.switches == 1);
+
+    // ... and both switches were traced
+    assert_that(sched_trace_read(events, 2) == 2);
+    assert_that(events[0].from == 0);
+    assert_that(events[0].to == 1);
+    assert_that(events[0].from_state == TASK_STATE_RUNNABLE);
+    assert_that(events[0].to_priority == 1);
+    assert_that(events[1].from == 1);
+    assert_that(events[1].to == 0);
+    assert_that(events[1].from_state == TASK_STATE_WAITING);
+
+    return RTEST_PASS;
+}
+
+static int test_wakeup_latency() {
+    TaskStats stats;
+
+    start_task(no_timeout_task);
+
+    task_get_stats(&test_task, &stats);
+    assert_that(stats.woken == 0);
+
+    task_signal(&test_task, 0x01);
+    task_get_stats(&test_task, &stats);
+    assert_that(stats.woken != 0);
+
+    yield_now();
+    assert_that(done == 1);
+
+    // Latency is only measured in ticks, so should be none (or one)
+    task_get_stats(&test_task, &stats);
+    assert_that(stats.woken == 0);
+    assert_that(stats.max_latency <= 1);
+    assert_that(stats.switches == 2);
+
+    return RTEST_PASS;
+}
+
+static int test_trace_read_limits() {
+    SchedTraceEvent events[SCHED_TRACE_EVENTS];
+
+    // Only ever the ones asked for...
+    assert_that(sched_trace_read(events, 0) == 0);
+
+    // ... and never more than the ring holds
+    for (int i = 0; i < SCHED_TRACE_EVENTS; i++) {
+        yield_now();
+    }
+
+    assert_that(sched_trace_read(events, SCHED_TRACE_EVENTS) == SCHED_TRACE_EVENTS);
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    task_init();
+    init_task(&test_main, 0);
+    current_task_var = &test_main;
+    done = 0;
+    result = 0xffffffff;
+}
+
+static void teardown() {
+    // Abandon the task where it is - it'll never run again
+    current_task_var = NULL;
+}
+
+static RTest tests[] = {
+    { "/task/wait_times_out",               test_wait_times_out,                setup,       teardown },
+    { "/task/signal_cancels_timeout",       test_signal_cancels_timeout,        setup,       teardown },
+    { "/task/zero_waits_forever",           test_zero_waits_forever,            setup,       teardown },
+    { "/task/sleep",                        test_sleep,                         setup,       teardown },
+    { "/task/signal_before_wait_is_kept",   test_signal_before_wait_is_kept,    setup,       teardown },
+    { "/task/pending_wait_timeout",         test_pending_wait_timeout,          setup,       teardown },
+    { "/task/wake_leaves_others_pending",   test_wake_leaves_others_pending,    setup,       teardown },
+    { "/task/switch_stats",                 test_switch_stats,                  setup,       teardown },
+    { "/task/wakeup_latency",               test_wakeup_latency,                setup,       teardown },
+    { "/task/trace_read_limits",            test_trace_read_limits,             setup,       teardown },
+    { NULL, NULL, NULL, NULL },
+};
+
+void task_suite(void) {
+    rtest_main(tests);
+}
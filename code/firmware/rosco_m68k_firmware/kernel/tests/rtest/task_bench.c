@@ -0,0 +1,183 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Benchmark: task switch and signal latency
+ *
+ * The test itself runs as a task (without the tick handler
+ * installed, so nothing is preempted) alongside 64 others
+ * at the same priority, and yields to let them run.
+ *
+ * Timing is from the 100Hz tick, scaled by the CPU speed the
+ * firmware measured at boot, so cycle counts are approximate.
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "kmachine.h"
+#include "task.h"
+
+#define BENCH_TASKS         64
+#define BENCH_ROUNDS        100
+#define BENCH_STACK_SIZE    512
+
+void task_tee(
+    Task *task,
+    uintptr_t stack_addr,
+    task_handler_f entryhandler,
+    task_handler_f entrypoint,
+    task_handler_f exithandler
+);
+void task_ready(Task *task);
+void task_trampoline(void);
+
+extern Task *current_task_var;
+
+static volatile uint32_t * const upticks = (uint32_t*)0x40c;
+static volatile uint32_t * const cpuinfo = (uint32_t*)0x41c;
+
+static Task bench_main;
+static Task bench_tasks[BENCH_TASKS];
+static uint32_t bench_stacks[BENCH_TASKS][BENCH_STACK_SIZE / 4];
+static volatile uint32_t runs;
+
+static void yield_now() {
+    disable_interrupts();
+    task_yield();
+    enable_interrupts();
+}
+
+static void yield_task(void) {
+    for (;;) {
+        runs++;
+        yield_now();
+    }
+}
+
+static void wait_task(void) {
+    for (;;) {
+        task_wait(1);
+        runs++;
+    }
+}
+
+// Same as task_new (which is in sched.c, along with a lot else)
+static void init_task(Task *task, tid_t tid) {
+    task->node.next = NULL;
+    task->node.prev = NULL;
+    task->node.type = NODE_TYPE_TASK;
+    task->node.size = sizeof(Task);
+    task->timer.node.next = NULL;
+    task->timer.node.prev = NULL;
+    task->sig_pending = 0;
+    task->stats = (TaskStats){ 0 };
+    task->user_data = NULL;
+    task->priority = 1;
+    task->state = TASK_STATE_RUNNING;
+    task->tid = tid;
+}
+
+static void start_tasks(task_handler_f entrypoint) {
+    for (int i = 0; i < BENCH_TASKS; i++) {
+        init_task(&bench_tasks[i], i + 1);
+        task_tee(&bench_tasks[i], (uintptr_t)&bench_stacks[i + 1], task_trampoline, entrypoint, halt_and_catch_fire);
+
+        disable_interrupts();
+        task_ready(&bench_tasks[i]);
+        enable_interrupts();
+    }
+}
+
+static void report(char *what, uint32_t ops, uint32_t ticks) {
+    uint32_t hz = *cpuinfo & 0x1FFFFFFF;
+
+    rt_printf("\n    %s: %d in %d ticks", what, ops, ticks);
+
+    if (hz != 0 && ops != 0) {
+        rt_printf(" (~%d cycles each)", ticks * (hz / 100) / ops);
+    }
+
+    rt_printf("\n%-40s", "");
+}
+
+static int test_bench_switch() {
+    start_tasks(yield_task);
+
+    uint32_t start = *upticks;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        yield_now();
+    }
+
+    uint32_t ticks = *upticks - start;
+
+    // Round-robin, so every task ran once per round
+    assert_that(runs == BENCH_TASKS * BENCH_ROUNDS);
+
+    report("switches", (BENCH_TASKS + 1) * BENCH_ROUNDS, ticks);
+
+    return RTEST_PASS;
+}
+
+static int test_bench_signal() {
+    start_tasks(wait_task);
+
+    // Let them all get to their first wait
+    yield_now();
+    assert_that(runs == 0);
+
+    uint32_t start = *upticks;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        // Signal all the tasks, in the opposite order to last time -
+        // they wait in the order they were signalled, so this starts
+        // at the far end of the sleeping list...
+        for (int i = 0; i < BENCH_TASKS; i++) {
+            int n = (round & 1) ? BENCH_TASKS - 1 - i : i;
+            task_signal(&bench_tasks[n], 1);
+        }
+
+        // ... then let them run back to their waits
+        yield_now();
+    }
+
+    uint32_t ticks = *upticks - start;
+
+    assert_that(runs == BENCH_TASKS * BENCH_ROUNDS);
+
+    report("signal / wake / wait", BENCH_TASKS * BENCH_ROUNDS, ticks);
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    task_init();
+    init_task(&bench_main, 0);
+    current_task_var = &bench_main;
+    runs = 0;
+}
+
+static void teardown() {
+    // Abandon the tasks where they are - they'll never run again
+    current_task_var = NULL;
+}
+
+static RTest tests[] = {
+    { "/task/bench/switch",                 test_bench_switch,                  setup,       teardown },
+    { "/task/bench/signal",                 test_bench_signal,                  setup,       teardown },
+    { NULL, NULL, NULL, NULL },
+};
+
+void task_bench_suite(void) {
+    rtest_main(tests);
+}
@@ -0,0 +1,219 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Unit tests: timer wheel
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "roscotest.h"
+#include "list.h"
+#include "timer.h"
+
+extern uint32_t timer_wheel_time;
+
+static Timer timers[3];
+static int fired[3];
+static uint32_t fired_at[3];
+static uint32_t period;
+
+static void count_handler(Timer *timer) {
+    int n = timer - timers;
+
+    fired[n]++;
+    fired_at[n] = timer_wheel_time;
+}
+
+static void periodic_handler(Timer *timer) {
+    count_handler(timer);
+    timer_add(timer, period);
+}
+
+static void ticks(uint32_t count) {
+    while (count--) {
+        timer_tick();
+    }
+}
+
+static int test_fires_after_ticks() {
+    timer_add(&timers[0], 5);
+    assert_that(timers[0].node.next != NULL);
+
+    ticks(4);
+    assert_that(fired[0] == 0);
+
+    ticks(1);
+    assert_that(fired[0] == 1);
+    assert_that(timers[0].node.next == NULL);
+
+    ticks(100);
+    assert_that(fired[0] == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_zero_is_one_tick() {
+    timer_add(&timers[0], 0);
+
+    ticks(1);
+    assert_that(fired[0] == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_cancel() {
+    timer_add(&timers[0], 10);
+    timer_add(&timers[1], 10);
+
+    ticks(5);
+    timer_cancel(&timers[0]);
+    assert_that(timers[0].node.next == NULL);
+
+    // Cancelling when not armed is fine too
+    timer_cancel(&timers[0]);
+
+    ticks(5);
+    assert_that(fired[0] == 0);
+    assert_that(fired[1] == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_rearm() {
+    timer_add(&timers[0], 100);
+    timer_add(&timers[0], 3);
+
+    ticks(3);
+    assert_that(fired[0] == 1);
+
+    ticks(100);
+    assert_that(fired[0] == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_same_tick_fires_all() {
+    timer_add(&timers[0], 7);
+    timer_add(&timers[1], 7);
+    timer_add(&timers[2], 8);
+
+    ticks(7);
+    assert_that(fired[0] == 1);
+    assert_that(fired[1] == 1);
+    assert_that(fired[2] == 0);
+
+    ticks(1);
+    assert_that(fired[2] == 1);
+
+    return RTEST_PASS;
+}
+
+static int test_cascades_from_higher_levels() {
+    // Start just short of a level 2 boundary, so these cascade
+    // through two levels and one.
+    timer_wheel_time = 3 * 4096 - 10;
+    uint32_t start = timer_wheel_time;
+
+    timer_add(&timers[0], 5000);
+    timer_add(&timers[1], 200);
+    timer_add(&timers[2], 64);
+
+    ticks(5000);
+
+    assert_that(fired[0] == 1 && fired_at[0] == start + 5000);
+    assert_that(fired[1] == 1 && fired_at[1] == start + 200);
+    assert_that(fired[2] == 1 && fired_at[2] == start + 64);
+
+    return RTEST_PASS;
+}
+
+static int test_tick_count_wraps() {
+    timer_wheel_time = 0xfffffff0;
+
+    timer_add(&timers[0], 40);
+
+    ticks(39);
+    assert_that(fired[0] == 0);
+
+    ticks(1);
+    assert_that(fired[0] == 1);
+    assert_that(fired_at[0] == 0x18);
+
+    return RTEST_PASS;
+}
+
+static int test_handler_can_rearm() {
+    period = 10;
+    timers[0].handler = periodic_handler;
+    timer_add(&timers[0], period);
+
+    ticks(100);
+    assert_that(fired[0] == 10);
+
+    timer_cancel(&timers[0]);
+
+    ticks(100);
+    assert_that(fired[0] == 10);
+
+    return RTEST_PASS;
+}
+
+static int test_next() {
+    // Nothing armed - only the next cascade, or the limit
+    assert_that(timer_next(10) == 10);
+    assert_that(timer_next(100) == 64);
+
+    timer_add(&timers[0], 20);
+    timer_add(&timers[1], 7);
+    assert_that(timer_next(56) == 7);
+    assert_that(timer_next(5) == 5);
+
+    ticks(7);
+    assert_that(timer_next(56) == 13);
+
+    // Beyond the next cascade isn't looked at
+    timer_add(&timers[1], 500);
+    ticks(13);
+    assert_that(timer_next(56) == 44);
+
+    return RTEST_PASS;
+}
+
+static void setup() {
+    timer_init();
+
+    for (int i = 0; i < 3; i++) {
+        timers[i].node.next = NULL;
+        timers[i].node.prev = NULL;
+        timers[i].handler = count_handler;
+        fired[i] = 0;
+        fired_at[i] = 0;
+    }
+}
+
+static RTest tests[] = {
+    { "/timer/fires_after_ticks",           test_fires_after_ticks,             setup,       NULL },
+    { "/timer/zero_is_one_tick",            test_zero_is_one_tick,              setup,       NULL },
+    { "/timer/cancel",                      test_cancel,                        setup,       NULL },
+    { "/timer/rearm",                       test_rearm,                         setup,       NULL },
+    { "/timer/same_tick_fires_all",         test_same_tick_fires_all,           setup,       NULL },
+    { "/timer/cascades_from_higher_levels", test_cascades_from_higher_levels,   setup,       NULL },
+    { "/timer/tick_count_wraps",            test_tick_count_wraps,              setup,       NULL },
+    { "/timer/handler_can_rearm",           test_handler_can_rearm,             setup,       NULL },
+    { "/timer/next",                        test_next,                          setup,       NULL },
+    { NULL, NULL, NULL, NULL },
+};
+
+void timer_suite(void) {
+    rtest_main(tests);
+}
@@ -0,0 +1,163 @@
+/*
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|            kernel
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Hierarchical timer wheel.
+ * 
+ * Armed timers live in one of four levels of 64 slots (lists).
+ * A slot in level 0 holds the timers for a single tick, a slot
+ * in level 1 the timers for 64 ticks, level 2 for 4096 and so on, 
+ * and a timer goes in the lowest level that reaches its expiry.
+ * 
+ * Each tick, every timer in the current level 0 slot has expired.
+ * Every 64 ticks, the next level 1 slot is emptied and its timers
+ * re-inserted, which puts them in level 0 (and likewise for level
+ * 2 every 4096 ticks, etc).
+ * 
+ * So arming and cancelling are O(1), and so is each tick - the
+ * only work is on timers that are actually expiring, plus moving
+ * each timer down a level at most three times in its life. 
+ * Nothing ever scans the armed timers.
+ * 
+ * The space overhead is 256 list headers (3KiB).
+ * ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "kmachine.h"
+#include "list.h"
+#include "timer.h"
+
+#define WHEEL_BITS      6
+#define WHEEL_SLOTS     (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS    4
+
+#define level_shift(level)  ((level) * WHEEL_BITS)
+
+#ifdef UNIT_TESTS
+#   define NODEBUG_STATIC
+#else
+#   define NODEBUG_STATIC   static
+#endif
+
+NODEBUG_STATIC List     timer_wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+NODEBUG_STATIC uint32_t timer_wheel_time;
+
+static void wheel_insert(Timer *timer) {
+    uint32_t delta = timer->expires - timer_wheel_time;
+    int level = 0;
+
+    while (level < WHEEL_LEVELS - 1 && delta >= (1UL << level_shift(level + 1))) {
+        level++;
+    }
+
+    uint32_t slot = (timer->expires >> level_shift(level)) & WHEEL_MASK;
+    list_add_tail_c(&timer_wheel[level][slot], (ListNode*)timer);
+}
+
+static void wheel_cascade(int level) {
+    List *slot = &timer_wheel[level][(timer_wheel_time >> level_shift(level)) & WHEEL_MASK];
+    ListNode *node;
+
+    while ((node = list_delete_head_c(slot)) != NULL) {
+        wheel_insert((Timer*)node);
+    }
+}
+
+void timer_init(void) {
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++) {
+            list_init_c(&timer_wheel[level][slot]);
+        }
+    }
+
+    timer_wheel_time = 0;
+}
+
+void timer_add(Timer *timer, uint32_t ticks) {
+    if (ticks == 0) {
+        ticks = 1;
+    } else if (ticks > TIMER_MAX_TICKS) {
+        ticks = TIMER_MAX_TICKS;
+    }
+
+    disable_interrupts();
+
+    if (timer->node.next != NULL) {
+        list_node_delete_c((ListNode*)timer);
+    }
+
+    timer->node.type = NODE_TYPE_TIMER;
+    timer->node.size = sizeof(Timer);
+    timer->expires = timer_wheel_time + ticks;
+    wheel_insert(timer);
+
+    enable_interrupts();
+}
+
+void timer_cancel(Timer *timer) {
+    disable_interrupts();
+
+    if (timer->node.next != NULL) {
+        list_node_delete_c((ListNode*)timer);
+        timer->node.next = NULL;
+        timer->node.prev = NULL;
+    }
+
+    enable_interrupts();
+}
+
+uint32_t timer_next(uint32_t limit) {
+    for (uint32_t ticks = 1; ticks < limit; ticks++) {
+        uint32_t time = timer_wheel_time + ticks;
+
+        // A cascade might bring down timers due any time after it, 
+        // so this is as far as we can look without walking them
+        if ((time & WHEEL_MASK) == 0) {
+            return ticks;
+        }
+
+        List *slot = &timer_wheel[0][time & WHEEL_MASK];
+
+        if (slot->head->next != NULL) {
+            return ticks;
+        }
+    }
+
+    return limit;
+}
+
+void timer_tick(void) {
+    timer_wheel_time++;
+
+    // Bring down the next slot from each level whose period just ended
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if ((timer_wheel_time & ((1UL << level_shift(level)) - 1)) != 0) {
+            break;
+        }
+
+        wheel_cascade(level);
+    }
+
+    // Everything in the current level 0 slot expires now
+    List *slot = &timer_wheel[0][timer_wheel_time & WHEEL_MASK];
+    ListNode *node;
+
+    while ((node = list_delete_head_c(slot)) != NULL) {
+        Timer *timer = (Timer*)node;
+
+        timer->node.next = NULL;
+        timer->node.prev = NULL;
+        timer->handler(timer);
+    }
+}
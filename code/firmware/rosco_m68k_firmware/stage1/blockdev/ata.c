@@ -26,6 +26,10 @@
 extern void print_unsigned(uint32_t, uint8_t);
 #endif
 
+void ata_read_data(volatile uint16_t *data, uint8_t *buf, uint32_t sectors);
+void ata_write_data(volatile uint16_t *data, uint8_t *buf, uint32_t sectors);
+void TRY_DISABLE_ATA_INTERRUPT(volatile uint16_t *idereg);
+
 static volatile uint16_t *idereg = (volatile uint16_t *)IDE_BASE;
 
 static uint8_t ata_m = 0;
@@ -33,6 +37,8 @@ static uint8_t ata_m_modelnum[41];
 static uint8_t ata_s = 0;
 static uint8_t ata_s_modelnum[41];
 
+static uint8_t ata_multiple[2];         /* sectors per DRQ block, 0 if not using multiple */
+
 static uint8_t ata_buf[512];
 static uint8_t selected_drive = 0xFF;  /* no drive by default */
 
@@ -180,10 +186,39 @@ static uint8_t ata_poll() {
     return 1;
 }
 
-static uint8_t ata_read_one(uint8_t *buf, uint32_t lba, uint8_t drive) {
+static bool ata_start(uint32_t lba, uint32_t count, uint8_t command, uint8_t drive) {
+    uint8_t cmd = (drive == ATA_MASTER ? 0xE0 : 0xF0);
 
+    if (!ata_await_ready()) {
 #ifdef ATA_DEBUG
-    FW_PRINT_C("  S1: ata_read_one @");
+        FW_PRINT_C("ERROR: ata_await_ready timeout\r\n");
+#endif
+        return false;
+    }
+
+    idereg[ATA_REG_WR_DEVSEL] = (cmd | (uint8_t) ((lba >> 24 & 0x0F)));
+    idereg[ATA_REG_WR_SECTOR_COUNT] = (uint8_t) count;     // 0 means 256
+    idereg[ATA_REG_WR_LBA_7_0] = (uint8_t) (lba);
+    idereg[ATA_REG_WR_LBA_15_8] = (uint8_t) ((lba) >> 8);
+    idereg[ATA_REG_WR_LBA_23_16] = (uint8_t) ((lba) >> 16);
+    idereg[ATA_REG_WR_COMMAND] = command;
+
+    return true;
+}
+
+/*
+ * Each command covers up to 256 sectors. The drive asks for (or
+ * offers) the data a DRQ block at a time - one sector for READ /
+ * WRITE SECTORS, or up to the SET MULTIPLE MODE count for READ /
+ * WRITE MULTIPLE - so there's just one poll per block.
+ */
+static uint32_t ata_read(uint8_t *buf, uint32_t lba, uint32_t num, uint8_t drive) {
+    uint32_t done = 0;
+
+#ifdef ATA_DEBUG
+    FW_PRINT_C("  S1: ata_read ");
+    print_unsigned(num, 10);
+    FW_PRINT_C(" @");
     print_unsigned(lba, 10);
     FW_PRINT_C(" into buffer at 0x");
     print_unsigned((uint32_t)buf, 16);
@@ -199,96 +234,131 @@ static uint8_t ata_read_one(uint8_t *buf, uint32_t lba, uint8_t drive) {
         return 0;
     }
 
-    uint8_t cmd = (drive == ATA_MASTER ? 0xE0 : 0xF0);
+    uint8_t multiple = ata_multiple[drive];
+    uint8_t command = multiple ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ_PIO;
+    uint32_t per_block = multiple ? multiple : 1;
 
-    if (!ata_await_ready()) {
-#ifdef ATA_DEBUG
-        FW_PRINT_C("ERROR: ata_await_ready timeout\r\n");
-#endif
-        return 0;
-    }
+    ata_select_drive(drive);
 
-    idereg[ATA_REG_WR_DEVSEL] = (cmd | (uint8_t) ((lba >> 24 & 0x0F)));
-    idereg[ATA_REG_WR_SECTOR_COUNT] = 1;
-    idereg[ATA_REG_WR_LBA_7_0] = (uint8_t) (lba);
-    idereg[ATA_REG_WR_LBA_15_8] = (uint8_t) ((lba) >> 8);
-    idereg[ATA_REG_WR_LBA_23_16] = (uint8_t) ((lba) >> 16);
-    idereg[ATA_REG_WR_COMMAND] =  ATA_CMD_READ_PIO;
+    while (done < num) {
+        uint32_t count = num - done;
+        if (count > ATA_MAX_SECTORS) {
+            count = ATA_MAX_SECTORS;
+        }
+
+        if (!ata_start(lba + done, count, command, drive)) {
+            return done;
+        }
 
-    if (!ata_poll()) {
+        while (count > 0) {
+            uint32_t block = count < per_block ? count : per_block;
+
+            if (!ata_poll()) {
 #ifdef ATA_DEBUG
-        FW_PRINT_C("ERROR: ata_poll timeout\r\n");
+                FW_PRINT_C("ERROR: ata_poll timeout\r\n");
 #endif
-        return 0;
-    }
+                return done;
+            }
 
-    for (int i = 0; i < 256; i++) {
-        *(uint16_t*) (buf + i * 2) = __builtin_bswap16(idereg[ATA_REG_RD_DATA]);
-    }
+            ata_read_data(idereg, buf, block);
 
-    ata_delay_for_a_bit();
+            buf += block * 512;
+            done += block;
+            count -= block;
+        }
+    }
 
 #ifdef ATA_DEBUG
     FW_PRINT_C("OK\r\n");
 #endif
 
-    return 1;
+    return done;
 }
 
-static uint32_t ata_read(uint8_t *buf, uint32_t lba, uint32_t num, uint8_t drive) {
+static uint32_t ata_write(uint8_t *buf, uint32_t lba, uint32_t num, uint8_t drive) {
+    uint32_t done = 0;
+
+    if (drive != ATA_MASTER && drive != ATA_SLAVE) {
+        return 0;
+    }
+
+    uint8_t multiple = ata_multiple[drive];
+    uint8_t command = multiple ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE_PIO;
+    uint32_t per_block = multiple ? multiple : 1;
+
     ata_select_drive(drive);
 
-    for (uint32_t i = 0; i < num; i++) {
-        if (!ata_read_one(buf, lba + i, drive)) {
-            return i;
+    while (done < num) {
+        uint32_t count = num - done;
+        if (count > ATA_MAX_SECTORS) {
+            count = ATA_MAX_SECTORS;
+        }
+
+        if (!ata_start(lba + done, count, command, drive)) {
+            return done;
+        }
+
+        uint32_t start = done;
+
+        while (count > 0) {
+            uint32_t block = count < per_block ? count : per_block;
+
+            if (!ata_poll()) {
+                return start;
+            }
+
+            ata_write_data(idereg, buf, block);
+
+            buf += block * 512;
+            done += block;
+            count -= block;
+        }
+
+        // The last block isn't written until BSY clears
+        ata_delay_for_a_bit();
+
+        if (!ata_await_not_busy() || (idereg[ATA_REG_RD_STATUS] & (ATA_SR_ERR | ATA_SR_DF))) {
+            return start;
         }
-        buf += 512;
     }
-    return num;
-}
 
-static uint8_t ata_write_one(uint8_t *buf, uint32_t lba, uint8_t drive) {
-    uint16_t *wbuf = (uint16_t*)buf;
+    return done;
+}
 
-    if (drive != ATA_MASTER && drive != ATA_SLAVE) {
-        return 0;
+/*
+ * Turn on READ / WRITE MULTIPLE with the largest block the drive
+ * supports, returning it (or zero if the drive doesn't do it).
+ */
+static uint8_t ata_set_multiple(uint8_t *ident, uint8_t drive) {
+    // Word 47 (low byte) is the maximum. The identify data isn't
+    // byte-swapped, so this can't go through the struct.
+    uint8_t max = ((uint16_t*)ident)[47] & 0xFF;
+
+    // Older drives only take powers of two
+    while (max & (max - 1)) {
+        max &= max - 1;
     }
 
-    if (!ata_await_ready()) {
+    if (max < 2) {
         return 0;
     }
 
-    uint8_t cmd = (drive == ATA_MASTER ? 0xE0 : 0xF0);
-
-    idereg[ATA_REG_WR_DEVSEL] = (cmd | (uint8_t) ((lba >> 24 & 0x0F)));
-    idereg[ATA_REG_WR_SECTOR_COUNT] = 1;
-    idereg[ATA_REG_WR_LBA_7_0] = (uint8_t) (lba);
-    idereg[ATA_REG_WR_LBA_15_8] = (uint8_t) ((lba) >> 8);
-    idereg[ATA_REG_WR_LBA_23_16] = (uint8_t) ((lba) >> 16);
-    idereg[ATA_REG_WR_COMMAND] = ATA_CMD_WRITE_PIO;
+    ata_select_drive(drive);
 
-    if (!ata_poll()) {
+    if (!ata_await_ready()) {
         return 0;
     }
 
-    for (int i = 0; i < 256; i++) {
-        idereg[ATA_REG_WR_DATA] = __builtin_bswap16(wbuf[i]);
-    }
+    idereg[ATA_REG_WR_SECTOR_COUNT] = max;
+    idereg[ATA_REG_WR_COMMAND] = ATA_CMD_SET_MULTIPLE;
 
     ata_delay_for_a_bit();
-    return 1;
-}
 
-static uint32_t ata_write(uint8_t *buf, uint32_t lba, uint32_t num, uint8_t drive) {
-    ata_select_drive(drive);
-
-    for (uint32_t i = 0; i < num; i++) {
-        if (!ata_write_one(buf, lba + i, drive)) {
-            return i;
-        }
-        buf += 512;
+    if (!ata_await_not_busy() || (idereg[ATA_REG_RD_STATUS] & ATA_SR_ERR)) {
+        return 0;
     }
-    return num;
+
+    return max;
 }
 
 static inline void copy_ident(uint8_t *dest, uint8_t *src) {
@@ -303,11 +373,13 @@ static void ata_probe() {
     if (ata_identify(ata_buf, ATA_MASTER)) {
         ata_m = 1;
         copy_ident(ata_m_modelnum, ident->ModelNumber);
+        ata_multiple[ATA_MASTER] = ata_set_multiple(ata_buf, ATA_MASTER);
     }
 
     if (ata_identify(ata_buf, ATA_SLAVE)) {
         ata_s = 1;
         copy_ident(ata_s_modelnum, ident->ModelNumber);
+        ata_multiple[ATA_SLAVE] = ata_set_multiple(ata_buf, ATA_SLAVE);
     }
 }
 
@@ -317,7 +389,6 @@ static void ata_probe() {
 
 static uint8_t *berr_flag = (uint8_t*)BERR_FLAG;
 
-void TRY_DISABLE_ATA_INTERRUPT(volatile uint16_t *idereg);
 
 void ata_init() {
     TRY_DISABLE_ATA_INTERRUPT(idereg);
@@ -0,0 +1,101 @@
+;
+;------------------------------------------------------------
+;                                  ___ ___ _
+;  ___ ___ ___ ___ ___       _____|  _| . | |_
+; |  _| . |_ -|  _| . |     |     | . | . | '_|
+; |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+;                     |_____|
+; ------------------------------------------------------------
+; Copyright (c) 2024 Ross Bamford & Contributors
+; MIT License
+;
+; ATA PIO data port transfers
+; ------------------------------------------------------------
+;
+; The data port is a single address, so it can't be the source
+; or destination of a movem - instead, each loop gathers eight
+; (byte-swapped) words into four longs and moves them to or from
+; the buffer in one movem. The buffer must be word aligned.
+;
+
+                section .text
+
+; read sectors from the ATA data port into a buffer
+; void ata_read_data(volatile uint16_t *data, uint8_t *buf, uint32_t sectors) - C callable
+ata_read_data::
+                movem.l d2-d4,-(a7)             ;12+24  save regs
+                move.l  16(a7),a0               ;   16  a0 = data port
+                move.l  20(a7),a1               ;   16  a1 = buffer
+                move.l  24(a7),d0               ;   16  d0 = sector count
+                beq.s   .done                   ; 8/10  done if zero
+                lsl.l   #5,d0                   ;   18  32 loops per sector...
+                subq.l  #1,d0                   ;    8  ...less one for dbra
+
+.loop:          move.w  (a0),d1                 ;    8  read word
+                rol.w   #8,d1                   ;   22  swap bytes
+                swap    d1                      ;    4  into high word
+                move.w  (a0),d1                 ;    8  read next word
+                rol.w   #8,d1                   ;   22  swap bytes
+                move.w  (a0),d2                 ;    8  and so on...
+                rol.w   #8,d2                   ;   22
+                swap    d2                      ;    4
+                move.w  (a0),d2                 ;    8
+                rol.w   #8,d2                   ;   22
+                move.w  (a0),d3                 ;    8
+                rol.w   #8,d3                   ;   22
+                swap    d3                      ;    4
+                move.w  (a0),d3                 ;    8
+                rol.w   #8,d3                   ;   22
+                move.w  (a0),d4                 ;    8
+                rol.w   #8,d4                   ;   22
+                swap    d4                      ;    4
+                move.w  (a0),d4                 ;    8
+                rol.w   #8,d4                   ;   22
+                movem.l d1-d4,(a1)              ; 8+32  store eight words
+                lea.l   16(a1),a1               ;    8  next eight
+                dbra    d0,.loop                ;10/14
+
+.done:          movem.l (a7)+,d2-d4             ;12+24  restore regs
+                rts
+
+; write sectors from a buffer to the ATA data port
+; void ata_write_data(volatile uint16_t *data, uint8_t *buf, uint32_t sectors) - C callable
+ata_write_data::
+                movem.l d2-d4,-(a7)             ;12+24  save regs
+                move.l  16(a7),a0               ;   16  a0 = data port
+                move.l  20(a7),a1               ;   16  a1 = buffer
+                move.l  24(a7),d0               ;   16  d0 = sector count
+                beq.s   .done                   ; 8/10  done if zero
+                lsl.l   #5,d0                   ;   18  32 loops per sector...
+                subq.l  #1,d0                   ;    8  ...less one for dbra
+
+.loop:          movem.l (a1)+,d1-d4             ;12+32  load eight words
+                swap    d1                      ;    4  first word into low word
+                rol.w   #8,d1                   ;   22  swap bytes
+                move.w  d1,(a0)                 ;    8  write word
+                swap    d1                      ;    4  second word into low word
+                rol.w   #8,d1                   ;   22  swap bytes
+                move.w  d1,(a0)                 ;    8  write word
+                swap    d2                      ;    4  and so on...
+                rol.w   #8,d2                   ;   22
+                move.w  d2,(a0)                 ;    8
+                swap    d2                      ;    4
+                rol.w   #8,d2                   ;   22
+                move.w  d2,(a0)                 ;    8
+                swap    d3                      ;    4
+                rol.w   #8,d3                   ;   22
+                move.w  d3,(a0)                 ;    8
+                swap    d3                      ;    4
+                rol.w   #8,d3                   ;   22
+                move.w  d3,(a0)                 ;    8
+                swap    d4                      ;    4
+                rol.w   #8,d4                   ;   22
+                move.w  d4,(a0)                 ;    8
+                swap    d4                      ;    4
+                rol.w   #8,d4                   ;   22
+                move.w  d4,(a0)                 ;    8
+                dbra    d0,.loop                ;10/14
+
+.done:          movem.l (a7)+,d2-d4             ;12+24  restore regs
+                rts
+
@@ -28,6 +28,8 @@ static BBSDCardType get_card_type();
 static bool try_acmd41(uint32_t, uint32_t);
 static uint8_t raw_sd_command(uint8_t, uint32_t);
 static uint8_t raw_sd_command_force(uint8_t, uint32_t, bool);
+static uint8_t send_command(uint8_t, uint32_t);
+static bool stop_transmission();
 static uint8_t raw_sd_acommand(uint8_t, uint32_t);
 #ifndef SD_BLOCK_READ_ONLY
 static bool sd_partial_read_p(BBSDCard*);
@@ -209,6 +211,55 @@ finally:
     return result;
 }
 
+bool BBSD_read_blocks(BBSDCard *sd, uint32_t block, uint32_t count, uint8_t *buffer) {
+    if (!sd->initialized) {
+        return false;
+    }
+
+    if (count < 2) {
+        // Nothing to gain from READ_MULTIPLE_BLOCK
+        return count == 0 || BBSD_read_block(sd, block, buffer);
+    }
+
+    bool result = false;
+
+    uint32_t addressable_block;
+
+    if (sd->type == BBSD_CARD_TYPE_SDHC) {
+        // SDHC is addressed by block number
+        addressable_block = block;
+    } else {
+        // Other cards use absolute addressing
+        addressable_block = block << 9;
+    }
+
+    if (BBSD_command(sd, 18, addressable_block)) {
+        goto finally;
+    }
+
+    // The card streams blocks one after the other, each with its own
+    // start token and checksum, until it's told to stop
+    for (uint32_t i = 0; i < count; i++) {
+        if (!wait_for_block_start()) {
+            stop_transmission();
+            goto finally;
+        }
+
+        BBSPI_recv_buffer(buffer, 512);
+        buffer += 512;
+
+        // Get checksum too (and ignore it ;) )
+        BBSPI_recv_byte();
+        BBSPI_recv_byte();
+    }
+
+    result = stop_transmission();
+
+finally:
+    BBSPI_deassert_cs0();
+    return result;
+}
+
 #ifndef SD_BLOCK_READ_ONLY
 bool BBSD_read_data(BBSDCard *sd, uint32_t block, uint16_t start_ofs, uint16_t count, uint8_t *buffer) {
     // Do args make sense?
@@ -323,6 +374,73 @@ finally:
     return result;
 }
 
+bool BBSD_write_blocks(BBSDCard *sd, uint32_t block, uint32_t count, uint8_t *buffer) {
+    if (!sd->initialized) {
+        return false;
+    }
+
+    if (count < 2) {
+        // Nothing to gain from WRITE_MULTIPLE_BLOCK
+        return count == 0 || BBSD_write_block(sd, block, buffer);
+    }
+
+    bool result = false;
+
+    uint32_t addressable_block;
+
+    if (sd->type == BBSD_CARD_TYPE_SDHC) {
+        // SDHC is addressed by block number
+        addressable_block = block;
+    } else {
+        // Other cards use absolute addressing
+        addressable_block = block << 9;
+    }
+
+    if (BBSD_command(sd, 25, addressable_block)) {
+        goto finally;
+    }
+
+    uint32_t written = 0;
+
+    while (written < count) {
+        // Send dummy byte prior to block start. Some cards require this.
+        BBSPI_send_byte(0xFF);
+
+        // Send multiple-block start token
+        BBSPI_send_byte(MULTI_BLOCK_START);
+
+        // Write data from buffer
+        BBSPI_send_buffer(buffer, 512);
+        buffer += 512;
+
+        // Send dummy checksum
+        BBSPI_send_byte(0xFF);
+        BBSPI_send_byte(0xFF);
+
+        // Card says whether it took the block, then is busy writing it
+        if ((BBSPI_recv_byte() & 0x1F) != WRITE_RESPONSE_OK
+                || !wait_for_card(BBSD_WRITE_WAIT_RETRIES)) {
+            break;
+        }
+
+        written++;
+    }
+
+    result = written == count;
+
+    // Stop token (even after an error), then wait for it to finish
+    BBSPI_send_byte(MULTI_BLOCK_STOP);
+    BBSPI_send_byte(0xFF);
+
+    if (!wait_for_card(BBSD_WRITE_WAIT_RETRIES)) {
+        result = false;
+    }
+
+finally:
+    BBSPI_deassert_cs0();
+    return result;
+}
+
 
 /* ********* PRIVATE *********** */
 static bool wait_for_card(uint32_t nops) {
@@ -408,6 +526,10 @@ static uint8_t raw_sd_command_force(uint8_t command, uint32_t arg, bool force) {
         return 0xFF;
     }
 
+    return send_command(command, arg);
+}
+
+static uint8_t send_command(uint8_t command, uint32_t arg) {
     BBSPI_send_byte(command | 0x40);
     for (int8_t s = 24; s >= 0; s -= 8)
         BBSPI_send_byte(arg >> s);
@@ -424,6 +546,26 @@ static uint8_t raw_sd_command_force(uint8_t command, uint32_t arg, bool force) {
     return result;
 }
 
+// Send STOP_TRANSMISSION to end a multiple-block read. The card is
+// still sending data, so this can't wait for it to be ready first.
+static bool stop_transmission() {
+    BBSPI_send_byte(12 | 0x40);
+    BBSPI_send_byte(0);
+    BBSPI_send_byte(0);
+    BBSPI_send_byte(0);
+    BBSPI_send_byte(0);
+    BBSPI_send_byte(0xFF);
+
+    // Skip the stuff byte that follows CMD12
+    BBSPI_recv_byte();
+
+    uint8_t result = 0xFF;
+    for (uint16_t i = 0; ((result = BBSPI_recv_byte()) & 0x80) && i < BBSD_COMMAND_RESPONSE_RETRIES; i++);
+
+    // R1b - busy until it's stopped
+    return result == R1_READY_STATE && wait_for_card(BBSD_WRITE_WAIT_RETRIES);
+}
+
 static uint8_t raw_sd_acommand(uint8_t command, uint32_t arg) {
     raw_sd_command(55, 0);
     return raw_sd_command(command, arg);
@@ -11,7 +11,7 @@ endif
 DEFINES+=-DROSCO_M68K_SDCARD -DSD_BLOCK_READ_ONLY
 
 ifeq ($(WITH_ATA),true)
-OBJECTS+=blockdev/ata_disable_interrupt.o blockdev/ata.o
+OBJECTS+=blockdev/ata_disable_interrupt.o blockdev/ata_data_asm.o blockdev/ata.o
 DEFINES+=-DROSCO_M68K_ATA
 endif
 
@@ -74,12 +74,17 @@
 #define ATA_CMD_WRITE_PIO_EXT       0x34
 #define ATA_CMD_WRITE_DMA           0xCA
 #define ATA_CMD_WRITE_DMA_EXT       0x35
+#define ATA_CMD_READ_MULTIPLE       0xC4
+#define ATA_CMD_WRITE_MULTIPLE      0xC5
+#define ATA_CMD_SET_MULTIPLE        0xC6
 #define ATA_CMD_CACHE_FLUSH         0xE7
 #define ATA_CMD_CACHE_FLUSH_EXT     0xEA
 #define ATA_CMD_PACKET              0xA0
 #define ATA_CMD_IDENTIFY_PACKET     0xA1
 #define ATA_CMD_IDENTIFY            0xEC
 
+#define ATA_MAX_SECTORS             256     // Per command (sector count 0)
+
 #define ATA_IDENT_DEVICETYPE        0
 #define ATA_IDENT_CYLINDERS         2
 #define ATA_IDENT_HEADS             6
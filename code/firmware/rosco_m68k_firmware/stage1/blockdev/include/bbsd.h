@@ -29,6 +29,8 @@
 #define R1_IDLE_STATE       0x01
 #define R1_ILLEGAL_COMMAND  0x04
 #define BLOCK_START         0xFE
+#define MULTI_BLOCK_START   0xFC
+#define MULTI_BLOCK_STOP    0xFD
 
 // Timings - these are measured in 'nops' (number of operations, basically the
 // number of times it will loop waiting for the condition. This means they'll
@@ -226,6 +228,8 @@ uint32_t BBSD_get_size(BBSDCard *sd);
 
 bool BBSD_read_block(BBSDCard *sd, uint32_t block, uint8_t *buffer);
 bool BBSD_write_block(BBSDCard *sd, uint32_t block, uint8_t *buffer);
+bool BBSD_read_blocks(BBSDCard *sd, uint32_t block, uint32_t count, uint8_t *buffer);
+bool BBSD_write_blocks(BBSDCard *sd, uint32_t block, uint32_t count, uint8_t *buffer);
 
 #ifndef SD_BLOCK_READ_ONLY
 bool BBSD_read_data(BBSDCard *sd, uint32_t block, uint16_t start_ofs, uint16_t count, uint8_t *buffer);
@@ -25,7 +25,7 @@ TRAP_13_VECTOR_ADDR equ     TRAP_13_VECTOR*4
 ;
 ; NOTE: Trashes A0, and allowed to modify arguments.
 BLOCKDEV_TRAP_13_HANDLER:
-    cmp.l   #19,D0                      ; Is function code in range?
+    cmp.l   #21,D0                      ; Is function code in range?
     bhi.s   .NOT_IMPLEMENTED            ; Nope, leave...
 
     add.l   D0,D0                       ; Multiply FC...
@@ -54,6 +54,8 @@ BLOCKDEV_TRAP_13_HANDLER:
     dc.l    ATA_READ                    ; FC == 17
     dc.l    ATA_WRITE                   ; FC == 18
     dc.l    ATA_IDENTIFY                ; FC == 19
+    dc.l    SD_READ_BLOCKS              ; FC == 20
+    dc.l    SD_WRITE_BLOCKS             ; FC == 21
 .NOT_IMPLEMENTED:
     rte
 
@@ -81,6 +83,16 @@ SD_WRITE_BLOCK:
     jsr     (A0)
     rte
 
+SD_READ_BLOCKS:
+    move.l  EFP_SD_READ_M,A0
+    jsr     (A0)
+    rte
+
+SD_WRITE_BLOCKS:
+    move.l  EFP_SD_WRITE_M,A0
+    jsr     (A0)
+    rte
+
 SD_READ_REGISTER:
     move.l  EFP_SD_REG,A0
     jsr     (A0)
@@ -188,6 +200,37 @@ FW_SD_WRITE:
     move.l  #BBSD_write_block,A0
     bra.s   SD_BLOCK_OP
 
+; Arguments
+;   A1  - Pointer to an SD struct
+;   A2  - Pointer to (512 * D2)-byte buffer
+;   D1  - First block number to read
+;   D2  - Number of blocks to read
+;
+; Returns
+;   D0  - 0 on error, else success
+FW_SD_READ_M:
+    move.l  #BBSD_read_blocks,A0
+    bra.s   SD_MULTI_BLOCK_OP
+
+; Arguments
+;   A1  - Pointer to an SD struct
+;   A2  - Pointer to (512 * D2)-byte buffer
+;   D1  - First block number to write
+;   D2  - Number of blocks to write
+;
+; Returns
+;   D0  - 0 on error, else success
+FW_SD_WRITE_M:
+    move.l  #BBSD_write_blocks,A0
+SD_MULTI_BLOCK_OP:
+    move.l  A2,-(A7)
+    move.l  D2,-(A7)
+    move.l  D1,-(A7)
+    move.l  A1,-(A7)
+    jsr     (A0)
+    add.l   #16,A7
+    rts
+
 ; Arguments
 ;   A1  - Pointer to an SD struct
 ;   A2  - Pointer to register buffer
@@ -431,6 +474,8 @@ INSTALL_BLOCKDEV_HANDLERS::
     move.l  #FW_SD_READ,EFP_SD_READ
     move.l  #FW_SD_WRITE,EFP_SD_WRITE
     move.l  #FW_SD_REG,EFP_SD_REG
+    move.l  #FW_SD_READ_M,EFP_SD_READ_M
+    move.l  #FW_SD_WRITE_M,EFP_SD_WRITE_M
     move.l  #FW_SPI_INIT,EFP_SPI_INIT
     move.l  #FW_SPI_ASSERT_CS,EFP_SPI_CS_A
     move.l  #FW_SPI_DEASSERT_CS,EFP_SPI_CS_D
@@ -180,6 +180,8 @@ INITEFPT:
     move.l  #EFP_DUMMY_ZERO_D0L,EFP_SD_READ
     move.l  #EFP_DUMMY_ZERO_D0L,EFP_SD_WRITE
     move.l  #EFP_DUMMY_ZERO_D0L,EFP_SD_REG
+    move.l  #EFP_DUMMY_ZERO_D0L,EFP_SD_READ_M
+    move.l  #EFP_DUMMY_ZERO_D0L,EFP_SD_WRITE_M
 
     ; Block Device IO Routines - SPI
     move.l  #EFP_DUMMY_NEGONE_D0L,EFP_SPI_INIT
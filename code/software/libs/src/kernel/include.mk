@@ -5,4 +5,6 @@ LIBINCLUDES=$(DIR)/include
 # ---===---
 DIR := $(shell dirname $(lastword $(MAKEFILE_LIST)))
 UPPERLIB := $(shell echo $(LIB) | tr '[:lower:]' '[:upper:]')
+CFLAGS  := $(CFLAGS) -I$(LIBINCLUDES)
+CXXFLAGS := $(CXXFLAGS) -I$(LIBINCLUDES)
 INCLUDES := $(INCLUDES) $(DIR)/include/*
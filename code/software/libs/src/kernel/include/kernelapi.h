@@ -26,7 +26,7 @@
  * Number of slab slots required by a Task structure.
  * 
  */
-#define TASK_SLAB_BLOCKS    2
+#define TASK_SLAB_BLOCKS    3
 
 /**
  * A ListNode is the basic structure for, well, a list node.
@@ -61,6 +61,46 @@ typedef void (*task_handler_f)(void);
 
 typedef uint8_t priority_t;
 
+/**
+ * Runtime statistics for a task. Times are in ticks (at 100Hz).
+ */
+typedef struct {
+    uint32_t                    switches;
+    uint32_t                    ticks;
+    uint32_t                    woken;
+    uint32_t                    max_latency;
+} TaskStats;
+
+/**
+ * A scheduler trace event, recorded for every task switch.
+ */
+typedef struct {
+    uint32_t                    time;
+    tid_t                       from;
+    tid_t                       to;
+    uint8_t                     from_state;
+    priority_t                  to_priority;
+    uint8_t                     pad[2];
+} SchedTraceEvent;
+
+#define SCHED_TRACE_EVENTS      64
+#define SCHED_TRACE_NO_TASK     0xFFFFFFFF
+#define SCHED_TRACE_EXITED      0xFF
+
+struct _Timer;
+
+typedef void (*timer_handler_f)(volatile struct _Timer *timer);
+
+/**
+ * A Timer calls its handler once, from the tick handler, when
+ * it expires. Tasks use theirs for wait / sleep timeouts.
+ */
+typedef volatile struct _Timer {
+    struct _ListNode            node;
+    uint32_t                    expires;
+    timer_handler_f             handler;
+} Timer;
+
 /**
  * A task is an individual thread of execution.
  * 
@@ -73,14 +113,56 @@ typedef struct {
     uint32_t                    stack_size;
     uint32_t                    stack_bottom;
     priority_t                  priority;
-    uint8_t                     pad[3];
+    uint8_t                     state;
+    uint8_t                     pad[2];
+    Timer                       timer;
+    signals_t                   sig_pending;
+    TaskStats                   stats;
+    void*                       user_data;
 } Task;
 
+/**
+ * A counting semaphore. Uncontended wait / signal doesn't
+ * disable interrupts.
+ */
+typedef struct {
+    volatile int32_t            count;
+    uint32_t                    wakeups;
+    List                        waiters;
+} Semaphore;
+
+/**
+ * A mutex. Waiters are woken highest priority first, and
+ * lend the owner their priority while they wait.
+ */
+typedef struct {
+    Semaphore                   sem;
+    Task*                       owner;
+    priority_t                  saved_priority;
+    uint8_t                     boosted;
+    uint8_t                     pad[2];
+} Mutex;
+
+/**
+ * A message port - a fixed-size ring (a power of two) of 
+ * message pointers. Messages are passed, not copied.
+ */
+typedef struct {
+    void**                      slots;
+    uint32_t                    mask;
+    uint32_t                    head;
+    uint32_t                    tail;
+    Semaphore                   items;
+    Semaphore                   spaces;
+    Semaphore                   put_lock;
+    Semaphore                   get_lock;
+} Port;
+
 typedef bool        (*interrupt_service_f)(uint8_t, void*);
 
 typedef struct {
-    void*                       next;
-    void*                       prev;
+    void*                       next;       // Not used - the kernel keeps its
+    void*                       prev;       // own node for each handler
     void*                       data;
     interrupt_service_f         handler;    
 } IrqHandler;
@@ -95,14 +177,34 @@ typedef Task*       (*task_current_f)(void);
 typedef void        (*task_init_f)(Task*, tid_t, priority_t);
 typedef void        (*task_schedule_f)(Task*, uintptr_t, uintptr_t, task_handler_f);
 
+typedef void        (*task_sleep_f)(uint32_t);
+typedef void        (*task_idle_f)(void);
+
 typedef signals_t   (*task_wait_f)(signals_t);
+typedef signals_t   (*task_wait_timeout_f)(signals_t, uint32_t);
 typedef void        (*task_signal_f)(Task*, signals_t);
 
+typedef void        (*task_get_stats_f)(Task*, TaskStats*);
+typedef uint32_t    (*sched_trace_read_f)(SchedTraceEvent*, uint32_t);
+typedef void        (*task_dump_stats_f)(Task*);
+typedef void        (*sched_trace_dump_f)(void);
+
+typedef void        (*semaphore_init_f)(Semaphore*, int32_t);
+typedef void        (*semaphore_wait_f)(Semaphore*);
+typedef void        (*semaphore_signal_f)(Semaphore*);
+typedef void        (*mutex_init_f)(Mutex*);
+typedef void        (*mutex_lock_f)(Mutex*);
+typedef void        (*mutex_unlock_f)(Mutex*);
+typedef Port*       (*port_init_f)(Port*, void**, uint32_t);
+typedef void        (*port_put_f)(Port*, void*);
+typedef void*       (*port_get_f)(Port*);
+
 typedef void        (*enable_interrupts_f)(void);
 typedef void        (*disable_interrupts_f)(void);
 
-typedef void        (*register_irq_f)(uint8_t, IrqHandler*);
+typedef bool        (*register_irq_f)(uint8_t, IrqHandler*);
 typedef void        (*remove_irq_f)(IrqHandler*);
+typedef uint32_t    (*irq_hits_f)(IrqHandler*);
 
 typedef List*       (*list_init_f)(List*);
 typedef ListNode*   (*list_add_head_f)(List*, ListNode*);
@@ -156,6 +258,36 @@ typedef struct {
 
     // start doing the thing
     start_f                     start;
+
+    // Programs index this table by offset, so new entries only ever
+    // go on the end, after everything that's already here.
+
+    // Sleeping / timeouts
+    task_sleep_f                task_sleep;
+    task_wait_timeout_f         task_wait_timeout;
+
+    // Synchronisation
+    semaphore_init_f            semaphore_init;
+    semaphore_wait_f            semaphore_wait;
+    semaphore_signal_f          semaphore_signal;
+    mutex_init_f                mutex_init;
+    mutex_lock_f                mutex_lock;
+    mutex_unlock_f              mutex_unlock;
+    port_init_f                 port_init;
+    port_put_f                  port_put;
+    port_get_f                  port_get;
+
+    // Statistics / tracing
+    task_get_stats_f            task_get_stats;
+    sched_trace_read_f          sched_trace_read;
+    task_dump_stats_f           task_dump_stats;
+    sched_trace_dump_f          sched_trace_dump;
+
+    // Idle
+    task_idle_f                 task_idle;
+
+    // Interrupt statistics
+    irq_hits_f                  irq_hits;
 } IKernel;
 
 static inline IKernel* get_kernel_api() {
@@ -175,7 +307,7 @@ static inline IKernel* ensure_kernel_api() {
     IKernel *result = *(IKernel**)KERNEL_API_ADDRESS;
     if (result == (IKernel*)0xb105d47a) {
         // No kernel in ROM
-        mcPrintln("PANIC: No ROM kernel available");
+        mcPrintln((char*)"PANIC: No ROM kernel available");
         abort();
 
         __builtin_unreachable();
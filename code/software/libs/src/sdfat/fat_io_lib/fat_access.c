@@ -30,6 +30,7 @@
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 #include <string.h>
+#include <stdlib.h>
 #include "fat_defs.h"
 #include "fat_access.h"
 #include "fat_table.h"
@@ -57,6 +58,7 @@ int fatfs_init(struct fatfs *fs)
     fs->next_free_cluster = 0; // Invalid
 
     fatfs_fat_init(fs);
+    fatfs_sector_cache_reset(fs);
 
     // Make sure we have a read function (write function is optional)
     if (!fs->disk_io.read_media)
@@ -122,6 +124,7 @@ int fatfs_init(struct fatfs *fs)
     fs->sectors_per_cluster = fs->currentsector.sector[BPB_SECPERCLUS];
     reserved_sectors = GET_16BIT_WORD(fs->currentsector.sector, BPB_RSVDSECCNT);
     num_of_fats = fs->currentsector.sector[BPB_NUMFATS];
+    fs->num_of_fats = num_of_fats;
     fs->root_entry_count = GET_16BIT_WORD(fs->currentsector.sector, BPB_ROOTENTCNT);
 
     if(GET_16BIT_WORD(fs->currentsector.sector, BPB_FATSZ16) != 0)
@@ -165,6 +168,7 @@ int fatfs_init(struct fatfs *fs)
     if (fs->sectors_per_cluster != 0)
     {
         count_of_clusters = data_sectors / fs->sectors_per_cluster;
+        fs->cluster_count = count_of_clusters;
 
         if(count_of_clusters < 4085)
             // Volume is FAT12
@@ -200,10 +204,248 @@ uint32 fatfs_lba_of_cluster(struct fatfs *fs, uint32 Cluster_Number)
         return ((fs->cluster_begin_lba + ((Cluster_Number-2)*fs->sectors_per_cluster)));
 }
 //-----------------------------------------------------------------------------
+//                          Directory / Data Sector Cache
+//-----------------------------------------------------------------------------
+// Sectors loaded into currentsector are also kept in a small LRU cache, so
+// going back over the same directories doesn't go back to the media.
+// Changes made through currentsector are written back when an entry is
+// evicted or the cache is flushed (which fatfs_fat_purge does, so at the end
+// of each operation). FAT sectors have their own buffers (see fat_table.c),
+// so scanning directories can't push them out.
+//-----------------------------------------------------------------------------
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_find: Find a sector in the cache, making it the most
+// recently used
+//-----------------------------------------------------------------------------
+static struct sector_buffer *fatfs_sector_cache_find(struct fatfs *fs, uint32 lba)
+{
+    struct sector_buffer *last = NULL;
+    struct sector_buffer *pcur = fs->sector_cache_head;
+
+    while (pcur)
+    {
+        if (pcur->address == lba)
+        {
+            // Move to head of list
+            if (last)
+            {
+                last->next = pcur->next;
+                pcur->next = fs->sector_cache_head;
+                fs->sector_cache_head = pcur;
+            }
+
+            return pcur;
+        }
+
+        last = pcur;
+        pcur = pcur->next;
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_writeback: Write an entry back if it's dirty
+//-----------------------------------------------------------------------------
+static int fatfs_sector_cache_writeback(struct fatfs *fs, struct sector_buffer *pcur)
+{
+    if (pcur->dirty)
+    {
+        if (!fs->disk_io.write_media || !fs->disk_io.write_media(pcur->address, pcur->sector, 1))
+            return 0;
+
+        pcur->dirty = 0;
+        fs->cache_stats.sector_writebacks++;
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_victim: Reuse the least recently used entry for a new
+// sector, writing it back first if need be
+//-----------------------------------------------------------------------------
+static struct sector_buffer *fatfs_sector_cache_victim(struct fatfs *fs, uint32 lba)
+{
+    struct sector_buffer *last = NULL;
+    struct sector_buffer *pcur = fs->sector_cache_head;
+
+    if (!pcur)
+        return NULL;
+
+    // Find the tail
+    while (pcur->next)
+    {
+        last = pcur;
+        pcur = pcur->next;
+    }
+
+    if (!fatfs_sector_cache_writeback(fs, pcur))
+        return NULL;
+
+    // Move to head of list
+    if (last)
+    {
+        last->next = NULL;
+        pcur->next = fs->sector_cache_head;
+        fs->sector_cache_head = pcur;
+    }
+
+    pcur->address = lba;
+    return pcur;
+}
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_sync: Keep the cache coherent with a direct media access
+// to a range of sectors - written back before reads, dropped on writes
+//-----------------------------------------------------------------------------
+static int fatfs_sector_cache_sync(struct fatfs *fs, uint32 lba, uint32 count, int write)
+{
+    struct sector_buffer *pcur;
+
+    for (pcur = fs->sector_cache_head; pcur; pcur = pcur->next)
+    {
+        if (pcur->address >= lba && pcur->address < lba + count)
+        {
+            if (write)
+            {
+                pcur->address = FAT32_INVALID_CLUSTER;
+                pcur->dirty = 0;
+            }
+            else if (!fatfs_sector_cache_writeback(fs, pcur))
+                return 0;
+        }
+    }
+
+    if (write && fs->currentsector.address >= lba && fs->currentsector.address < lba + count)
+        fs->currentsector.address = FAT32_INVALID_CLUSTER;
+
+    return 1;
+}
+#endif
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_alloc: Allocate cache entries from the heap
+//-----------------------------------------------------------------------------
+int fatfs_sector_cache_alloc(struct fatfs *fs, uint32 entries)
+{
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    free(fs->sector_cache);
+
+    fs->sector_cache = entries ? malloc(entries * sizeof(struct sector_buffer)) : NULL;
+    fs->sector_cache_entries = fs->sector_cache ? entries : 0;
+
+    fatfs_sector_cache_reset(fs);
+
+    return fs->sector_cache != NULL;
+#else
+    return 0;
+#endif
+}
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_reset: Empty the cache, dropping any unwritten changes
+//-----------------------------------------------------------------------------
+void fatfs_sector_cache_reset(struct fatfs *fs)
+{
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    uint32 i;
+
+    fs->sector_cache_head = NULL;
+
+    for (i=0;i<fs->sector_cache_entries;i++)
+    {
+        fs->sector_cache[i].address = FAT32_INVALID_CLUSTER;
+        fs->sector_cache[i].dirty = 0;
+
+        // Add to head of queue
+        fs->sector_cache[i].next = fs->sector_cache_head;
+        fs->sector_cache_head = &fs->sector_cache[i];
+    }
+#endif
+}
+//-----------------------------------------------------------------------------
+// fatfs_sector_cache_flush: Write back all changed sectors
+//-----------------------------------------------------------------------------
+int fatfs_sector_cache_flush(struct fatfs *fs)
+{
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    struct sector_buffer *pcur;
+
+    for (pcur = fs->sector_cache_head; pcur; pcur = pcur->next)
+        if (!fatfs_sector_cache_writeback(fs, pcur))
+            return 0;
+#endif
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// fatfs_read_current_sector: Load a sector into currentsector
+//-----------------------------------------------------------------------------
+int fatfs_read_current_sector(struct fatfs *fs, uint32 lba)
+{
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    struct sector_buffer *pcur = fatfs_sector_cache_find(fs, lba);
+
+    if (pcur)
+    {
+        fs->cache_stats.sector_hits++;
+        memcpy(fs->currentsector.sector, pcur->sector, FAT_SECTOR_SIZE);
+        fs->currentsector.address = lba;
+        return 1;
+    }
+
+    fs->cache_stats.sector_misses++;
+#endif
+
+    fs->currentsector.address = lba;
+
+    if (!fs->disk_io.read_media(lba, fs->currentsector.sector, 1))
+    {
+        fs->currentsector.address = FAT32_INVALID_CLUSTER;
+        return 0;
+    }
+
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    // Not being able to cache it isn't an error
+    if ((pcur = fatfs_sector_cache_victim(fs, lba)) != NULL)
+        memcpy(pcur->sector, fs->currentsector.sector, FAT_SECTOR_SIZE);
+#endif
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// fatfs_write_current_sector: Write currentsector back (to the cache, if
+// there is one)
+//-----------------------------------------------------------------------------
+int fatfs_write_current_sector(struct fatfs *fs)
+{
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    struct sector_buffer *pcur;
+
+    if (!fs->disk_io.write_media)
+        return 0;
+
+    pcur = fatfs_sector_cache_find(fs, fs->currentsector.address);
+    if (!pcur)
+        pcur = fatfs_sector_cache_victim(fs, fs->currentsector.address);
+
+    if (pcur)
+    {
+        memcpy(pcur->sector, fs->currentsector.sector, FAT_SECTOR_SIZE);
+        pcur->dirty = 1;
+        return 1;
+    }
+#endif
+
+    return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+}
+//-----------------------------------------------------------------------------
 // fatfs_sector_read:
 //-----------------------------------------------------------------------------
 int fatfs_sector_read(struct fatfs *fs, uint32 lba, uint8 *target, uint32 count)
 {
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    if (!fatfs_sector_cache_sync(fs, lba, count, 0))
+        return 0;
+#endif
+
     return fs->disk_io.read_media(lba, target, count);
 }
 //-----------------------------------------------------------------------------
@@ -211,6 +453,10 @@ int fatfs_sector_read(struct fatfs *fs, uint32 lba, uint8 *target, uint32 count)
 //-----------------------------------------------------------------------------
 int fatfs_sector_write(struct fatfs *fs, uint32 lba, uint8 *target, uint32 count)
 {
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    fatfs_sector_cache_sync(fs, lba, count, 1);
+#endif
+
     return fs->disk_io.write_media(lba, target, count);
 }
 //-----------------------------------------------------------------------------
@@ -257,13 +503,10 @@ int fatfs_sector_reader(struct fatfs *fs, uint32 start_cluster, uint32 offset, u
 
     // User provided target array
     if (target)
-        return fs->disk_io.read_media(lba, target, 1);
+        return fatfs_sector_read(fs, lba, target, 1);
     // Else read sector if not already loaded
     else if (lba != fs->currentsector.address)
-    {
-        fs->currentsector.address = lba;
-        return fs->disk_io.read_media(fs->currentsector.address, fs->currentsector.sector, 1);
-    }
+        return fatfs_read_current_sector(fs, lba);
     else
         return 1;
 }
@@ -288,15 +531,12 @@ int fatfs_read_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *ta
         if (target)
         {
             // Read from disk
-            return fs->disk_io.read_media(lba, target, 1);
+            return fatfs_sector_read(fs, lba, target, 1);
         }
         else
         {
-            // Calculate read address
-            fs->currentsector.address = lba;
-
             // Read from disk
-            return fs->disk_io.read_media(fs->currentsector.address, fs->currentsector.sector, 1);
+            return fatfs_read_current_sector(fs, lba);
         }
     }
     // FAT16/32 Other
@@ -309,15 +549,12 @@ int fatfs_read_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *ta
             uint32 lba = fatfs_lba_of_cluster(fs, cluster) + sector;
 
             // Read from disk
-            return fs->disk_io.read_media(lba, target, 1);
+            return fatfs_sector_read(fs, lba, target, 1);
         }
         else
         {
-            // Calculate write address
-            fs->currentsector.address = fatfs_lba_of_cluster(fs, cluster)+sector;
-
             // Read from disk
-            return fs->disk_io.read_media(fs->currentsector.address, fs->currentsector.sector, 1);
+            return fatfs_read_current_sector(fs, fatfs_lba_of_cluster(fs, cluster)+sector);
         }
     }
 }
@@ -347,7 +584,7 @@ int fatfs_write_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *t
         if (target)
         {
             // Write to disk
-            return fs->disk_io.write_media(lba, target, 1);
+            return fatfs_sector_write(fs, lba, target, 1);
         }
         else
         {
@@ -355,7 +592,7 @@ int fatfs_write_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *t
             fs->currentsector.address = lba;
 
             // Write to disk
-            return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+            return fatfs_write_current_sector(fs);
         }
     }
     // FAT16/32 Other
@@ -368,7 +605,7 @@ int fatfs_write_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *t
             uint32 lba = fatfs_lba_of_cluster(fs, cluster) + sector;
 
             // Write to disk
-            return fs->disk_io.write_media(lba, target, 1);
+            return fatfs_sector_write(fs, lba, target, 1);
         }
         else
         {
@@ -376,7 +613,7 @@ int fatfs_write_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *t
             fs->currentsector.address = fatfs_lba_of_cluster(fs, cluster)+sector;
 
             // Write to disk
-            return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+            return fatfs_write_current_sector(fs);
         }
     }
 }
@@ -666,7 +903,7 @@ int fatfs_update_file_length(struct fatfs *fs, uint32 Cluster, char *shortname,
                         memcpy((uint8*)(fs->currentsector.sector+recordoffset), (uint8*)directoryEntry, sizeof(struct fat_dir_entry));
 
                         // Write sector back
-                        return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+                        return fatfs_write_current_sector(fs);
                     }
                 }
             } // End of if
@@ -737,7 +974,7 @@ int fatfs_mark_file_deleted(struct fatfs *fs, uint32 Cluster, char *shortname)
                         memcpy((uint8*)(fs->currentsector.sector+recordoffset), (uint8*)directoryEntry, sizeof(struct fat_dir_entry));
 
                         // Write sector back
-                        return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+                        return fatfs_write_current_sector(fs);
                     }
                 }
             } // End of if
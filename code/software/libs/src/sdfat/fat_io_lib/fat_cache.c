@@ -31,6 +31,7 @@
 //-----------------------------------------------------------------------------
 #include <string.h>
 #include "fat_cache.h"
+#include "fat_table.h"
 
 // Per file cluster chain caching used to improve performance.
 // This does not have to be enabled for architectures with low
@@ -51,6 +52,11 @@ int fatfs_cache_init(struct fatfs *fs, FL_FILE *file)
     }
 #endif
 
+#ifdef FAT_EXTENT_MAP_ENTRIES
+    file->extent_count = 0;
+    file->extent_complete = 0;
+#endif
+
     return 1;
 }
 //-----------------------------------------------------------------------------
@@ -89,3 +95,93 @@ int fatfs_cache_set_next_cluster(struct fatfs *fs, FL_FILE *file, uint32 cluster
 
     return 1;
 }
+//-----------------------------------------------------------------------------
+// fatfs_cache_get_extent: Find the cluster at clusterIdx within the file, and
+// how many clusters follow on from it contiguously (pRun, including itself).
+// The map of contiguous runs is built as it's needed, walking the chain no
+// further than 'want' clusters from clusterIdx.
+// Returns 0 if the cluster isn't mapped (past the end, or the map is full)
+//-----------------------------------------------------------------------------
+int fatfs_cache_get_extent(struct fatfs *fs, FL_FILE *file, uint32 clusterIdx, uint32 want, uint32 *pCluster, uint32 *pRun)
+{
+#ifdef FAT_EXTENT_MAP_ENTRIES
+    struct cluster_extent *ext;
+    uint32 lo, hi;
+
+    if (file->startcluster == 0)
+        return 0;
+
+    // First run starts at the start of the chain
+    if (file->extent_count == 0)
+    {
+        file->extents[0].ClusterIdx = 0;
+        file->extents[0].Cluster = file->startcluster;
+        file->extents[0].Length = 1;
+        file->extent_count = 1;
+    }
+
+    ext = &file->extents[file->extent_count - 1];
+
+    // Follow the chain on from the end of the map, as far as is wanted
+    while (!file->extent_complete && (ext->ClusterIdx + ext->Length) < (clusterIdx + want))
+    {
+        uint32 last = ext->Cluster + ext->Length - 1;
+        uint32 nextCluster = fatfs_find_next_cluster(fs, last);
+
+        if (nextCluster == FAT32_LAST_CLUSTER)
+            file->extent_complete = 1;
+        else if (nextCluster == last + 1)
+            ext->Length++;
+        else if (file->extent_count < FAT_EXTENT_MAP_ENTRIES)
+        {
+            // Start a new run
+            ext[1].ClusterIdx = ext->ClusterIdx + ext->Length;
+            ext[1].Cluster = nextCluster;
+            ext[1].Length = 1;
+            file->extent_count++;
+            ext++;
+
+            // The run we were after has ended
+            if (clusterIdx < ext->ClusterIdx)
+                break;
+        }
+        else
+            break;
+    }
+
+    if (clusterIdx >= ext->ClusterIdx + ext->Length)
+        return 0;
+
+    // Find the run it's in
+    lo = 0;
+    hi = file->extent_count - 1;
+    while (lo < hi)
+    {
+        uint32 mid = (lo + hi + 1) / 2;
+
+        if (file->extents[mid].ClusterIdx <= clusterIdx)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    ext = &file->extents[lo];
+    *pCluster = ext->Cluster + (clusterIdx - ext->ClusterIdx);
+    *pRun = ext->Length - (clusterIdx - ext->ClusterIdx);
+    return 1;
+#else
+    return 0;
+#endif
+}
+//-----------------------------------------------------------------------------
+// fatfs_cache_chain_extended: Clusters have been added to the end of the
+// file's chain, so the map doesn't end where it did
+//-----------------------------------------------------------------------------
+int fatfs_cache_chain_extended(struct fatfs *fs, FL_FILE *file)
+{
+#ifdef FAT_EXTENT_MAP_ENTRIES
+    file->extent_complete = 0;
+#endif
+
+    return 1;
+}
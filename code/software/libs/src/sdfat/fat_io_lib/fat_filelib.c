@@ -553,11 +553,31 @@ static uint32 _read_sectors(FL_FILE* file, uint32 offset, uint8 *buffer, uint32
     uint32 Cluster = 0;
     uint32 i;
     uint32 lba;
+    uint32 Run;
 
     // Find cluster index within file & sector with cluster
     ClusterIdx = offset / _fs.sectors_per_cluster;
     Sector = offset - (ClusterIdx * _fs.sectors_per_cluster);
 
+    // If the extent map has it, read as far as the clusters are contiguous
+    if (fatfs_cache_get_extent(&_fs, file, ClusterIdx, (Sector + count + _fs.sectors_per_cluster - 1) / _fs.sectors_per_cluster, &Cluster, &Run))
+    {
+        if ((Sector + count) > (Run * _fs.sectors_per_cluster))
+            count = (Run * _fs.sectors_per_cluster) - Sector;
+
+        lba = fatfs_lba_of_cluster(&_fs, Cluster) + Sector;
+
+        // Record the last cluster touched, for the chain walk below
+        i = (Sector + count - 1) / _fs.sectors_per_cluster;
+        file->last_fat_lookup.CurrentCluster = Cluster + i;
+        file->last_fat_lookup.ClusterIdx = ClusterIdx + i;
+
+        if (fatfs_sector_read(&_fs, lba, buffer, count))
+            return count;
+        else
+            return 0;
+    }
+
     // Limit number of sectors read to the number remaining in this cluster
     if ((Sector + count) > _fs.sectors_per_cluster)
         count = _fs.sectors_per_cluster - Sector;
@@ -640,6 +660,11 @@ void fl_init(void)
     for (i=0;i<FATFS_MAX_OPEN_FILES;i++)
         fat_list_insert_last(&_free_file_list, &_files[i].list_node);
 
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    // Without one, sectors are just read and written as before
+    fatfs_sector_cache_alloc(&_fs, FAT_SECTOR_CACHE_ENTRIES);
+#endif
+
     _filelib_init = 1;
 }
 //-----------------------------------------------------------------------------
@@ -812,12 +837,32 @@ static uint32 _write_sectors(FL_FILE* file, uint32 offset, uint8 *buf, uint32 co
     uint32 LastCluster = FAT32_LAST_CLUSTER;
     uint32 i;
     uint32 lba;
+    uint32 Run;
     uint32 TotalWriteCount = count;
 
     // Find values for Cluster index & sector within cluster
     ClusterIdx = offset / _fs.sectors_per_cluster;
     SectorNumber = offset - (ClusterIdx * _fs.sectors_per_cluster);
 
+    // If the extent map has it, write as far as the clusters are contiguous
+    if (fatfs_cache_get_extent(&_fs, file, ClusterIdx, (SectorNumber + count + _fs.sectors_per_cluster - 1) / _fs.sectors_per_cluster, &Cluster, &Run))
+    {
+        if ((SectorNumber + count) > (Run * _fs.sectors_per_cluster))
+            count = (Run * _fs.sectors_per_cluster) - SectorNumber;
+
+        lba = fatfs_lba_of_cluster(&_fs, Cluster) + SectorNumber;
+
+        // Record the last cluster touched, for the chain walk below
+        i = (SectorNumber + count - 1) / _fs.sectors_per_cluster;
+        file->last_fat_lookup.CurrentCluster = Cluster + i;
+        file->last_fat_lookup.ClusterIdx = ClusterIdx + i;
+
+        if (fatfs_sector_write(&_fs, lba, buf, count))
+            return count;
+        else
+            return 0;
+    }
+
     // Limit number of sectors written to the number remaining in this cluster
     if ((SectorNumber + count) > _fs.sectors_per_cluster)
         count = _fs.sectors_per_cluster - SectorNumber;
@@ -872,6 +917,8 @@ static uint32 _write_sectors(FL_FILE* file, uint32 offset, uint8 *buf, uint32 co
             if (!fatfs_add_free_space(&_fs, &LastCluster,  (TotalWriteCount + _fs.sectors_per_cluster -1) / _fs.sectors_per_cluster))
                 return 0;
 
+            fatfs_cache_chain_extended(&_fs, file);
+
             Cluster = LastCluster;
         }
 
@@ -912,6 +959,8 @@ int fl_fflush(void *f)
                 file->file_data_dirty = 0;
         }
 
+        fatfs_sector_cache_flush(&_fs);
+
         FL_UNLOCK(&_fs);
     }
 #endif
@@ -1594,6 +1643,15 @@ int fl_format(uint32 volume_sectors, const char *name)
 }
 #endif /*FATFS_INC_FORMAT_SUPPORT*/
 //-----------------------------------------------------------------------------
+// fl_get_cache_stats: Get cache hit / miss counts
+//-----------------------------------------------------------------------------
+void fl_get_cache_stats(struct fat_cache_stats *stats)
+{
+    FL_LOCK(&_fs);
+    *stats = _fs.cache_stats;
+    FL_UNLOCK(&_fs);
+}
+//-----------------------------------------------------------------------------
 // fl_get_fs:
 //-----------------------------------------------------------------------------
 #ifdef FATFS_INC_TEST_HOOKS
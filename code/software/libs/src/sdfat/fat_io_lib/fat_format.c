@@ -1,34 +1,34 @@
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
-//                            FAT16/32 File IO Library
-//                                    V2.6
-//                              Ultra-Embedded.com
-//                            Copyright 2003 - 2012
-//
-//                         Email: admin@ultra-embedded.com
-//
-//                                License: GPL
-//   If you would like a version with a more permissive license for use in
-//   closed source commercial applications please contact me for details.
-//-----------------------------------------------------------------------------
-//
-// This file is part of FAT File IO Library.
-//
-// FAT File IO Library is free software; you can redistribute it and/or modify
-// it under the terms of the GNU General Public License as published by
-// the Free Software Foundation; either version 2 of the License, or
-// (at your option) any later version.
-//
-// FAT File IO Library is distributed in the hope that it will be useful,
-// but WITHOUT ANY WARRANTY; without even the implied warranty of
-// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-// GNU General Public License for more details.
-//
-// You should have received a copy of the GNU General Public License
-// along with FAT File IO Library; if not, write to the Free Software
-// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
-//-----------------------------------------------------------------------------
-//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//                            FAT16/32 File IO Library
+//                                    V2.6
+//                              Ultra-Embedded.com
+//                            Copyright 2003 - 2012
+//
+//                         Email: admin@ultra-embedded.com
+//
+//                                License: GPL
+//   If you would like a version with a more permissive license for use in
+//   closed source commercial applications please contact me for details.
+//-----------------------------------------------------------------------------
+//
+// This file is part of FAT File IO Library.
+//
+// FAT File IO Library is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// FAT File IO Library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with FAT File IO Library; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
 #include <string.h>
 #include "fat_defs.h"
 #include "fat_access.h"
@@ -421,6 +421,17 @@ static int fatfs_erase_fat(struct fatfs *fs, int is_fat32)
     return 1;
 }
 //-----------------------------------------------------------------------------
+// fatfs_format_cluster_count: Count the data clusters on the new volume, the
+// same way fatfs_init does when it's mounted
+//-----------------------------------------------------------------------------
+static uint32 fatfs_format_cluster_count(struct fatfs *fs, uint32 volume_sectors)
+{
+    uint32 root_dir_sectors = ((fs->root_entry_count * 32) + (FAT_SECTOR_SIZE - 1)) / FAT_SECTOR_SIZE;
+    uint32 data_sectors = volume_sectors - (fs->reserved_sectors + (fs->num_of_fats * fs->fat_sectors) + root_dir_sectors);
+
+    return data_sectors / fs->sectors_per_cluster;
+}
+//-----------------------------------------------------------------------------
 // fatfs_format_fat16: Format a FAT16 partition
 //-----------------------------------------------------------------------------
 int fatfs_format_fat16(struct fatfs *fs, uint32 volume_sectors, const char *name)
@@ -429,8 +440,10 @@ int fatfs_format_fat16(struct fatfs *fs, uint32 volume_sectors, const char *name
     fs->currentsector.dirty = 0;
 
     fs->next_free_cluster = 0; // Invalid
+    fs->cluster_count = 0; // Known once the boot sector is made
 
     fatfs_fat_init(fs);
+    fatfs_sector_cache_reset(fs);
 
     // Make sure we have read + write functions
     if (!fs->disk_io.read_media || !fs->disk_io.write_media)
@@ -449,6 +462,9 @@ int fatfs_format_fat16(struct fatfs *fs, uint32 volume_sectors, const char *name
     if (!fatfs_create_boot_sector(fs, fs->lba_begin, volume_sectors, name, 0))
         return 0;
 
+    // Bounds the free cluster search
+    fs->cluster_count = fatfs_format_cluster_count(fs, volume_sectors);
+
     // For FAT16 (which this may be), rootdir_first_cluster is actuall rootdir_first_sector
     fs->rootdir_first_sector = fs->reserved_sectors + (fs->num_of_fats * fs->fat_sectors);
     fs->rootdir_sectors = ((fs->root_entry_count * 32) + (FAT_SECTOR_SIZE - 1)) / FAT_SECTOR_SIZE;
@@ -478,8 +494,10 @@ int fatfs_format_fat32(struct fatfs *fs, uint32 volume_sectors, const char *name
     fs->currentsector.dirty = 0;
 
     fs->next_free_cluster = 0; // Invalid
+    fs->cluster_count = 0; // Known once the boot sector is made
 
     fatfs_fat_init(fs);
+    fatfs_sector_cache_reset(fs);
 
     // Make sure we have read + write functions
     if (!fs->disk_io.read_media || !fs->disk_io.write_media)
@@ -498,6 +516,9 @@ int fatfs_format_fat32(struct fatfs *fs, uint32 volume_sectors, const char *name
     if (!fatfs_create_boot_sector(fs, fs->lba_begin, volume_sectors, name, 1))
         return 0;
 
+    // Bounds the free cluster search
+    fs->cluster_count = fatfs_format_cluster_count(fs, volume_sectors);
+
     // First FAT LBA address
     fs->fat_begin_lba = fs->lba_begin + fs->reserved_sectors;
 
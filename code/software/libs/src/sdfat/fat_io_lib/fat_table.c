@@ -30,6 +30,7 @@
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 #include <string.h>
+#include <stdlib.h>
 #include "fat_defs.h"
 #include "fat_access.h"
 #include "fat_table.h"
@@ -54,6 +55,10 @@
 #define FAT16_GET_16BIT_WORD(pbuf, location)        ( GET_16BIT_WORD(pbuf->ptr, location) )
 #define FAT16_SET_16BIT_WORD(pbuf, location, value) { SET_16BIT_WORD(pbuf->ptr, location, value); pbuf->dirty = 1; }
 
+#define FAT_BITMAP_TEST(map, cluster)               ( (map)[(cluster) / 32] & (1UL << ((cluster) & 31)) )
+#define FAT_BITMAP_SET(map, cluster)                ( (map)[(cluster) / 32] |= (1UL << ((cluster) & 31)) )
+#define FAT_BITMAP_CLEAR(map, cluster)              ( (map)[(cluster) / 32] &= ~(1UL << ((cluster) & 31)) )
+
 //-----------------------------------------------------------------------------
 // fatfs_fat_init:
 //-----------------------------------------------------------------------------
@@ -76,6 +81,15 @@ void fatfs_fat_init(struct fatfs *fs)
         fs->fat_buffers[i].next = fs->fat_buffer_head;
         fs->fat_buffer_head = &fs->fat_buffers[i];
     }
+
+    fs->fs_info_dirty = 0;
+
+#ifdef FAT_FREE_BITMAP_MAX
+    // Rebuilt when next needed
+    free(fs->free_bitmap);
+    fs->free_bitmap = NULL;
+    fs->free_bitmap_clusters = 0;
+#endif
 }
 //-----------------------------------------------------------------------------
 // fatfs_fat_writeback: Writeback 'dirty' FAT sectors to disk
@@ -89,6 +103,7 @@ static int fatfs_fat_writeback(struct fatfs *fs, struct fat_buffer *pcur)
         {
             if (fs->disk_io.write_media)
             {
+                uint32 i;
                 uint32 sectors = FAT_BUFFER_SECTORS;
                 uint32 offset = pcur->address - fs->fat_begin_lba;
 
@@ -100,6 +115,11 @@ static int fatfs_fat_writeback(struct fatfs *fs, struct fat_buffer *pcur)
 
                 if (!fs->disk_io.write_media(pcur->address, pcur->sector, sectors))
                     return 0;
+
+                // Keep the other copies of the FAT in step
+                for (i=1;i<fs->num_of_fats;i++)
+                    if (!fs->disk_io.write_media(pcur->address + (i * fs->fat_sectors), pcur->sector, sectors))
+                        return 0;
             }
 
             pcur->dirty = 0;
@@ -143,6 +163,7 @@ static struct fat_buffer *fatfs_fat_read_sector(struct fatfs *fs, uint32 sector)
     // We found the sector already in FAT buffer chain
     if (pcur)
     {
+        fs->cache_stats.fat_hits++;
         pcur->ptr = (uint8 *)(pcur->sector + ((sector - pcur->address) * FAT_SECTOR_SIZE));
         return pcur;
     }
@@ -150,6 +171,8 @@ static struct fat_buffer *fatfs_fat_read_sector(struct fatfs *fs, uint32 sector)
     // Else, we removed the last item from the list
     pcur = last;
 
+    fs->cache_stats.fat_misses++;
+
     // Add to start of sector buffer list (now newest sector)
     pcur->next = fs->fat_buffer_head;
     fs->fat_buffer_head = pcur;
@@ -174,12 +197,46 @@ static struct fat_buffer *fatfs_fat_read_sector(struct fatfs *fs, uint32 sector)
     return pcur;
 }
 //-----------------------------------------------------------------------------
+// fatfs_fs_info_writeback: Write the next free cluster hint to FSINFO
+//-----------------------------------------------------------------------------
+static void fatfs_fs_info_writeback(struct fatfs *fs)
+{
+    struct fat_buffer *pbuf;
+
+    if (!fs->fs_info_dirty)
+        return ;
+
+    fs->fs_info_dirty = 0;
+
+    // Load sector to change it
+    pbuf = fatfs_fat_read_sector(fs, fs->lba_begin+fs->fs_info_sector);
+    if (!pbuf)
+        return ;
+
+    // Change
+    FAT32_SET_32BIT_WORD(pbuf, 492, fs->next_free_cluster);
+
+    // Write back FSINFO sector to disk
+    if (fs->disk_io.write_media)
+        fs->disk_io.write_media(pbuf->address, pbuf->sector, 1);
+
+    // Invalidate cache entry
+    pbuf->address = FAT32_INVALID_CLUSTER;
+    pbuf->dirty = 0;
+}
+//-----------------------------------------------------------------------------
 // fatfs_fat_purge: Purge 'dirty' FAT sectors to disk
 //-----------------------------------------------------------------------------
 int fatfs_fat_purge(struct fatfs *fs)
 {
     struct fat_buffer *pcur = fs->fat_buffer_head;
 
+    // Directory sectors go first, as they refer to the FAT
+    if (!fatfs_sector_cache_flush(fs))
+        return 0;
+
+    fatfs_fs_info_writeback(fs);
+
     // Itterate through sector buffer list
     while (pcur)
     {
@@ -259,28 +316,107 @@ uint32 fatfs_find_next_cluster(struct fatfs *fs, uint32 current_cluster)
 //-----------------------------------------------------------------------------
 void fatfs_set_fs_info_next_free_cluster(struct fatfs *fs, uint32 newValue)
 {
-    if (fs->fat_type == FAT_TYPE_16)
-        ;
-    else
+    fs->next_free_cluster = newValue;
+
+    // Written to FSINFO (FAT32 only) by fatfs_fat_purge
+    if (fs->fat_type == FAT_TYPE_32)
+        fs->fs_info_dirty = 1;
+}
+#if FATFS_INC_WRITE_SUPPORT && defined(FAT_FREE_BITMAP_MAX)
+//-----------------------------------------------------------------------------
+// fatfs_free_bitmap_build: Read the whole FAT once to find the free clusters,
+// after which they can be found without reading it again.
+// Returns 0 if there's no bitmap (not enough memory, or a read failed)
+//-----------------------------------------------------------------------------
+static int fatfs_free_bitmap_build(struct fatfs *fs)
+{
+    uint32 clusters, words, i, j;
+    uint32 per_sector = (fs->fat_type == FAT_TYPE_16) ? 256 : 128;
+    struct fat_buffer *pbuf;
+
+    if (fs->free_bitmap)
+        return 1;
+
+    clusters = fs->fat_sectors * per_sector;
+
+    // The last FAT sector can have entries past the end of the volume
+    if (fs->cluster_count && clusters > fs->cluster_count + 2)
+        clusters = fs->cluster_count + 2;
+
+    words = (clusters + 31) / 32;
+
+    if (words * 4 > FAT_FREE_BITMAP_MAX)
+        return 0;
+
+    fs->free_bitmap = (uint32*)malloc(words * 4);
+    if (!fs->free_bitmap)
+        return 0;
+
+    memset(fs->free_bitmap, 0, words * 4);
+
+    for (i = 0; i < fs->fat_sectors; i++)
     {
-        // Load sector to change it
-        struct fat_buffer *pbuf = fatfs_fat_read_sector(fs, fs->lba_begin+fs->fs_info_sector);
+        // Read FAT sector into buffer
+        pbuf = fatfs_fat_read_sector(fs, fs->fat_begin_lba + i);
         if (!pbuf)
-            return ;
+        {
+            free(fs->free_bitmap);
+            fs->free_bitmap = NULL;
+            return 0;
+        }
+
+        for (j = 0; j < per_sector && (i * per_sector + j) < clusters; j++)
+        {
+            uint32 entry;
+
+            if (fs->fat_type == FAT_TYPE_16)
+                entry = FAT16_GET_16BIT_WORD(pbuf, (uint16)(j * 2));
+            else
+                entry = FAT32_GET_32BIT_WORD(pbuf, (uint16)(j * 4)) & 0x0FFFFFFF;
+
+            if (entry)
+                FAT_BITMAP_SET(fs->free_bitmap, i * per_sector + j);
+        }
+    }
+
+    fs->free_bitmap_clusters = clusters;
+    return 1;
+}
+//-----------------------------------------------------------------------------
+// fatfs_free_bitmap_find: Find the first free cluster from start_cluster,
+// wrapping round to the start of the volume if need be
+//-----------------------------------------------------------------------------
+static int fatfs_free_bitmap_find(struct fatfs *fs, uint32 start_cluster, uint32 *free_cluster)
+{
+    uint32 cluster, end;
+    int pass;
 
-        // Change
-        FAT32_SET_32BIT_WORD(pbuf, 492, newValue);
-        fs->next_free_cluster = newValue;
+    if (start_cluster < 2 || start_cluster >= fs->free_bitmap_clusters)
+        start_cluster = 2;
 
-        // Write back FSINFO sector to disk
-        if (fs->disk_io.write_media)
-            fs->disk_io.write_media(pbuf->address, pbuf->sector, 1);
+    for (pass = 0; pass < 2; pass++)
+    {
+        cluster = pass ? 2 : start_cluster;
+        end = pass ? start_cluster : fs->free_bitmap_clusters;
 
-        // Invalidate cache entry
-        pbuf->address = FAT32_INVALID_CLUSTER;
-        pbuf->dirty = 0;
+        while (cluster < end)
+        {
+            // Skip a whole word of used clusters at a time
+            if (!(cluster & 31) && fs->free_bitmap[cluster / 32] == 0xFFFFFFFF)
+                cluster += 32;
+            else if (FAT_BITMAP_TEST(fs->free_bitmap, cluster))
+                cluster++;
+            else
+            {
+                *free_cluster = cluster;
+                return 1;
+            }
+        }
     }
+
+    return 0;
 }
+#endif
 //-----------------------------------------------------------------------------
 // fatfs_find_blank_cluster: Find a free cluster entry by reading the FAT
 //-----------------------------------------------------------------------------
@@ -292,8 +428,17 @@ int fatfs_find_blank_cluster(struct fatfs *fs, uint32 start_cluster, uint32 *fre
     uint32 current_cluster = start_cluster;
     struct fat_buffer *pbuf;
 
+#ifdef FAT_FREE_BITMAP_MAX
+    if (fatfs_free_bitmap_build(fs))
+        return fatfs_free_bitmap_find(fs, start_cluster, free_cluster);
+#endif
+
     do
     {
+        // Don't go past the last cluster on the volume
+        if (fs->cluster_count && current_cluster >= fs->cluster_count + 2)
+            return 0;
+
         // Find which sector of FAT table to read
         if (fs->fat_type == FAT_TYPE_16)
             fat_sector_offset = current_cluster / 256;
@@ -362,6 +507,17 @@ int fatfs_fat_set_cluster(struct fatfs *fs, uint32 cluster, uint32 next_cluster)
     if (!pbuf)
         return 0;
 
+#ifdef FAT_FREE_BITMAP_MAX
+    // Keep the free cluster bitmap up to date
+    if (fs->free_bitmap && cluster < fs->free_bitmap_clusters)
+    {
+        if (next_cluster)
+            FAT_BITMAP_SET(fs->free_bitmap, cluster);
+        else
+            FAT_BITMAP_CLEAR(fs->free_bitmap, cluster);
+    }
+#endif
+
     if (fs->fat_type == FAT_TYPE_16)
     {
         // Find 16 bit entry of current sector relating to cluster number
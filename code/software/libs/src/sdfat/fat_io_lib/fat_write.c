@@ -54,8 +54,17 @@ int fatfs_add_free_space(struct fatfs *fs, uint32 *startCluster, uint32 clusters
 
     for (i=0;i<clusters;i++)
     {
+        uint32 search = fs->next_free_cluster;
+
+#ifdef FAT_FREE_BITMAP_MAX
+        // The bitmap search wraps round, so it can start just past the
+        // end of the chain - keeping the file contiguous where possible
+        if (fs->free_bitmap)
+            search = start + 1;
+#endif
+
         // Start looking for free clusters from the beginning
-        if (fatfs_find_blank_cluster(fs, fs->next_free_cluster, &nextcluster))
+        if (fatfs_find_blank_cluster(fs, search, &nextcluster))
         {
             // Point last to this
             fatfs_fat_set_cluster(fs, start, nextcluster);
@@ -65,15 +74,17 @@ int fatfs_add_free_space(struct fatfs *fs, uint32 *startCluster, uint32 clusters
 
             // Adjust argument reference
             start = nextcluster;
-            if (i == 0) {
+            if (i == 0)
                 *startCluster = nextcluster;
-                fatfs_set_fs_info_next_free_cluster(fs, *startCluster);
-            }
         }
         else
             return 0;
     }
 
+    // Next search starts after the last cluster allocated
+    if (clusters)
+        fatfs_set_fs_info_next_free_cluster(fs, start);
+
     return 1;
 }
 //-----------------------------------------------------------------------------
@@ -343,7 +354,7 @@ int fatfs_add_file_entry(struct fatfs *fs, uint32 dirCluster, char *filename, ch
                         memcpy(&fs->currentsector.sector[recordoffset], &shortEntry, sizeof(shortEntry));
 
                         // Writeback
-                        return fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1);
+                        return fatfs_write_current_sector(fs);
                     }
 #if FATFS_INC_LFN_SUPPORT
                     else
@@ -361,7 +372,7 @@ int fatfs_add_file_entry(struct fatfs *fs, uint32 dirCluster, char *filename, ch
             // Write back to disk before loading another sector
             if (dirtySector)
             {
-                if (!fs->disk_io.write_media(fs->currentsector.address, fs->currentsector.sector, 1))
+                if (!fatfs_write_current_sector(fs))
                     return 0;
 
                 dirtySector = 0;
@@ -48,6 +48,27 @@ struct fat_buffer
     struct fat_buffer       *next;
 };
 
+// Directory / data sector cache entry
+struct sector_buffer
+{
+    uint8                   sector[FAT_SECTOR_SIZE];
+    uint32                  address;
+    int                     dirty;
+
+    // Next in chain of sector buffers (most recently used first)
+    struct sector_buffer    *next;
+};
+
+// Cache statistics
+struct fat_cache_stats
+{
+    uint32                  fat_hits;
+    uint32                  fat_misses;
+    uint32                  sector_hits;
+    uint32                  sector_misses;
+    uint32                  sector_writebacks;
+};
+
 typedef enum eFatType
 {
     FAT_TYPE_16,
@@ -66,7 +87,9 @@ struct fatfs
     uint16                  fs_info_sector;
     uint32                  lba_begin;
     uint32                  fat_sectors;
+    uint32                  cluster_count;
     uint32                  next_free_cluster;
+    int                     fs_info_dirty;
     uint16                  root_entry_count;
     uint16                  reserved_sectors;
     uint8                   num_of_fats;
@@ -85,6 +108,21 @@ struct fatfs
     // FAT Buffer
     struct fat_buffer        *fat_buffer_head;
     struct fat_buffer        fat_buffers[FAT_BUFFERS];
+
+#ifdef FAT_FREE_BITMAP_MAX
+    // Free cluster bitmap, a bit set for each cluster in use
+    uint32                   *free_bitmap;
+    uint32                   free_bitmap_clusters;
+#endif
+
+#ifdef FAT_SECTOR_CACHE_ENTRIES
+    // Directory / data sector cache (allocated at fl_init)
+    struct sector_buffer     *sector_cache_head;
+    struct sector_buffer     *sector_cache;
+    uint32                   sector_cache_entries;
+#endif
+
+    struct fat_cache_stats   cache_stats;
 };
 
 struct fs_dir_list_status
@@ -120,6 +158,11 @@ int     fatfs_sector_read(struct fatfs *fs, uint32 lba, uint8 *target, uint32 co
 int     fatfs_sector_write(struct fatfs *fs, uint32 lba, uint8 *target, uint32 count);
 int     fatfs_read_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *target);
 int     fatfs_write_sector(struct fatfs *fs, uint32 cluster, uint32 sector, uint8 *target);
+int     fatfs_read_current_sector(struct fatfs *fs, uint32 lba);
+int     fatfs_write_current_sector(struct fatfs *fs);
+int     fatfs_sector_cache_alloc(struct fatfs *fs, uint32 entries);
+void    fatfs_sector_cache_reset(struct fatfs *fs);
+int     fatfs_sector_cache_flush(struct fatfs *fs);
 void    fatfs_show_details(struct fatfs *fs);
 uint32  fatfs_get_root_cluster(struct fatfs *fs);
 uint32  fatfs_get_file_entry(struct fatfs *fs, uint32 Cluster, char *nametofind, STRUCT_PACKED_VOLATILE struct fat_dir_entry *sfEntry);
@@ -9,5 +9,7 @@
 int fatfs_cache_init(struct fatfs *fs, FL_FILE *file);
 int fatfs_cache_get_next_cluster(struct fatfs *fs, FL_FILE *file, uint32 clusterIdx, uint32 *pNextCluster);
 int fatfs_cache_set_next_cluster(struct fatfs *fs, FL_FILE *file, uint32 clusterIdx, uint32 nextCluster);
+int fatfs_cache_get_extent(struct fatfs *fs, FL_FILE *file, uint32 clusterIdx, uint32 want, uint32 *pCluster, uint32 *pRun);
+int fatfs_cache_chain_extended(struct fatfs *fs, FL_FILE *file);
 
 #endif
@@ -27,4 +27,7 @@
 // Lower-level but standard options
 #define FAT_BUFFER_SECTORS              8
 #define FAT_BUFFERS                     4       /* 16KB */
+#define FAT_SECTOR_CACHE_ENTRIES        16      /* 8KB, from the heap */
+#define FAT_FREE_BITMAP_MAX             (128 * 1024)    /* Up to 1M clusters */
 #define FAT_CLUSTER_CACHE_ENTRIES       128     /* 1KB */
+#define FAT_EXTENT_MAP_ENTRIES          16      /* 192B */
@@ -35,6 +35,13 @@ struct cluster_lookup
     uint32 CurrentCluster;
 };
 
+struct cluster_extent
+{
+    uint32 ClusterIdx;
+    uint32 Cluster;
+    uint32 Length;
+};
+
 typedef struct sFL_FILE
 {
     uint32                  parentcluster;
@@ -51,6 +58,12 @@ typedef struct sFL_FILE
     uint32                  cluster_cache_data[FAT_CLUSTER_CACHE_ENTRIES];
 #endif
 
+#ifdef FAT_EXTENT_MAP_ENTRIES
+    struct cluster_extent   extents[FAT_EXTENT_MAP_ENTRIES];
+    uint32                  extent_count;
+    int                     extent_complete;
+#endif
+
     // Cluster Lookup
     struct cluster_lookup   last_fat_lookup;
 
@@ -112,6 +125,8 @@ int                 fl_is_dir(const char *path);
 
 int                 fl_format(uint32 volume_sectors, const char *name);
 
+void                fl_get_cache_stats(struct fat_cache_stats *stats);
+
 // Test hooks
 #ifdef FATFS_INC_TEST_HOOKS
 struct fatfs*       fl_get_fs(void);
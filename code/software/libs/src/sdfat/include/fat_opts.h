@@ -35,11 +35,25 @@
     #define FAT_BUFFERS                     1
 #endif
 
+// Directory / data sectors to cache, allocated at fl_init (can be undefined)
+// Mem used = FAT_SECTOR_CACHE_ENTRIES * (FAT_SECTOR_SIZE + 12)
+//#define FAT_SECTOR_CACHE_ENTRIES          16
+
+// Most heap to use for a free cluster bitmap, built on the first
+// allocation (can be undefined - free clusters are then found by
+// scanning the FAT)
+//#define FAT_FREE_BITMAP_MAX               (128 * 1024)
+
 // Size of cluster chain cache (can be undefined)
 // Mem used = FAT_CLUSTER_CACHE_ENTRIES * 4 * 2
 // Improves access speed considerably
 //#define FAT_CLUSTER_CACHE_ENTRIES         128
 
+// Size of per file extent map (can be undefined)
+// Mem used = FAT_EXTENT_MAP_ENTRIES * 4 * 3
+// Lets reads across contiguous clusters go to the media in one go
+//#define FAT_EXTENT_MAP_ENTRIES            16
+
 // Include support for writing files (1 / 0)?
 #ifndef FATFS_INC_WRITE_SUPPORT
     #define FATFS_INC_WRITE_SUPPORT         1
@@ -207,6 +207,19 @@ bool SD_read_block(SDCard *sd, uint32_t block, void *buf);
  */
 bool SD_write_block(SDCard *sd, uint32_t block, void *buf);
 
+/**
+ * Attempt to read consecutive blocks from the SD card, with a single
+ * command. Fails (without reading anything) if the firmware doesn't
+ * support it - check with a count of zero.
+ */
+bool SD_read_blocks(SDCard *sd, uint32_t block, uint32_t count, void *buf);
+
+/**
+ * Attempt to write consecutive blocks to the SD card, with a single
+ * command. Fails if the firmware doesn't support it, as above.
+ */
+bool SD_write_blocks(SDCard *sd, uint32_t block, uint32_t count, void *buf);
+
 /**
  * Attempt to read an SD card register into the supplied buffer.
  */
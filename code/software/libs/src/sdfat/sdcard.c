@@ -47,8 +47,13 @@ uint32_t SD_get_size(SDCard *sd) {
 }
 
 static SDCard sdcard;
+static bool have_multi_block;
 
 static int FAT_media_read(uint32_t sector, uint8_t *buffer, uint32_t sector_count) {
+    if (sector_count > 1 && have_multi_block) {
+        return SD_read_blocks(&sdcard, sector, sector_count, buffer) ? 1 : 0;
+    }
+
     for(int i = 0; i < sector_count; i++) {
         if (!SD_read_block(&sdcard, sector + i, buffer)) {
             return 0;
@@ -60,6 +65,10 @@ static int FAT_media_read(uint32_t sector, uint8_t *buffer, uint32_t sector_coun
 }
 
 static int FAT_media_write(uint32_t sector, uint8_t *buffer, uint32_t sector_count) {
+    if (sector_count > 1 && have_multi_block) {
+        return SD_write_blocks(&sdcard, sector, sector_count, buffer) ? 1 : 0;
+    }
+
     for(int i = 0; i < sector_count; i++) {
         if (!SD_write_block(&sdcard, sector + i, buffer)) {
             return 0;
@@ -76,6 +85,10 @@ bool SD_FAT_initialize() {
         return false;
     }
 
+    // Reading zero blocks succeeds only if the firmware has multi-block
+    // transfers - older firmware can only do one block at a time
+    have_multi_block = SD_read_blocks(&sdcard, 0, 0, NULL);
+
     if (fl_attach_media(FAT_media_read, FAT_media_write) != FAT_INIT_OK) {
         return false;
     } else {  
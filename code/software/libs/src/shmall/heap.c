@@ -28,17 +28,90 @@
 static const uint overhead = sizeof(footer_t) + sizeof(node_t);
 static const uint offset = 8;
 
+#if defined(__mc68020__)
+// Bit offset of the first set bit, counting from the MSB (32 if none)
+static inline uint msb_offset(uint32_t v) {
+    uint offset;
+
+    __asm__ (
+        "bfffo  %1{#0:#0},%0\n\t"     // Width 0 is all 32 bits
+        : "=d"(offset)
+        : "d"(v)
+        : "cc"
+    );
+
+    return offset;
+}
+#else
+static const unsigned char nibble_offset[16] = {
+    4, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// Bit offset of the first set bit, counting from the MSB (32 if none)
+static uint msb_offset(uint32_t v) {
+    uint offset = 0;
+
+    if ((v & 0xffff0000) == 0) {
+        offset += 16;
+        v <<= 16;
+    }
+    if ((v & 0xff000000) == 0) {
+        offset += 8;
+        v <<= 8;
+    }
+    if ((v & 0xf0000000) == 0) {
+        offset += 4;
+        v <<= 4;
+    }
+
+    return offset + nibble_offset[v >> 28];
+}
+#endif
+
 static uint get_bin_index(size_t sz) {
-    uint index = 0;
-    sz = sz < 4 ? 4 : sz;
+    sz = sz < MIN_ALLOC_SZ ? MIN_ALLOC_SZ : sz;
 
-    while (sz >>= 1) index++; 
-    index -= 2; 
-    
-    if (index > BIN_MAX_IDX) index = BIN_MAX_IDX; 
+    // Power of two, and which half of it
+    uint log = 31 - msb_offset(sz);
+    uint index = ((log - 2) << 1) | ((sz >> (log - 1)) & 1);
+
+    if (index > BIN_MAX_IDX) index = BIN_MAX_IDX;
     return index;
 }
 
+// First non-empty bin after `index`, or BIN_COUNT if there isn't one
+static uint next_bin_index(heap_t *heap, uint index) {
+    if (index >= BIN_MAX_IDX) {
+        return BIN_COUNT;
+    }
+
+    uint32_t above = heap->bin_map << (index + 1);
+
+    if (above == 0) {
+        return BIN_COUNT;
+    }
+
+    return index + 1 + msb_offset(above);
+}
+
+static void bin_add(heap_t *heap, node_t *node) {
+    uint index = get_bin_index(node->size);
+
+    add_node(heap->bins[index], node);
+    heap->bin_map |= 0x80000000 >> index;
+}
+
+static void bin_remove(heap_t *heap, node_t *node) {
+    uint index = get_bin_index(node->size);
+    bin_t *bin = heap->bins[index];
+
+    remove_node(bin, node);
+
+    if (bin->head == NULL) {
+        heap->bin_map &= ~(0x80000000 >> index);
+    }
+}
+
 static footer_t *get_foot(node_t *node) {
     return (footer_t *) ((char *) node + sizeof(node_t) + node->size);
 }
@@ -55,30 +128,61 @@ void init_heap(heap_t *heap, long start, long size) {
 
     create_foot(init_region);
 
-    add_node(heap->bins[get_bin_index(init_region->size)], init_region);
+    heap->bin_map = 0;
+    bin_add(heap, init_region);
+
+    for (int i = 0; i < CACHE_CLASSES; i++) {
+        heap->cache[i] = NULL;
+    }
 
     heap->start = (long) start;
     heap->end   = (long) (start + size);
 }
 
+static int cache_drain(heap_t *heap);
+
 void *heap_alloc(heap_t *heap, size_t size) {
+    if (size <= CACHE_MAX_SZ) {
+        uint cls = size <= 8 ? 1 : (size + 7) >> 3;
+        node_t *cached = heap->cache[cls - 1];
+
+        if (cached != NULL) {
+            heap->cache[cls - 1] = cached->next;
+
+            cached->next = NULL;
+            return &cached->next;
+        }
+
+        // Whole class, so it can go back in the cache when freed
+        size = cls << 3;
+    }
+
     // Round up odd sizes...
     if ((size & 1) == 1) {
         size += 1;
     }
 
     uint index = get_bin_index(size);
-    bin_t *temp = (bin_t *) heap->bins[index];
-    node_t *found = get_best_fit(temp, size);
+    node_t *found = get_best_fit(heap->bins[index], size);
+
+    if (found == NULL) {
+        // Anything in a later bin is big enough, so take the first
+        index = next_bin_index(heap, index);
+
+        if (index >= BIN_COUNT) {
+            // Maybe the cache is holding on to what we need...
+            if (cache_drain(heap)) {
+                return heap_alloc(heap, size);
+            }
 
-    while (found == NULL) {
-        if (index + 1 >= BIN_COUNT)
             return NULL;
+        }
 
-        temp = heap->bins[++index];
-        found = get_best_fit(temp, size);
+        found = heap->bins[index]->head;
     }
 
+    bin_remove(heap, found);
+
     if ((found->size - size) > (overhead + MIN_ALLOC_SZ)) {
         node_t *split = (node_t *) (((char *) found + sizeof(node_t) + sizeof(footer_t)) + size);
         split->size = found->size - size - sizeof(node_t) - sizeof(footer_t);
@@ -86,30 +190,25 @@ void *heap_alloc(heap_t *heap, size_t size) {
    
         create_foot(split);
 
-        uint new_idx = get_bin_index(split->size);
-
-        add_node(heap->bins[new_idx], split); 
+        bin_add(heap, split);
 
         found->size = size; 
         create_foot(found); 
     }
 
     found->hole = 0; 
-    remove_node(heap->bins[index], found); 
     
     found->prev = NULL;
     found->next = NULL;
     return &found->next; 
 }
 
-void heap_free(heap_t *heap, void *p) {
-    bin_t *list;
+static void free_block(heap_t *heap, node_t *head) {
     footer_t *new_foot, *old_foot;
 
-    node_t *head = get_head(p);
     if (head == (node_t *) (uintptr_t) heap->start) {
         head->hole = 1; 
-        add_node(heap->bins[get_bin_index(head->size)], head);
+        bin_add(heap, head);
         return;
     }
 
@@ -118,8 +217,7 @@ void heap_free(heap_t *heap, void *p) {
     node_t *prev = f->header;
     
     if (prev->hole) {
-        list = heap->bins[get_bin_index(prev->size)];
-        remove_node(list, prev);
+        bin_remove(heap, prev);
 
         prev->size += overhead + head->size;
         new_foot = get_foot(head);
@@ -128,9 +226,8 @@ void heap_free(heap_t *heap, void *p) {
         head = prev;
     }
 
-    if (next->hole) {
-        list = heap->bins[get_bin_index(next->size)];
-        remove_node(list, next);
+    if ((long) next < heap->end && next->hole) {
+        bin_remove(heap, next);
 
         head->size += overhead + next->size;
 
@@ -144,7 +241,85 @@ void heap_free(heap_t *heap, void *p) {
     }
 
     head->hole = 1;
-    add_node(heap->bins[get_bin_index(head->size)], head);
+    bin_add(heap, head);
+}
+
+// Really free everything in the cache, returning true if there was any
+static int cache_drain(heap_t *heap) {
+    int drained = 0;
+
+    for (int i = 0; i < CACHE_CLASSES; i++) {
+        while (heap->cache[i] != NULL) {
+            node_t *head = heap->cache[i];
+            heap->cache[i] = head->next;
+
+            free_block(heap, head);
+            drained = 1;
+        }
+    }
+
+    return drained;
+}
+
+void heap_free(heap_t *heap, void *p) {
+    node_t *head = get_head(p);
+    uint cls = head->size >> 3;
+
+    // Small blocks stay allocated, but go in the cache. Every block
+    // in a class is at least that class's size.
+    if (cls > 0 && cls <= CACHE_CLASSES) {
+        head->next = heap->cache[cls - 1];
+        heap->cache[cls - 1] = head;
+        return;
+    }
+
+    free_block(heap, head);
+}
+
+void *heap_realloc(heap_t *heap, void *p, size_t size) {
+    // Round up odd sizes...
+    if ((size & 1) == 1) {
+        size += 1;
+    }
+
+    node_t *head = get_head(p);
+    node_t *next = (node_t *) ((char *) get_foot(head) + sizeof(footer_t));
+    uint avail = head->size;
+    int absorb = (long) next < heap->end && next->hole;
+
+    if (absorb) {
+        avail += overhead + next->size;
+    }
+
+    if (size > avail) {
+        return NULL;
+    }
+
+    if (absorb) {
+        bin_remove(heap, next);
+    }
+
+    if ((avail - size) > (overhead + MIN_ALLOC_SZ)) {
+        head->size = size;
+        create_foot(head);
+
+        // Whatever's left (including any hole we took) is a new hole
+        node_t *split = (node_t *) ((char *) get_foot(head) + sizeof(footer_t));
+        split->size = avail - size - overhead;
+        split->hole = 1;
+
+        create_foot(split);
+        bin_add(heap, split);
+    } else {
+        head->size = avail;
+        create_foot(head);
+    }
+
+    return p;
+}
+
+int heap_contains(heap_t *heap, void *p) {
+    return (long) p >= heap->start && (long) p < heap->end;
 }
 
 node_t *get_head(void *p) {
@@ -33,9 +33,17 @@
 #define MIN_WILDERNESS 0x2000
 #define MAX_WILDERNESS 0x1000000
 
-#define BIN_COUNT 9
+// Two bins per power of two from MIN_ALLOC_SZ, the last taking
+// everything from 192KB up. There must be at most 32, one for
+// each bit of `bin_map`.
+#define BIN_COUNT 32
 #define BIN_MAX_IDX (BIN_COUNT - 1)
 
+// Blocks of up to CACHE_MAX_SZ are kept on a free list for their
+// size (in 8-byte classes) when freed, and reused from there
+#define CACHE_MAX_SZ 64
+#define CACHE_CLASSES (CACHE_MAX_SZ >> 3)
+
 typedef unsigned int uint;
 
 typedef struct node_t {
@@ -56,7 +64,9 @@ typedef struct {
 typedef struct {
     long start;
     long end;
+    uint32_t bin_map;           // Non-empty bins, bin 0 in the MSB
     bin_t *bins[BIN_COUNT];
+    node_t *cache[CACHE_CLASSES];
 } heap_t;
 
 void init_heap(heap_t *heap, long start, long size);
@@ -64,6 +74,20 @@ void init_heap(heap_t *heap, long start, long size);
 void *heap_alloc(heap_t *heap, size_t size);
 void heap_free(heap_t *heap, void *p);
 
+/*
+ * Resize an allocated block in place - shrinking it splits off
+ * the end as a new hole, growing it takes in the following block
+ * if that's a hole. Returns `p`, or NULL (with the block left as
+ * it was) if it can't be resized without moving it.
+ */
+void *heap_realloc(heap_t *heap, void *p, size_t size);
+
+/*
+ * Returns true if `p` is within the memory `heap` manages (i.e.
+ * it could only have come from that heap).
+ */
+int heap_contains(heap_t *heap, void *p);
+
 /*
  * Allows you to switch out the default heap for one of your 
  * choosing. Note that the supplied `heap_t` must be initialized
@@ -77,6 +101,29 @@ void rh_switch_heap(heap_t *heap);
  */
 void rh_default_heap();
 
+/*
+ * With the ROM kernel, create a heap of (at least) `size` bytes,
+ * from kernel pages, for the current task - from then on malloc,
+ * free etc. in that task use it, without locking. Blocks go back
+ * to whichever heap they came from (found by address), so any task
+ * can free them - when another task frees one, it's handed back to
+ * the owner, and really freed at the owner's next malloc / free.
+ *
+ * Without one, all tasks share the default heap (with interrupts
+ * disabled while it's in use).
+ *
+ * Returns the heap, or NULL if there's no kernel, the task has
+ * a heap already, or there isn't the memory.
+ */
+heap_t *rh_task_heap_create(size_t size);
+
+/*
+ * Give a task's heap (and everything still allocated from it)
+ * back to the kernel. Call this before the task exits - nothing
+ * allocated from the heap may be used (or freed) after this.
+ */
+void rh_task_heap_destroy();
+
 /*
  * Get the header of a block
  */
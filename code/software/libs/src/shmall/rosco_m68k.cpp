@@ -18,6 +18,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <kernelapi.h>
 #include "heap.h"
 
 #define DEFAULT_STACK_SIZE  ((32 << 10)) // Default to 32KB stack
@@ -39,6 +40,21 @@ extern uint32_t _end;
 static bin_t bins[BIN_COUNT];
 static heap_t __ROSCO_DEFAULT_HEAP;
 static heap_t *current_heap;
+static IKernel *kernel;             // NULL without the ROM kernel
+
+// A task's own heap, at the start of the kernel pages it lives in
+typedef struct task_heap {
+    heap_t heap;
+    bin_t bins[BIN_COUNT];
+    uintptr_t base;
+    size_t size;
+    node_t * volatile remote_free;  // Blocks freed by other tasks
+    struct task_heap *next;         // Next in task_heaps
+} task_heap_t;
+
+// All the task heaps, so a block can be given back to the one it came
+// from whichever task frees it (only changed with interrupts disabled)
+static task_heap_t *task_heaps;
 
 static void init_malloc_with_stacksize(uint32_t stacksize) {
     uint32_t heapstart = ((uint32_t)&_end);
@@ -55,6 +71,140 @@ static void init_malloc_with_stacksize(uint32_t stacksize) {
 __attribute__((constructor)) void __init_default_heap() {
     init_malloc_with_stacksize(DEFAULT_STACK_SIZE);
     current_heap = &__ROSCO_DEFAULT_HEAP;
+    kernel = get_kernel_api();
+}
+
+// The running task, or NULL if there's no kernel (or it isn't multitasking yet)
+static inline Task *current_task() {
+    return kernel != NULL ? kernel->task_current() : NULL;
+}
+
+// The task heap `p` came from, or NULL if it's from the shared one.
+// Call with interrupts disabled if there are tasks.
+static task_heap_t *find_task_heap(void *p) {
+    for (task_heap_t *task_heap = task_heaps; task_heap != NULL; task_heap = task_heap->next) {
+        if (heap_contains(&task_heap->heap, p)) {
+            return task_heap;
+        }
+    }
+
+    return NULL;
+}
+
+// Hand a block back to the task whose heap it's from, to be freed
+// next time that task uses it. Call with interrupts disabled.
+static void remote_free(task_heap_t *owner, void *p) {
+    node_t *head = get_head(p);
+
+    head->next = owner->remote_free;
+    owner->remote_free = head;
+}
+
+// Really free the blocks other tasks have handed back to the running
+// task's own heap
+static void drain_remote_free(task_heap_t *task_heap) {
+    if (task_heap->remote_free == NULL) {
+        return;
+    }
+
+    kernel->disable_interrupts();
+    node_t *head = task_heap->remote_free;
+    task_heap->remote_free = NULL;
+    kernel->enable_interrupts();
+
+    while (head != NULL) {
+        node_t *next = head->next;
+        heap_free(&task_heap->heap, &head->next);
+        head = next;
+    }
+}
+
+// Get the heap the task should use - if that's the shared one, and
+// there are other tasks, it's locked until unlock_heap.
+static inline heap_t *lock_heap(Task *task) {
+    if (task != NULL) {
+        if (task->user_data != NULL) {
+            task_heap_t *task_heap = (task_heap_t *) task->user_data;
+            drain_remote_free(task_heap);
+            return &task_heap->heap;
+        }
+
+        kernel->disable_interrupts();
+    }
+
+    return current_heap;
+}
+
+static inline void unlock_heap(Task *task) {
+    if (task != NULL && task->user_data == NULL) {
+        kernel->enable_interrupts();
+    }
+}
+
+// Is `p` from `heap` (as returned by lock_heap, and still locked)?
+static inline bool heap_owns(Task *task, heap_t *heap, void *p) {
+    if (task != NULL && task->user_data != NULL) {
+        return heap_contains(heap, p);
+    }
+
+    // Task heaps can be in pages within the shared heap's range, so
+    // it's only the shared heap's if it isn't from one of them
+    return find_task_heap(p) == NULL;
+}
+
+heap_t *rh_task_heap_create(size_t size) {
+    Task *task = current_task();
+
+    if (task == NULL || task->user_data != NULL || size <= sizeof(task_heap_t) + CACHE_MAX_SZ) {
+        return NULL;
+    }
+
+    uintptr_t base = kernel->mem_alloc(size);
+
+    if (base == 0) {
+        return NULL;
+    }
+
+    task_heap_t *task_heap = (task_heap_t *) base;
+    task_heap->base = base;
+    task_heap->size = size;
+    task_heap->remote_free = NULL;
+
+    for (int i = 0; i < BIN_COUNT; i++) {
+        task_heap->bins[i].head = 0;
+        task_heap->heap.bins[i] = &task_heap->bins[i];
+    }
+
+    init_heap(&task_heap->heap, base + sizeof(task_heap_t), size - sizeof(task_heap_t));
+
+    kernel->disable_interrupts();
+    task_heap->next = task_heaps;
+    task_heaps = task_heap;
+    kernel->enable_interrupts();
+
+    task->user_data = task_heap;
+    return &task_heap->heap;
+}
+
+void rh_task_heap_destroy() {
+    Task *task = current_task();
+
+    if (task == NULL || task->user_data == NULL) {
+        return;
+    }
+
+    task_heap_t *task_heap = (task_heap_t *) task->user_data;
+    task->user_data = NULL;
+
+    kernel->disable_interrupts();
+    task_heap_t **link = &task_heaps;
+    while (*link != task_heap) {
+        link = &(*link)->next;
+    }
+    *link = task_heap->next;
+    kernel->enable_interrupts();
+
+    kernel->mem_free(task_heap->base, task_heap->size);
 }
 
 void rh_switch_heap(heap_t *heap) {
@@ -66,12 +216,45 @@ void rh_default_heap() {
 }
 
 void* malloc(size_t size) {
-    return heap_alloc(current_heap, size);
+    Task *task = current_task();
+    heap_t *heap = lock_heap(task);
+
+    void *ptr = heap_alloc(heap, size);
+
+    unlock_heap(task);
+    return ptr;
 }
 
 void free(void* ptr) {
     if (ptr) {
-        heap_free(current_heap, ptr);
+        Task *task = current_task();
+        task_heap_t *own = task != NULL ? (task_heap_t *) task->user_data : NULL;
+
+        // Blocks go back to the heap they came from, which needs no
+        // locking if it's this task's own...
+        if (own != NULL && heap_contains(&own->heap, ptr)) {
+            drain_remote_free(own);
+            heap_free(&own->heap, ptr);
+            return;
+        }
+
+        // ... otherwise it's another task's (which frees it later, as
+        // it uses its heap without locking) or the shared one
+        if (task != NULL) {
+            kernel->disable_interrupts();
+        }
+
+        task_heap_t *owner = find_task_heap(ptr);
+
+        if (owner != NULL) {
+            remote_free(owner, ptr);
+        } else {
+            heap_free(current_heap, ptr);
+        }
+
+        if (task != NULL) {
+            kernel->enable_interrupts();
+        }
     }
 }
 
@@ -184,9 +367,30 @@ void* calloc(size_t num, size_t size) {
 }
 
 void* realloc(void *ptr, size_t new_size) {
-    void *new_ptr = malloc(new_size);
+    if (ptr == NULL) {
+        return malloc(new_size);
+    }
+
+    // Only copy if it can't be resized where it is (which it can only
+    // be here if it's from the heap this task uses)
+    Task *task = current_task();
+    heap_t *heap = lock_heap(task);
+
+    void *new_ptr = NULL;
+
+    if (heap_owns(task, heap, ptr)) {
+        new_ptr = heap_realloc(heap, ptr, new_size);
+    }
+
+    unlock_heap(task);
+
+    if (new_ptr != NULL) {
+        return new_ptr;
+    }
+
+    new_ptr = malloc(new_size);
 
-    if (ptr != NULL && new_ptr != NULL && new_size > 0) {
+    if (new_ptr != NULL) {
         node_t *old_node = get_head(ptr);
         size_t old_size = old_node->size;
         size_t copy_size = old_size < new_size ? old_size : new_size;
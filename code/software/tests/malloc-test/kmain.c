@@ -132,6 +132,134 @@ void realloc_benchmark(size_t size) {
     }
 }
 
+#define GROW_BLOCKERS   32
+
+void realloc_grow_benchmark(size_t max_size, size_t step) {
+    printf("realloc grow benchmark : starting\n");
+    bool success = true;
+    unsigned char *current_ptr = NULL;
+    size_t current_size = 0;
+    size_t copied = 0;
+    unsigned moves = 0;
+    void *blockers[GROW_BLOCKERS];
+    unsigned blocker_count = 0;
+    unsigned start_ticks = _TIMER_100HZ;
+
+    // Grow a buffer a bit at a time (like a string being appended
+    // to), then shrink it again, with something else allocated
+    // now and then to get in the way
+    for (size_t size = step; size <= max_size && success; size += step) {
+        unsigned char *new_ptr = realloc(current_ptr, size);
+        if (!new_ptr) {
+            printf("realloc grow benchmark : failed to realloc(%p, 0x%zX)\n", current_ptr, size);
+            success = false;
+            break;
+        }
+
+        if (current_ptr && new_ptr != current_ptr) {
+            copied += current_size;
+            moves++;
+        }
+
+        current_ptr = new_ptr;
+        current_size = size;
+
+        if ((size / step) % 64 == 0 && blocker_count < GROW_BLOCKERS) {
+            blockers[blocker_count++] = malloc(16);
+        }
+    }
+
+    for (size_t size = current_size; size >= step && success; size -= step) {
+        unsigned char *new_ptr = realloc(current_ptr, size);
+        if (!new_ptr) {
+            printf("realloc grow benchmark : failed to realloc(%p, 0x%zX)\n", current_ptr, size);
+            success = false;
+            break;
+        }
+
+        if (new_ptr != current_ptr) {
+            copied += size;
+            moves++;
+        }
+
+        current_ptr = new_ptr;
+        current_size = size;
+    }
+    free(current_ptr);
+
+    for (unsigned i = 0; i < blocker_count; ++i) {
+        free(blockers[i]);
+    }
+
+    unsigned end_ticks = _TIMER_100HZ;
+    if (success) {
+        printf("realloc grow benchmark : took %u ticks, %u moves, 0x%zX bytes copied\n",
+                end_ticks - start_ticks, moves, copied);
+    }
+}
+
+#define END_HEAP_SIZE   0x400
+#define END_BLOCK_SIZE  0x80
+
+// A heap of its own, with room after it for something that looks like a hole
+static uint32_t end_heap_mem[(END_HEAP_SIZE + 0x80) / sizeof(uint32_t)];
+static bin_t end_heap_bins[BIN_COUNT];
+
+void heap_end_check() {
+    printf("heap end check         : starting\n");
+    long end = (long) end_heap_mem + END_HEAP_SIZE;
+    size_t overhead = sizeof(node_t) + sizeof(footer_t);
+    heap_t heap;
+    bool success = true;
+
+    for (int i = 0; i < BIN_COUNT; i++) {
+        end_heap_bins[i].head = NULL;
+        heap.bins[i] = &end_heap_bins[i];
+    }
+
+    init_heap(&heap, (long) end_heap_mem, END_HEAP_SIZE);
+
+    // Freeing the last block must not merge it with whatever's after
+    // the heap, even if it looks like a hole
+    node_t *beyond = (node_t *) end;
+    beyond->hole = 1;
+    beyond->size = 0x40;
+    beyond->next = NULL;
+    beyond->prev = NULL;
+
+    // One block, then one with the rest, so it ends right at the end
+    char *first = heap_alloc(&heap, END_BLOCK_SIZE);
+    char *last = heap_alloc(&heap, END_HEAP_SIZE - 2 * overhead - END_BLOCK_SIZE);
+
+    if (!first || !last) {
+        printf("heap end check         : failed to fill heap\n");
+        success = false;
+    } else {
+        heap_free(&heap, last);
+
+        // Everything allocated now must be within the heap
+        unsigned count = 0;
+        char *block;
+        while ((block = heap_alloc(&heap, END_BLOCK_SIZE)) != NULL) {
+            if ((long) block + END_BLOCK_SIZE > end) {
+                printf("heap end check         : block %p is past the end of the heap\n", block);
+                success = false;
+                break;
+            }
+            count++;
+        }
+
+        if (success && count == 0) {
+            printf("heap end check         : failed to heap_alloc(0x%X) after free\n", END_BLOCK_SIZE);
+            success = false;
+        }
+    }
+
+    if (success) {
+        printf("heap end check         : succeeded\n");
+    }
+}
+
 void kmain() {
     printf("C++ new/delete test starting\n");
     
@@ -152,6 +280,9 @@ void kmain() {
     size_t realloc_size = 0x40000;
     realloc_check(realloc_size);
     realloc_benchmark(realloc_size);
+    realloc_grow_benchmark(0x10000, 0x20);
+
+    heap_end_check();
 
     printf("Malloc stress test starting, will run until interrupted...\n");
     uint32_t allocs = 0;
@@ -0,0 +1,187 @@
+/*
+ * vim: set et ts=4 sw=4
+ *------------------------------------------------------------
+ *                                  ___ ___ _
+ *  ___ ___ ___ ___ ___       _____|  _| . | |_
+ * |  _| . |_ -|  _| . |     |     | . | . | '_|
+ * |_| |___|___|___|___|_____|_|_|_|___|___|_,_|
+ *                     |_____|
+ * ------------------------------------------------------------
+ * Copyright (c)2023 Ross Bamford and contributors
+ * See top-level LICENSE.md for licence information.
+ *
+ * Test of per-task heaps - blocks freed by a task other than
+ * the one that allocated them, and blocks from the shared
+ * heap freed by a task with its own
+ * ------------------------------------------------------------
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdnoreturn.h>
+#include <heap.h>
+#include <machine.h>
+#include <kernelapi.h>
+
+#define SYS_STACK_SIZE      0x800
+#define USER_STACK_SIZE     0x1000
+
+#define PMM_SIZE            0x40000
+#define TASK_HEAP_SIZE      0x10000
+
+// Enough blocks, of enough sizes, to fill most of the task heap
+#define BLOCK_COUNT         96
+
+// Only fits once everything the other task freed is back, and joined up
+#define BIG_SIZE            (TASK_HEAP_SIZE - 0x1000)
+
+#define SIG_BLOCKS_READY    0x01
+#define SIG_BLOCKS_FREED    0x02
+
+#define syncprintf(...)                     \
+    do {                                    \
+        Kernel->disable_interrupts();       \
+        printf(__VA_ARGS__);                \
+        Kernel->enable_interrupts();        \
+    } while (0)
+
+static IKernel *Kernel;
+
+static uint32_t tinit_stack;
+static uint32_t tidle_stack;
+
+static Task *owner;
+static uint32_t owner_stack;
+static Task *freer;
+static uint32_t freer_stack;
+
+static void *shared_block;              // From the shared heap, before the tasks start
+static heap_t *owner_heap;
+static void *blocks[BLOCK_COUNT];       // From the owner's heap, freed by the other task
+static volatile bool done;
+
+static void check(const char *what, bool ok) {
+    syncprintf("%-38s: %s\n", what, ok ? "succeeded" : "FAILED");
+}
+
+// Has its own heap - allocates blocks for the other task to free
+static void owner_task(void) {
+    void *early = malloc(40);
+    heap_t *heap = owner_heap = rh_task_heap_create(TASK_HEAP_SIZE);
+
+    check("create task heap", heap != NULL);
+
+    if (heap == NULL) {
+        done = true;
+        return;
+    }
+
+    bool all_in_heap = true;
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        // Mix of sizes, so some go through the small block cache
+        blocks[i] = malloc(i & 1 ? 16 + (i & 0x30) : 200 + 16 * i);
+        all_in_heap = all_in_heap && blocks[i] != NULL && heap_contains(heap, blocks[i]);
+    }
+    check("allocate from task heap", all_in_heap);
+
+    // Shared heap blocks freed by a task with its own heap go back
+    // to the shared heap, whether from before it had one or not
+    free(early);
+    free(shared_block);
+    shared_block = NULL;
+
+    Kernel->task_signal(freer, SIG_BLOCKS_READY);
+    Kernel->task_wait(SIG_BLOCKS_FREED);
+
+    void *big = malloc(BIG_SIZE);
+    check("allocate after other task freed", big != NULL && heap_contains(heap, big));
+    free(big);
+
+    big = realloc(malloc(32), BIG_SIZE);
+    check("realloc after other task freed", big != NULL && heap_contains(heap, big));
+    free(big);
+
+    rh_task_heap_destroy();
+    done = true;
+}
+
+// Shares the default heap - frees the owner's blocks
+static void freer_task(void) {
+    Kernel->task_wait(SIG_BLOCKS_READY);
+
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        free(blocks[i]);
+    }
+
+    // The shared heap should still be fine after what the owner freed
+    void *shared = malloc(0x2000);
+    check("allocate from shared heap", shared != NULL && !heap_contains(owner_heap, shared));
+    free(shared);
+
+    Kernel->task_signal(owner, SIG_BLOCKS_FREED);
+}
+
+static void idle(void) {
+    while (!done) {
+        __asm__ volatile (
+            "stop   #0x2000\n\t"
+        );
+    }
+
+    syncprintf("Task heap test done\n");
+
+    __asm__ volatile (
+        "stop   #0x2700\n\t"
+    );
+}
+
+static void init(void) {
+    Kernel->task_schedule(owner, owner_stack, USER_STACK_SIZE, owner_task);
+    Kernel->task_schedule(freer, freer_stack, USER_STACK_SIZE, freer_task);
+}
+
+// Give the PMM some memory to work with - from the shared heap, so
+// the task heaps don't end up on top of it
+static void init_pmm() {
+    uint32_t free_start = (uint32_t) malloc(PMM_SIZE + 0x400);
+
+    if (free_start == 0) {
+        printf("Out of memory\n");
+        abort();
+    }
+
+    Kernel->mem_free((free_start + 0x3ff) & 0xfffffc00, PMM_SIZE);
+}
+
+static Task *new_task(uint32_t *stack, tid_t tid) {
+    Task *task = (Task*)Kernel->alloc_sys_object(TASK_SLAB_BLOCKS);
+    *stack = Kernel->mem_alloc(USER_STACK_SIZE);
+
+    if (task == NULL || *stack == 0) {
+        printf("Failed to allocate memory for task %ld\n", tid);
+        mcHalt();
+    }
+
+    Kernel->task_init(task, tid, 0x02);
+    return task;
+}
+
+noreturn void kmain() {
+    Kernel = get_kernel_api();
+
+    printf("Task heap test starting\n");
+
+    init_pmm();
+
+    shared_block = malloc(100);
+
+    tinit_stack = Kernel->mem_alloc(SYS_STACK_SIZE);
+    tidle_stack = Kernel->mem_alloc(SYS_STACK_SIZE);
+    owner = new_task(&owner_stack, 0x01);
+    freer = new_task(&freer_stack, 0x02);
+
+    Kernel->start(tinit_stack, SYS_STACK_SIZE, init, tidle_stack, SYS_STACK_SIZE, idle);
+    __builtin_unreachable();
+}
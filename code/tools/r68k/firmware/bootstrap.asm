@@ -83,6 +83,7 @@ START::
     move.l  #XL_EXIT,4                  
     
     bsr.w   INITSDB                     ; Initialise System Data Block
+    bsr.w   INITDUART                   ; Use the DUART timer for the tick, if there is one
     bsr.w   INITEFPT                    ; Initialise Extension Function Pointer Table
     bsr.w   INITDEVS                    ; Initialise device blocks
     bsr.w   INITMEMCOUNT                ; Initialise memory count in SDB
@@ -152,6 +153,34 @@ INITSDB:
     rts
     
 
+; If r68k is emulating a DUART (--duart), set its counter / timer
+; up for the 100Hz system tick, as the real firmware does. Otherwise
+; r68k generates the tick itself.
+;
+; Trashes: A0
+INITDUART:
+    move.l  #DUART_BASE_MBR2,A0
+    cmp.b   #$0F,DUART_IVR(A0)          ; IVR is 0x0F after reset
+    beq.s   .FOUND
+    move.l  #DUART_BASE_R2,A0
+    cmp.b   #$0F,DUART_IVR(A0)
+    bne.s   .DONE
+
+.FOUND
+    move.l  A0,SDB_UARTBASE
+    move.b  #$F0,DUART_ACR(A0)          ; Enable timer XCLK/16
+    move.b  #$45,DUART_IVR(A0)          ; Use vector 0x45
+
+    ; Timer will run at ~100Hz: 3686400 / 16 / (1152 * 2) = 100
+    move.b  #$04,DUART_CTUR(A0)         ; Counter MSB is 0x04
+    move.b  #$80,DUART_CTLR(A0)         ; Counter LSB is 0x80
+    tst.b   R_STARTCNTCMD(A0)           ; Issue START COUNTER command
+    move.b  #$08,DUART_IMR(A0)          ; Unmask counter interrupt
+
+.DONE
+    rts
+
+
 ; Initialise Extension Function Pointer Table
 ;
 INITEFPT:
@@ -171,6 +200,8 @@ INITEFPT:
     move.l  #XL_SD_READ,EFP_SD_READ
     move.l  #XL_SD_WRITE,EFP_SD_WRITE
     move.l  #XL_SD_REGISTER,EFP_SD_REG
+    move.l  #XL_SD_READ_M,EFP_SD_READ_M
+    move.l  #XL_SD_WRITE_M,EFP_SD_WRITE_M
 
     ; Block Device IO Routines - SPI
     move.l  #EFP_DUMMY_NEGONE_D0L,EFP_SPI_INIT
@@ -297,6 +328,27 @@ XL_SD_WRITE:
     move.l  (A7)+,D6
     move.l  (A7)+,D7
     rts
+; Multi-block transfers: as XL_SD_READ / XL_SD_WRITE, with the
+; block count in D2. r68k copies the whole run in one go. A zero
+; count succeeds without doing anything.
+XL_SD_READ_M:
+    move.l  D7,-(A7)
+    move.l  D6,-(A7)
+    move.l  #$F0F0F0F9,D7
+    move.l  #$AA55AA55,D6
+    illegal
+    move.l  (A7)+,D6
+    move.l  (A7)+,D7
+    rts
+XL_SD_WRITE_M:
+    move.l  D7,-(A7)
+    move.l  D6,-(A7)
+    move.l  #$F0F0F0FA,D7
+    move.l  #$AA55AA55,D6
+    illegal
+    move.l  (A7)+,D6
+    move.l  (A7)+,D7
+    rts
 XL_SD_REGISTER:
     clr.l   d0
     rts
@@ -465,6 +517,16 @@ ILLEGAL_INSTRUCTION_HANDLER:
 TICK_HANDLER:
     move.l  #$0071C70C,SDB_STATUS
     add.l   #1,SDB_UPTICKS
+
+    tst.l   SDB_UARTBASE                ; Ticking from the DUART?
+    beq.s   .DONE
+
+    move.l  A0,-(A7)
+    move.l  SDB_UARTBASE,A0
+    tst.b   R_STOPCNTCMD(A0)            ; Clear ISR[3]
+    move.l  (A7)+,A0
+
+.DONE
     rte
 
 
@@ -65,6 +65,10 @@ EFP_ATA_READ    equ     $484
 EFP_ATA_WRITE   equ     $488
 EFP_ATA_IDENT   equ     $48C
 EFP_PROG_EXIT   equ     $490
+EFP_INPUTCHAR   equ     $494
+EFP_CHECKINPUT  equ     $498
+EFP_SD_READ_M   equ     $49C
+EFP_SD_WRITE_M  equ     $4A0
 
   ifd REVISION1X
 ; MFP Location
@@ -25,7 +25,7 @@ TRAP_13_VECTOR_ADDR equ     TRAP_13_VECTOR*4
 ;
 ; NOTE: Trashes A0, and allowed to modify arguments.
 TRAP_13_HANDLER::
-    cmp.l   #19,D0                      ; Is function code in range?
+    cmp.l   #21,D0                      ; Is function code in range?
     bhi.s   .NOT_IMPLEMENTED            ; Nope, leave...
 
     add.l   D0,D0                       ; Multiply FC...
@@ -54,6 +54,8 @@ TRAP_13_HANDLER::
     dc.l    ATA_READ                    ; FC == 17
     dc.l    ATA_WRITE                   ; FC == 18
     dc.l    ATA_IDENTIFY                ; FC == 19
+    dc.l    SD_READ_BLOCKS              ; FC == 20
+    dc.l    SD_WRITE_BLOCKS             ; FC == 21
 .NOT_IMPLEMENTED:
     rte
 
@@ -85,6 +87,16 @@ SD_WRITE_BLOCK:
     jsr     (A0)
     rte
 
+SD_READ_BLOCKS:
+    move.l  EFP_SD_READ_M,A0
+    jsr     (A0)
+    rte
+
+SD_WRITE_BLOCKS:
+    move.l  EFP_SD_WRITE_M,A0
+    jsr     (A0)
+    rte
+
 SD_READ_REGISTER:
     move.l  EFP_SD_REG,A0
     jsr     (A0)
@@ -9,12 +9,33 @@
 #include <fstream>
 #include <memory>
 #include "Memory.h"
+#include "Device.h"
 
 namespace rosco {
     namespace m68k {
         namespace emu {
+            /*
+             * The 24-bit bus is split into 4KiB pages. Each page has a
+             * host pointer for reads and one for writes (RAM and ROM),
+             * and / or a Device for MMIO. Accesses that hit a page with
+             * a host pointer (and don't straddle the end of the page) are
+             * served inline; everything else goes through the slow path.
+             *
+             * Pages can also be watched (e.g. because the CPU has cached
+             * decoded code from them): writes to a watched page take the
+             * slow path, which unwatches the page and calls the watch
+             * callback before doing the write.
+             */
             class AddressDecoder {
             public:
+                static constexpr std::uint32_t PAGE_SHIFT = 12;
+                static constexpr std::uint32_t PAGE_SIZE = 1 << PAGE_SHIFT;
+                static constexpr std::uint32_t PAGE_MASK = PAGE_SIZE - 1;
+                static constexpr std::uint32_t PAGE_COUNT = 0x01000000 >> PAGE_SHIFT;
+
+                static constexpr std::uint32_t ROM_BASE = 0x00e00000;
+                static constexpr std::uint32_t ROM_LIMIT = 0x00f00000;
+
                 explicit AddressDecoder(std::uint32_t romsize, std::uint32_t ramsize, char const* filename);
 
                 Memory* getMemoryForAddress(std::uint32_t address);
@@ -22,13 +43,95 @@ namespace rosco {
 
                 void reset();
 
-                std::uint32_t read32(std::uint32_t address);
-                std::uint16_t read16(std::uint32_t address);
-                std::uint8_t read8(std::uint32_t address);
+                void MapDevice(std::uint32_t base, std::uint32_t size, Device *device);
+
+                typedef void (*WatchCallback)(std::uint32_t address);
+
+                void SetWatchCallback(WatchCallback callback);
+
+                // Watch the page containing address. Returns false if the page
+                // isn't plain memory (and so can't be watched).
+                bool WatchPage(std::uint32_t address);
+
+                inline std::uint32_t read32(std::uint32_t address) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t offset = address & PAGE_MASK;
+
+                    if (page < PAGE_COUNT && offset <= PAGE_SIZE - 4 && readPages[page]) {
+                        return bswap_32(*((std::uint32_t*)(readPages[page] + offset)));
+                    }
+#endif
+                    return slowRead32(address);
+                }
+
+                inline std::uint16_t read16(std::uint32_t address) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t offset = address & PAGE_MASK;
+
+                    if (page < PAGE_COUNT && offset <= PAGE_SIZE - 2 && readPages[page]) {
+                        return bswap_16(*((std::uint16_t*)(readPages[page] + offset)));
+                    }
+#endif
+                    return slowRead16(address);
+                }
+
+                inline std::uint8_t read8(std::uint32_t address) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+
+                    if (page < PAGE_COUNT && readPages[page]) {
+                        return readPages[page][address & PAGE_MASK];
+                    }
+#endif
+                    return slowRead8(address);
+                }
 
-                void write32(std::uint32_t address, std::uint32_t data);
-                void write16(std::uint32_t address, std::uint16_t data);
-                void write8(std::uint32_t address, std::uint8_t data);
+                inline void write32(std::uint32_t address, std::uint32_t data) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t offset = address & PAGE_MASK;
+
+                    if (page < PAGE_COUNT && offset <= PAGE_SIZE - 4 && writePages[page]) {
+                        *((std::uint32_t*)(writePages[page] + offset)) = bswap_32(data);
+                        return;
+                    }
+#endif
+                    slowWrite32(address, data);
+                }
+
+                inline void write16(std::uint32_t address, std::uint16_t data) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t offset = address & PAGE_MASK;
+
+                    if (page < PAGE_COUNT && offset <= PAGE_SIZE - 2 && writePages[page]) {
+                        *((std::uint16_t*)(writePages[page] + offset)) = bswap_16(data);
+                        return;
+                    }
+#endif
+                    slowWrite16(address, data);
+                }
+
+                inline void write8(std::uint32_t address, std::uint8_t data) {
+#ifndef MEM_TRACE
+                    std::uint32_t page = address >> PAGE_SHIFT;
+
+                    if (page < PAGE_COUNT && writePages[page]) {
+                        writePages[page][address & PAGE_MASK] = data;
+                        return;
+                    }
+#endif
+                    slowWrite8(address, data);
+                }
+
+                // Bulk copies between host buffers and the bus (e.g. for DMA-style
+                // block device transfers). Plain memory is copied a page at a time,
+                // anything else falls back to byte accesses. Watched pages are
+                // handled just like a CPU write.
+                void CopyIn(std::uint32_t address, const std::uint8_t *src, std::uint32_t size);
+                void CopyOut(std::uint32_t address, std::uint8_t *dst, std::uint32_t size);
 
                 void LoadMemoryFile(const uint32_t baseAddr, char const* filename);
 
@@ -38,6 +141,25 @@ namespace rosco {
                 bool bootLineActive;
                 uint32_t bootReadCount;
 
+                std::uint8_t *readPages[PAGE_COUNT];
+                std::uint8_t *writePages[PAGE_COUNT];
+                Device *devicePages[PAGE_COUNT];
+                bool watchedPages[PAGE_COUNT];
+                WatchCallback watchCallback;
+
+                std::uint8_t *HostPointerFor(std::uint32_t page);
+                void BuildPageTable();
+                void CheckWatch(std::uint32_t address, std::uint32_t size);
+                void SetBootShadow(bool active);
+
+                std::uint32_t slowRead32(std::uint32_t address);
+                std::uint16_t slowRead16(std::uint32_t address);
+                std::uint8_t slowRead8(std::uint32_t address);
+
+                void slowWrite32(std::uint32_t address, std::uint32_t data);
+                void slowWrite16(std::uint32_t address, std::uint16_t data);
+                void slowWrite8(std::uint32_t address, std::uint8_t data);
+
                 void ReadRomData(char const* filename);
             };
         }
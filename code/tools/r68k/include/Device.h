@@ -0,0 +1,47 @@
+#ifndef ROSCOM68K_EMU_DEVICE_H
+#define ROSCOM68K_EMU_DEVICE_H
+
+#include <cstdint>
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            /*
+             * Memory-mapped I/O device, mapped into one or more pages
+             * with AddressDecoder::MapDevice. Addresses passed in are
+             * absolute bus addresses.
+             *
+             * Only read8 / write8 are required; wider accesses default
+             * to big-endian byte sequences, which is what the 8-bit
+             * peripherals on the rosco_m68k bus actually see.
+             */
+            class Device {
+            public:
+                virtual ~Device() = default;
+
+                virtual std::uint8_t read8(std::uint32_t address) = 0;
+                virtual void write8(std::uint32_t address, std::uint8_t data) = 0;
+
+                virtual std::uint16_t read16(std::uint32_t address) {
+                    return static_cast<std::uint16_t>((read8(address) << 8) | read8(address + 1));
+                }
+
+                virtual std::uint32_t read32(std::uint32_t address) {
+                    return (static_cast<std::uint32_t>(read16(address)) << 16) | read16(address + 2);
+                }
+
+                virtual void write16(std::uint32_t address, std::uint16_t data) {
+                    write8(address, data >> 8);
+                    write8(address + 1, data & 0xFF);
+                }
+
+                virtual void write32(std::uint32_t address, std::uint32_t data) {
+                    write16(address, data >> 16);
+                    write16(address + 2, data & 0xFFFF);
+                }
+            };
+        }
+    }
+}
+
+#endif //ROSCOM68K_EMU_DEVICE_H
@@ -0,0 +1,50 @@
+#ifndef ROSCOM68K_EMU_DISK_IMAGE_H
+#define ROSCOM68K_EMU_DISK_IMAGE_H
+
+#include <cstdint>
+#include "AddressDecoder.h"
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            /*
+             * A block device backed by an image file, mapped into the host
+             * address space. Transfers are copied straight between the
+             * mapping and emulated memory, and the host only pages in (or
+             * allocates, for sparse images) the blocks that are touched.
+             *
+             * If the image can't be opened read / write, it's mapped
+             * read-only and writes will fail.
+             */
+            class DiskImage {
+            public:
+                static constexpr std::uint32_t BLOCK_SIZE = 512;
+                // No point transferring more than the whole bus in one go
+                static constexpr std::uint32_t MAX_TRANSFER_BLOCKS = 0x01000000 / BLOCK_SIZE;
+
+                explicit DiskImage(char const* filename);
+                ~DiskImage();
+
+                bool IsOpen() const { return this->data != nullptr; }
+                bool IsWritable() const { return this->writable; }
+                std::uint64_t BlockCount() const { return this->size / BLOCK_SIZE; }
+
+                // Copy count blocks starting at lba to / from the bus at address.
+                // Returns false (and transfers nothing) if any of the blocks are
+                // outside the image, or count is zero or too big.
+                bool ReadBlocks(std::uint32_t lba, std::uint32_t count, AddressDecoder *bus, std::uint32_t address);
+                bool WriteBlocks(std::uint32_t lba, std::uint32_t count, AddressDecoder *bus, std::uint32_t address);
+
+            private:
+                int fd;
+                std::uint8_t *data;
+                std::uint64_t size;
+                bool writable;
+
+                bool InRange(std::uint32_t lba, std::uint32_t count) const;
+            };
+        }
+    }
+}
+
+#endif //ROSCOM68K_EMU_DISK_IMAGE_H
@@ -0,0 +1,131 @@
+#ifndef ROSCOM68K_EMU_DUART68681_H
+#define ROSCOM68K_EMU_DUART68681_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include "Device.h"
+#include "Scheduler.h"
+#include "SerialBackend.h"
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            /*
+             * MC68681 / XR68C681 DUART, as wired on the r2.x boards: the
+             * sixteen registers are on odd addresses, two bytes apart,
+             * from the base address.
+             *
+             * Each channel has the 3-byte receive FIFO and a transmit
+             * holding register in front of the shift register. Characters
+             * take as long as they would at the programmed bit rate
+             * (so polled I/O runs at real serial speeds), and host input
+             * is only taken when there's room in the FIFO, so nothing is
+             * lost to overruns.
+             *
+             * The counter / timer runs from the 3.6864MHz crystal (or
+             * that / 16) and is how the firmware gets its system tick.
+             */
+            class Duart68681 : public Device {
+            public:
+                static constexpr std::uint32_t BASE_MBR2 = 0x00f00001;
+                static constexpr std::uint32_t BASE_R2 = 0x00f800a8;
+                static constexpr std::uint32_t SIZE = 0x20;
+                static constexpr std::uint32_t X1_HZ = 3686400;
+
+                typedef std::function<void(bool asserted)> IrqCallback;
+
+                explicit Duart68681(std::uint32_t base, Scheduler *scheduler, IrqCallback irq);
+                ~Duart68681();
+
+                std::uint32_t Base() const { return this->base; }
+
+                // Connect a channel (0 = A, 1 = B) to the host. Unconnected
+                // channels never receive, and transmit into the void.
+                void Attach(int channel, SerialBackend *backend);
+
+                void Reset();
+
+                // Vector to supply for the interrupt acknowledge cycle
+                std::uint8_t Vector() const { return this->ivr; }
+
+                std::uint8_t read8(std::uint32_t address) override;
+                void write8(std::uint32_t address, std::uint8_t data) override;
+
+            private:
+                static constexpr std::size_t RX_FIFO_SIZE = 3;
+
+                struct Channel {
+                    SerialBackend *backend;
+                    std::uint8_t mr1;
+                    std::uint8_t mr2;
+                    bool mrPointer2;
+                    std::uint8_t csr;
+                    bool rxExtended;
+                    bool txExtended;
+
+                    bool rxEnabled;
+                    std::deque<std::uint8_t> rxFifo;
+                    int rxEvent;
+
+                    bool txEnabled;
+                    bool txHoldingFull;
+                    std::uint8_t txHolding;
+                    bool txShifting;
+                    int txEvent;
+                };
+
+                std::uint32_t base;
+                Scheduler *scheduler;
+                IrqCallback irq;
+                bool irqAsserted;
+
+                Channel channels[2];
+
+                std::uint8_t acr;
+                std::uint8_t imr;
+                std::uint8_t ivr;
+                std::uint8_t opcr;
+                std::uint8_t opr;
+
+                std::uint16_t ctPreload;
+                bool ctRunning;
+                bool ctReady;
+                std::uint16_t ctStopped;
+                std::uint64_t ctStart;
+                std::uint64_t ctPeriodTicks;
+                int ctEvent;
+
+                std::uint8_t ReadRegister(int reg);
+                void WriteRegister(int reg, std::uint8_t data);
+                void Command(int ch, std::uint8_t data);
+                std::uint8_t Status(int ch) const;
+                std::uint8_t InterruptStatus() const;
+
+                std::uint32_t BitRate(int ch, bool rx) const;
+                std::uint64_t CharacterCycles(int ch, bool rx) const;
+
+                void StartReceiver(int ch);
+                void PollReceiver(int ch);
+                void Transmit(int ch, std::uint8_t data);
+                void TransmitDone(int ch);
+
+                std::uint32_t CounterSourceHz() const;
+                bool TimerMode() const { return (this->acr & 0x40) != 0; }
+                std::uint64_t Preload() const { return this->ctPreload ? this->ctPreload : 0x10000; }
+                std::uint64_t CounterCycles(std::uint64_t ticks) const;
+                std::uint64_t CounterTicks() const;
+                std::uint16_t CounterValue() const;
+                void StartCounter();
+                void StopCounter();
+                void ScheduleCounter();
+                void CounterExpired();
+
+                void CancelEvent(int &event);
+                void UpdateInterrupts();
+            };
+        }
+    }
+}
+
+#endif //ROSCOM68K_EMU_DUART68681_H
@@ -0,0 +1,94 @@
+#ifndef ROSCOM68K_EMU_SCHEDULER_H
+#define ROSCOM68K_EMU_SCHEDULER_H
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            /*
+             * Fires device events at emulated-cycle deadlines.
+             *
+             * The main loop asks for the number of cycles until the next
+             * deadline, runs the CPU for (at most) that long, and then
+             * calls Advance with the cycles actually used. Everything
+             * happens on the CPU thread, so callbacks are free to call
+             * into Musashi (e.g. m68k_set_irq).
+             *
+             * When throttled, Advance also sleeps the host so emulated
+             * time doesn't run ahead of wall time at the given clock.
+             *
+             * Devices may also schedule while the CPU is running (from an
+             * MMIO access). The slice hooks let those be timed from the
+             * cycle the access happened on, and cut the slice short when
+             * the new event is due before the slice would end.
+             */
+            class Scheduler {
+            public:
+                typedef std::function<void()> Callback;
+                typedef std::function<std::uint64_t()> SliceElapsed;
+                typedef std::function<void()> SliceEnd;
+
+                explicit Scheduler(std::uint32_t clockHz, bool throttle);
+
+                std::uint64_t Now() const { return this->now; }
+
+                // Like Now, but including the part of the current slice that's
+                // already been executed.
+                std::uint64_t Current() const;
+                std::uint32_t ClockHz() const { return this->clockHz; }
+
+                // Cycles per period of a frequency in Hz, at the current clock.
+                std::uint64_t CyclesForHz(std::uint32_t hz) const { return this->clockHz / hz; }
+
+                // Schedule callback to run delay cycles from now, and then
+                // every period cycles if period is non-zero. Returns an id
+                // for Cancel.
+                int Schedule(std::uint64_t delay, Callback callback, std::uint64_t period = 0);
+                void Cancel(int id);
+
+                // Cycles until the next event is due, capped at limit.
+                std::uint64_t CyclesUntilNextEvent(std::uint64_t limit) const;
+
+                void SetSliceHooks(SliceElapsed elapsed, SliceEnd end);
+
+                // Start running a slice of at most limit cycles, stopping early for
+                // the next event. Returns the number of cycles to run (at least 1).
+                std::uint64_t BeginSlice(std::uint64_t limit);
+
+                // Stop the current slice as soon as possible (e.g. an IRQ was raised).
+                void EndSlice();
+
+                // Account for cycles executed (ending the slice) and fire everything
+                // that's due.
+                void Advance(std::uint64_t cycles);
+
+            private:
+                struct Event {
+                    std::uint64_t deadline;
+                    std::uint64_t period;
+                    Callback callback;
+                    bool active;
+                };
+
+                std::uint32_t clockHz;
+                bool throttle;
+                std::uint64_t now;
+                std::vector<Event> events;
+                std::chrono::steady_clock::time_point hostStart;
+
+                bool inSlice;
+                std::uint64_t sliceEnd;
+                SliceElapsed sliceElapsed;
+                SliceEnd sliceEndHook;
+
+                void Throttle();
+            };
+        }
+    }
+}
+
+#endif //ROSCOM68K_EMU_SCHEDULER_H
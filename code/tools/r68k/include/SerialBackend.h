@@ -0,0 +1,50 @@
+#ifndef ROSCOM68K_EMU_SERIAL_BACKEND_H
+#define ROSCOM68K_EMU_SERIAL_BACKEND_H
+
+#include <cstdint>
+#include <string>
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            /*
+             * Host end of an emulated serial port. Receive must not
+             * block - it returns false if nothing is waiting.
+             */
+            class SerialBackend {
+            public:
+                virtual ~SerialBackend() = default;
+
+                virtual bool Receive(std::uint8_t &data) = 0;
+                virtual void Send(std::uint8_t data) = 0;
+            };
+
+            // The terminal r68k was started from (stdin must already be raw
+            // and non-blocking, see init_term).
+            class StdioSerial : public SerialBackend {
+            public:
+                bool Receive(std::uint8_t &data) override;
+                void Send(std::uint8_t data) override;
+            };
+
+            // A fresh pseudo-terminal, for connecting e.g. kermit or minicom.
+            class PtySerial : public SerialBackend {
+            public:
+                PtySerial();
+                ~PtySerial();
+
+                bool IsOpen() const { return this->fd >= 0; }
+                const std::string& Name() const { return this->name; }
+
+                bool Receive(std::uint8_t &data) override;
+                void Send(std::uint8_t data) override;
+
+            private:
+                int fd;
+                std::string name;
+            };
+        }
+    }
+}
+
+#endif //ROSCOM68K_EMU_SERIAL_BACKEND_H
@@ -3,6 +3,7 @@
 //
 
 #include <iostream>
+#include <cstring>
 #include "AddressDecoder.h"
 
 namespace rosco {
@@ -14,6 +15,15 @@ namespace rosco {
                 this->bootLineActive = true;
                 this->bootReadCount = 0;
 
+                this->watchCallback = NULL;
+
+                for (std::uint32_t page = 0; page < PAGE_COUNT; page++) {
+                    this->devicePages[page] = NULL;
+                    this->watchedPages[page] = false;
+                }
+
+                BuildPageTable();
+
 #ifdef MEM_TRACE
                 std::cout << "Initialized with " << this->ram->size << " bytes RAM and " << this->rom->size << " bytes ROM" << std::endl;
 #endif
@@ -21,13 +31,89 @@ namespace rosco {
                 ReadRomData(filename);
             }
 
+            std::uint8_t* AddressDecoder::HostPointerFor(std::uint32_t page) {
+                std::uint32_t base = page << PAGE_SHIFT;
+
+                if (this->devicePages[page] != NULL) {
+                    return NULL;
+                } else if (base + PAGE_SIZE <= this->ram->size) {
+                    return this->ram->store + base;
+                } else if (base >= ROM_BASE && base + PAGE_SIZE <= ROM_BASE + this->rom->size && base < ROM_LIMIT) {
+                    return this->rom->store + (base - ROM_BASE);
+                } else {
+                    return NULL;
+                }
+            }
+
+            void AddressDecoder::BuildPageTable() {
+                for (std::uint32_t page = 0; page < PAGE_COUNT; page++) {
+                    std::uint32_t base = page << PAGE_SHIFT;
+                    std::uint8_t *host = HostPointerFor(page);
+
+                    this->writePages[page] = this->watchedPages[page] ? NULL : host;
+
+                    // While /BOOT is asserted, long reads from the bottom of the
+                    // address space come from ROM, so keep those pages on the slow path.
+                    if (this->bootLineActive && base < this->rom->size) {
+                        this->readPages[page] = NULL;
+                    } else {
+                        this->readPages[page] = host;
+                    }
+                }
+            }
+
+            void AddressDecoder::SetBootShadow(bool active) {
+                this->bootLineActive = active;
+                BuildPageTable();
+            }
+
+            void AddressDecoder::MapDevice(std::uint32_t base, std::uint32_t size, Device *device) {
+                for (std::uint32_t page = base >> PAGE_SHIFT; page < PAGE_COUNT && (page << PAGE_SHIFT) < base + size; page++) {
+                    this->devicePages[page] = device;
+                }
+
+                BuildPageTable();
+            }
+
+            void AddressDecoder::SetWatchCallback(WatchCallback callback) {
+                this->watchCallback = callback;
+            }
+
+            bool AddressDecoder::WatchPage(std::uint32_t address) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                if (page >= PAGE_COUNT || HostPointerFor(page) == NULL) {
+                    return false;
+                }
+
+                this->watchedPages[page] = true;
+                this->writePages[page] = NULL;
+                return true;
+            }
+
+            void AddressDecoder::CheckWatch(std::uint32_t address, std::uint32_t size) {
+                std::uint32_t first = address >> PAGE_SHIFT;
+                std::uint32_t last = (address + size - 1) >> PAGE_SHIFT;
+
+                for (std::uint32_t page = first; page <= last && page < PAGE_COUNT; page++) {
+                    if (this->watchedPages[page]) {
+                        this->watchedPages[page] = false;
+                        this->writePages[page] = HostPointerFor(page);
+
+                        if (this->watchCallback) {
+                            this->watchCallback(page << PAGE_SHIFT);
+                        }
+                    }
+                }
+            }
+
             Memory* AddressDecoder::getMemoryForAddress(std::uint32_t address) {
                 if (address < this->ram->size) {
 #ifdef MEM_TRACE
                     std::cout << "Read RAM @ " << std::hex << address << std::endl;
 #endif
                     return this->ram.get();
-                } else if (address >= 0x00e00000 && address < 0x00f00000) {
+                } else if (address >= ROM_BASE && address < ROM_LIMIT) {
 #ifdef MEM_TRACE
                     std::cout << "Read ROM @ " << std::hex << address << std::endl;
 #endif
@@ -47,11 +133,11 @@ namespace rosco {
                     std::cout << "RAM Relative address is: 0x" << std::hex << address << std::endl;
 #endif
                     return address;
-                } else if (address >= 0x00e00000 && address < 0x00f00000) {
+                } else if (address >= ROM_BASE && address < ROM_LIMIT) {
 #ifdef MEM_TRACE
-                    std::cout << "ROM Relative address is: 0x" << std::hex << address - (0x00e00000) << std::endl;
+                    std::cout << "ROM Relative address is: 0x" << std::hex << address - ROM_BASE << std::endl;
 #endif
-                    return address - (0x00e00000);
+                    return address - ROM_BASE;
                 } else {
                     // /BERR?
 #ifdef MEM_TRACE
@@ -62,12 +148,16 @@ namespace rosco {
             }
 
             void AddressDecoder::reset() {
-                this->bootLineActive = true;
                 this->bootReadCount = 0;
+                SetBootShadow(true);
             }
 
-            std::uint32_t AddressDecoder::read32(std::uint32_t address) {
+            // Slow paths: boot shadow, MMIO, unmapped, and accesses that
+            // straddle a page boundary.
+
+            std::uint32_t AddressDecoder::slowRead32(std::uint32_t address) {
                 Memory *mem;
+                std::uint32_t page = address >> PAGE_SHIFT;
 
                 if (this->bootLineActive && address < this->rom->size) {
                     if (this->bootReadCount++ < 1) {
@@ -79,9 +169,11 @@ namespace rosco {
 #ifdef MEM_TRACE
                         std::cout << "Deassert /BOOT and read ROM @ " << std::hex << address << std::endl;
 #endif
-                        this->bootLineActive = false;
+                        SetBootShadow(false);
                         mem = this->rom.get();
                     }
+                } else if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    return this->devicePages[page]->read32(address);
                 } else {
                     mem = this->getMemoryForAddress(address);
                 }
@@ -95,7 +187,13 @@ namespace rosco {
                 }
             }
 
-            std::uint16_t AddressDecoder::read16(std::uint32_t address) {
+            std::uint16_t AddressDecoder::slowRead16(std::uint32_t address) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    return this->devicePages[page]->read16(address);
+                }
+
                 Memory *mem = this->getMemoryForAddress(address);
 
                 if (mem != NULL) {
@@ -106,7 +204,13 @@ namespace rosco {
                 }
             }
 
-            std::uint8_t AddressDecoder::read8(std::uint32_t address) {
+            std::uint8_t AddressDecoder::slowRead8(std::uint32_t address) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    return this->devicePages[page]->read8(address);
+                }
+
                 Memory *mem = this->getMemoryForAddress(address);
 
                 if (mem != NULL) {
@@ -117,7 +221,16 @@ namespace rosco {
                 }
             }
 
-            void AddressDecoder::write32(std::uint32_t address, std::uint32_t data) {
+            void AddressDecoder::slowWrite32(std::uint32_t address, std::uint32_t data) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                CheckWatch(address, 4);
+
+                if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    this->devicePages[page]->write32(address, data);
+                    return;
+                }
+
                 Memory *mem = this->getMemoryForAddress(address);
 
                 if (mem != NULL) {
@@ -127,7 +240,16 @@ namespace rosco {
                 }
             }
 
-            void AddressDecoder::write16(std::uint32_t address, std::uint16_t data) {
+            void AddressDecoder::slowWrite16(std::uint32_t address, std::uint16_t data) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                CheckWatch(address, 2);
+
+                if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    this->devicePages[page]->write16(address, data);
+                    return;
+                }
+
                 Memory *mem = this->getMemoryForAddress(address);
 
                 if (mem != NULL) {
@@ -137,7 +259,16 @@ namespace rosco {
                 }
             }
 
-            void AddressDecoder::write8(std::uint32_t address, std::uint8_t data) {
+            void AddressDecoder::slowWrite8(std::uint32_t address, std::uint8_t data) {
+                std::uint32_t page = address >> PAGE_SHIFT;
+
+                CheckWatch(address, 1);
+
+                if (page < PAGE_COUNT && this->devicePages[page] != NULL) {
+                    this->devicePages[page]->write8(address, data);
+                    return;
+                }
+
                 Memory *mem = this->getMemoryForAddress(address);
 
                 if (mem != NULL) {
@@ -147,6 +278,54 @@ namespace rosco {
                 }
             }
 
+            void AddressDecoder::CopyIn(std::uint32_t address, const std::uint8_t *src, std::uint32_t size) {
+                while (size > 0) {
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t chunk = PAGE_SIZE - (address & PAGE_MASK);
+
+                    if (chunk > size) {
+                        chunk = size;
+                    }
+
+                    CheckWatch(address, chunk);
+
+                    if (page < PAGE_COUNT && this->writePages[page]) {
+                        std::memcpy(this->writePages[page] + (address & PAGE_MASK), src, chunk);
+                    } else {
+                        for (std::uint32_t i = 0; i < chunk; i++) {
+                            slowWrite8(address + i, src[i]);
+                        }
+                    }
+
+                    address += chunk;
+                    src += chunk;
+                    size -= chunk;
+                }
+            }
+
+            void AddressDecoder::CopyOut(std::uint32_t address, std::uint8_t *dst, std::uint32_t size) {
+                while (size > 0) {
+                    std::uint32_t page = address >> PAGE_SHIFT;
+                    std::uint32_t chunk = PAGE_SIZE - (address & PAGE_MASK);
+
+                    if (chunk > size) {
+                        chunk = size;
+                    }
+
+                    if (page < PAGE_COUNT && this->readPages[page]) {
+                        std::memcpy(dst, this->readPages[page] + (address & PAGE_MASK), chunk);
+                    } else {
+                        for (std::uint32_t i = 0; i < chunk; i++) {
+                            dst[i] = slowRead8(address + i);
+                        }
+                    }
+
+                    address += chunk;
+                    dst += chunk;
+                    size -= chunk;
+                }
+            }
+
             void AddressDecoder::ReadRomData(char const* filename) {
                 this->rom->LoadData(0, filename);
             }
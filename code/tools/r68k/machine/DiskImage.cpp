@@ -0,0 +1,88 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DiskImage.h"
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            DiskImage::DiskImage(char const* filename) {
+                struct stat st;
+
+                this->data = nullptr;
+                this->size = 0;
+                this->writable = true;
+
+                this->fd = open(filename, O_RDWR);
+                if (this->fd < 0) {
+                    this->writable = false;
+                    this->fd = open(filename, O_RDONLY);
+                }
+
+                if (this->fd < 0) {
+                    return;
+                }
+
+                if (fstat(this->fd, &st) < 0 || st.st_size < BLOCK_SIZE) {
+                    close(this->fd);
+                    this->fd = -1;
+                    return;
+                }
+
+                int prot = this->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+                void *map = mmap(NULL, st.st_size, prot, MAP_SHARED | MAP_NORESERVE, this->fd, 0);
+
+                if (map == MAP_FAILED) {
+                    close(this->fd);
+                    this->fd = -1;
+                    return;
+                }
+
+                this->data = static_cast<std::uint8_t*>(map);
+                this->size = st.st_size;
+            }
+
+            DiskImage::~DiskImage() {
+                if (this->data) {
+                    if (this->writable) {
+                        msync(this->data, this->size, MS_SYNC);
+                    }
+
+                    munmap(this->data, this->size);
+                }
+
+                if (this->fd >= 0) {
+                    close(this->fd);
+                }
+            }
+
+            bool DiskImage::InRange(std::uint32_t lba, std::uint32_t count) const {
+                return this->data && count > 0 && count <= MAX_TRANSFER_BLOCKS
+                        && static_cast<std::uint64_t>(lba) + count <= BlockCount();
+            }
+
+            bool DiskImage::ReadBlocks(std::uint32_t lba, std::uint32_t count, AddressDecoder *bus, std::uint32_t address) {
+                if (!InRange(lba, count)) {
+                    return false;
+                }
+
+                bus->CopyIn(address, this->data + static_cast<std::uint64_t>(lba) * BLOCK_SIZE, count * BLOCK_SIZE);
+                return true;
+            }
+
+            bool DiskImage::WriteBlocks(std::uint32_t lba, std::uint32_t count, AddressDecoder *bus, std::uint32_t address) {
+                if (!this->writable || !InRange(lba, count)) {
+                    return false;
+                }
+
+                bus->CopyOut(address, this->data + static_cast<std::uint64_t>(lba) * BLOCK_SIZE, count * BLOCK_SIZE);
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,542 @@
+#include "Duart68681.h"
+
+// Register numbers (read / write)
+#define REG_MRA         0
+#define REG_SRA_CSRA    1
+#define REG_MISR_CRA    2
+#define REG_RHRA_THRA   3
+#define REG_IPCR_ACR    4
+#define REG_ISR_IMR     5
+#define REG_CUR_CTUR    6
+#define REG_CLR_CTLR    7
+#define REG_MRB         8
+#define REG_SRB_CSRB    9
+#define REG_CRB         10
+#define REG_RHRB_THRB   11
+#define REG_IVR         12
+#define REG_IP_OPCR     13
+#define REG_START_OPRS  14
+#define REG_STOP_OPRR   15
+
+// Status register bits
+#define SR_RXRDY        0x01
+#define SR_FFULL        0x02
+#define SR_TXRDY        0x04
+#define SR_TXEMT        0x08
+
+// Interrupt status / mask bits
+#define ISR_TXRDYA      0x01
+#define ISR_RXRDYA      0x02
+#define ISR_COUNTER     0x08
+#define ISR_TXRDYB      0x10
+#define ISR_RXRDYB      0x20
+
+// Used when the bit rate comes from somewhere we don't model (IP3 / IP4 etc.)
+#define DEFAULT_BIT_RATE    115200
+
+// How often to look for host input while none is arriving
+#define RX_IDLE_POLL_HZ     1000
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            // Bit rates by CSR code, for ACR[7] = 0 / 1 and then the same with
+            // the XR68C681 extended bit set for the channel. 0xD is the timer.
+            static const std::uint32_t bitRates[4][16] = {
+                {    50, 110, 134, 200,   300,   600,  1200, 1050,   2400,  4800, 7200,  9600,  38400, 0, 0, 0 },
+                {    75, 110, 134, 150,   300,   600,  1200, 2000,   2400,  4800, 1800,  9600,  19200, 0, 0, 0 },
+                {   300, 110, 134, 1200, 1800,  3600,  7200, 1050,  14400, 28800, 7200, 57600, 230400, 0, 0, 0 },
+                {   450, 880, 1076, 900, 14400, 28800, 57600, 16000, 115200, 57600, 1800,  9600,  19200, 0, 0, 0 },
+            };
+
+            Duart68681::Duart68681(std::uint32_t base, Scheduler *scheduler, IrqCallback irq) {
+                this->base = base;
+                this->scheduler = scheduler;
+                this->irq = irq;
+                this->irqAsserted = false;
+
+                for (Channel &channel : this->channels) {
+                    channel.backend = nullptr;
+                    channel.rxEvent = -1;
+                    channel.txEvent = -1;
+                }
+
+                this->ctEvent = -1;
+
+                Reset();
+            }
+
+            Duart68681::~Duart68681() {
+                for (Channel &channel : this->channels) {
+                    CancelEvent(channel.rxEvent);
+                    CancelEvent(channel.txEvent);
+                }
+
+                CancelEvent(this->ctEvent);
+            }
+
+            void Duart68681::Attach(int channel, SerialBackend *backend) {
+                this->channels[channel].backend = backend;
+                StartReceiver(channel);
+            }
+
+            void Duart68681::Reset() {
+                for (Channel &channel : this->channels) {
+                    channel.mr1 = 0;
+                    channel.mr2 = 0;
+                    channel.mrPointer2 = false;
+                    channel.csr = 0;
+                    channel.rxExtended = false;
+                    channel.txExtended = false;
+
+                    channel.rxEnabled = false;
+                    channel.rxFifo.clear();
+                    CancelEvent(channel.rxEvent);
+
+                    channel.txEnabled = false;
+                    channel.txHoldingFull = false;
+                    channel.txHolding = 0;
+                    channel.txShifting = false;
+                    CancelEvent(channel.txEvent);
+                }
+
+                this->acr = 0;
+                this->imr = 0;
+                this->ivr = 0x0F;
+                this->opcr = 0;
+                this->opr = 0;
+
+                this->ctPreload = 0;
+                this->ctRunning = false;
+                this->ctReady = false;
+                this->ctStopped = 0;
+                this->ctStart = 0;
+                this->ctPeriodTicks = 0;
+                CancelEvent(this->ctEvent);
+
+                UpdateInterrupts();
+            }
+
+            std::uint8_t Duart68681::read8(std::uint32_t address) {
+                std::uint32_t offset = address - this->base;
+
+                if (address < this->base || offset >= SIZE || (offset & 1)) {
+                    return 0xFF;
+                }
+
+                return ReadRegister(offset >> 1);
+            }
+
+            void Duart68681::write8(std::uint32_t address, std::uint8_t data) {
+                std::uint32_t offset = address - this->base;
+
+                if (address < this->base || offset >= SIZE || (offset & 1)) {
+                    return;
+                }
+
+                WriteRegister(offset >> 1, data);
+            }
+
+            std::uint8_t Duart68681::ReadRegister(int reg) {
+                int ch = reg >= REG_MRB ? 1 : 0;
+                Channel &channel = this->channels[ch];
+                std::uint8_t data;
+
+                switch (reg) {
+                case REG_MRA:
+                case REG_MRB:
+                    data = channel.mrPointer2 ? channel.mr2 : channel.mr1;
+                    channel.mrPointer2 = true;
+                    return data;
+                case REG_SRA_CSRA:
+                case REG_SRB_CSRB:
+                    return Status(ch);
+                case REG_MISR_CRA:
+                    return InterruptStatus() & this->imr;
+                case REG_RHRA_THRA:
+                case REG_RHRB_THRB:
+                    if (channel.rxFifo.empty()) {
+                        return 0;
+                    }
+
+                    data = channel.rxFifo.front();
+                    channel.rxFifo.pop_front();
+                    UpdateInterrupts();
+                    return data;
+                case REG_IPCR_ACR:
+                    // No input port changes
+                    return 0;
+                case REG_ISR_IMR:
+                    return InterruptStatus();
+                case REG_CUR_CTUR:
+                    return CounterValue() >> 8;
+                case REG_CLR_CTLR:
+                    return CounterValue() & 0xFF;
+                case REG_IVR:
+                    return this->ivr;
+                case REG_IP_OPCR:
+                    // Nothing drives the inputs, so CTS always looks asserted
+                    return 0;
+                case REG_START_OPRS:
+                    StartCounter();
+                    return 0xFF;
+                case REG_STOP_OPRR:
+                    StopCounter();
+                    return 0xFF;
+                default:
+                    return 0xFF;
+                }
+            }
+
+            void Duart68681::WriteRegister(int reg, std::uint8_t data) {
+                int ch = reg >= REG_MRB ? 1 : 0;
+                Channel &channel = this->channels[ch];
+
+                switch (reg) {
+                case REG_MRA:
+                case REG_MRB:
+                    if (channel.mrPointer2) {
+                        channel.mr2 = data;
+                    } else {
+                        channel.mr1 = data;
+                        channel.mrPointer2 = true;
+                    }
+                    UpdateInterrupts();
+                    break;
+                case REG_SRA_CSRA:
+                case REG_SRB_CSRB:
+                    channel.csr = data;
+                    break;
+                case REG_MISR_CRA:
+                case REG_CRB:
+                    Command(ch, data);
+                    break;
+                case REG_RHRA_THRA:
+                case REG_RHRB_THRB:
+                    Transmit(ch, data);
+                    break;
+                case REG_IPCR_ACR:
+                    this->acr = data;
+                    ScheduleCounter();
+                    break;
+                case REG_ISR_IMR:
+                    this->imr = data;
+                    UpdateInterrupts();
+                    break;
+                case REG_CUR_CTUR:
+                    this->ctPreload = (this->ctPreload & 0x00FF) | (data << 8);
+                    break;
+                case REG_CLR_CTLR:
+                    this->ctPreload = (this->ctPreload & 0xFF00) | data;
+                    break;
+                case REG_IVR:
+                    this->ivr = data;
+                    break;
+                case REG_IP_OPCR:
+                    this->opcr = data;
+                    break;
+                case REG_START_OPRS:
+                    this->opr |= data;
+                    break;
+                case REG_STOP_OPRR:
+                    this->opr &= ~data;
+                    break;
+                }
+            }
+
+            void Duart68681::Command(int ch, std::uint8_t data) {
+                Channel &channel = this->channels[ch];
+
+                switch (data >> 4) {
+                case 0x1:
+                    // Reset MR pointer
+                    channel.mrPointer2 = false;
+                    break;
+                case 0x2:
+                    // Reset receiver
+                    channel.rxEnabled = false;
+                    channel.rxFifo.clear();
+                    CancelEvent(channel.rxEvent);
+                    break;
+                case 0x3:
+                    // Reset transmitter
+                    channel.txEnabled = false;
+                    channel.txHoldingFull = false;
+                    channel.txShifting = false;
+                    CancelEvent(channel.txEvent);
+                    break;
+                case 0x8:
+                    // XR68C681: set / clear the extended bit rate bits
+                    channel.rxExtended = true;
+                    break;
+                case 0x9:
+                    channel.rxExtended = false;
+                    break;
+                case 0xA:
+                    channel.txExtended = true;
+                    break;
+                case 0xB:
+                    channel.txExtended = false;
+                    break;
+                default:
+                    // Error / break commands, nothing to do
+                    break;
+                }
+
+                if (data & 0x02) {
+                    channel.rxEnabled = false;
+                    CancelEvent(channel.rxEvent);
+                } else if (data & 0x01) {
+                    channel.rxEnabled = true;
+                    StartReceiver(ch);
+                }
+
+                if (data & 0x08) {
+                    channel.txEnabled = false;
+                } else if (data & 0x04) {
+                    channel.txEnabled = true;
+                }
+
+                UpdateInterrupts();
+            }
+
+            std::uint8_t Duart68681::Status(int ch) const {
+                const Channel &channel = this->channels[ch];
+                std::uint8_t status = 0;
+
+                if (!channel.rxFifo.empty()) {
+                    status |= SR_RXRDY;
+                }
+
+                if (channel.rxFifo.size() >= RX_FIFO_SIZE) {
+                    status |= SR_FFULL;
+                }
+
+                if (channel.txEnabled && !channel.txHoldingFull) {
+                    status |= SR_TXRDY;
+
+                    if (!channel.txShifting) {
+                        status |= SR_TXEMT;
+                    }
+                }
+
+                return status;
+            }
+
+            std::uint8_t Duart68681::InterruptStatus() const {
+                std::uint8_t status = this->ctReady ? ISR_COUNTER : 0;
+
+                for (int ch = 0; ch < 2; ch++) {
+                    std::uint8_t sr = Status(ch);
+                    // MR1[6] selects whether RxRDY or FFULL interrupts
+                    std::uint8_t rxBit = (this->channels[ch].mr1 & 0x40) ? SR_FFULL : SR_RXRDY;
+
+                    if (sr & SR_TXRDY) {
+                        status |= ch ? ISR_TXRDYB : ISR_TXRDYA;
+                    }
+
+                    if (sr & rxBit) {
+                        status |= ch ? ISR_RXRDYB : ISR_RXRDYA;
+                    }
+                }
+
+                return status;
+            }
+
+            std::uint32_t Duart68681::BitRate(int ch, bool rx) const {
+                const Channel &channel = this->channels[ch];
+                int code = rx ? channel.csr >> 4 : channel.csr & 0x0F;
+                int set = ((this->acr & 0x80) ? 1 : 0) + ((rx ? channel.rxExtended : channel.txExtended) ? 2 : 0);
+                std::uint32_t rate = bitRates[set][code];
+
+                if (code == 0xD && this->ctRunning && CounterSourceHz()) {
+                    // 16x clock from the timer's square wave
+                    rate = static_cast<std::uint32_t>(CounterSourceHz() / (2 * Preload()) / 16);
+                }
+
+                return rate ? rate : DEFAULT_BIT_RATE;
+            }
+
+            std::uint64_t Duart68681::CharacterCycles(int ch, bool rx) const {
+                const Channel &channel = this->channels[ch];
+                int parityMode = (channel.mr1 >> 3) & 0x03;
+
+                // Start bit, data bits, parity (unless "no parity") and stop bits
+                std::uint64_t bits = 1 + 5 + (channel.mr1 & 0x03);
+                bits += parityMode == 2 ? 0 : 1;
+                bits += (channel.mr2 & 0x08) ? 2 : 1;
+
+                return bits * this->scheduler->ClockHz() / BitRate(ch, rx);
+            }
+
+            void Duart68681::StartReceiver(int ch) {
+                Channel &channel = this->channels[ch];
+
+                if (channel.rxEnabled && channel.backend && channel.rxEvent < 0) {
+                    channel.rxEvent = this->scheduler->Schedule(CharacterCycles(ch, true), [this, ch]() { PollReceiver(ch); });
+                }
+            }
+
+            void Duart68681::PollReceiver(int ch) {
+                Channel &channel = this->channels[ch];
+                std::uint64_t next = CharacterCycles(ch, true);
+                std::uint8_t data;
+
+                channel.rxEvent = -1;
+
+                if (!channel.rxEnabled || !channel.backend) {
+                    return;
+                }
+
+                if (channel.rxFifo.size() < RX_FIFO_SIZE) {
+                    if (channel.backend->Receive(data)) {
+                        channel.rxFifo.push_back(data);
+                        UpdateInterrupts();
+                    } else if (next < this->scheduler->CyclesForHz(RX_IDLE_POLL_HZ)) {
+                        next = this->scheduler->CyclesForHz(RX_IDLE_POLL_HZ);
+                    }
+                }
+
+                channel.rxEvent = this->scheduler->Schedule(next, [this, ch]() { PollReceiver(ch); });
+            }
+
+            void Duart68681::Transmit(int ch, std::uint8_t data) {
+                Channel &channel = this->channels[ch];
+
+                if (!channel.txEnabled) {
+                    return;
+                }
+
+                if (channel.txShifting) {
+                    // If the holding register is already full, this overwrites it
+                    channel.txHolding = data;
+                    channel.txHoldingFull = true;
+                } else {
+                    if (channel.backend) {
+                        channel.backend->Send(data);
+                    }
+
+                    channel.txShifting = true;
+                    channel.txEvent = this->scheduler->Schedule(CharacterCycles(ch, false), [this, ch]() { TransmitDone(ch); });
+                }
+
+                UpdateInterrupts();
+            }
+
+            void Duart68681::TransmitDone(int ch) {
+                Channel &channel = this->channels[ch];
+
+                channel.txEvent = -1;
+                channel.txShifting = false;
+
+                if (channel.txHoldingFull) {
+                    channel.txHoldingFull = false;
+                    Transmit(ch, channel.txHolding);
+                } else {
+                    UpdateInterrupts();
+                }
+            }
+
+            std::uint32_t Duart68681::CounterSourceHz() const {
+                switch ((this->acr >> 4) & 0x07) {
+                case 0x3:
+                case 0x7:
+                    return X1_HZ / 16;
+                case 0x6:
+                    return X1_HZ;
+                default:
+                    // IP2 / TxC sources aren't modelled
+                    return 0;
+                }
+            }
+
+            std::uint64_t Duart68681::CounterCycles(std::uint64_t ticks) const {
+                return ticks * this->scheduler->ClockHz() / CounterSourceHz();
+            }
+
+            std::uint64_t Duart68681::CounterTicks() const {
+                std::uint64_t elapsed = this->scheduler->Current() - this->ctStart;
+                return elapsed * CounterSourceHz() / this->scheduler->ClockHz();
+            }
+
+            std::uint16_t Duart68681::CounterValue() const {
+                if (!this->ctRunning || !CounterSourceHz()) {
+                    return this->ctStopped;
+                }
+
+                std::uint64_t ticks = CounterTicks();
+
+                if (TimerMode()) {
+                    // Counts down from the preload twice per square wave cycle
+                    return static_cast<std::uint16_t>(Preload() - ticks % Preload());
+                } else {
+                    return static_cast<std::uint16_t>(this->ctPeriodTicks - ticks);
+                }
+            }
+
+            void Duart68681::StartCounter() {
+                this->ctRunning = true;
+                this->ctStart = this->scheduler->Current();
+                this->ctPeriodTicks = TimerMode() ? 2 * Preload() : Preload();
+                ScheduleCounter();
+            }
+
+            void Duart68681::StopCounter() {
+                // In timer mode this only clears the interrupt; the timer keeps going
+                if (!TimerMode() && this->ctRunning) {
+                    this->ctStopped = CounterValue();
+                    this->ctRunning = false;
+                    CancelEvent(this->ctEvent);
+                }
+
+                this->ctReady = false;
+                UpdateInterrupts();
+            }
+
+            void Duart68681::ScheduleCounter() {
+                CancelEvent(this->ctEvent);
+
+                if (!this->ctRunning || !CounterSourceHz()) {
+                    return;
+                }
+
+                std::uint64_t deadline = this->ctStart + CounterCycles(this->ctPeriodTicks);
+                std::uint64_t now = this->scheduler->Current();
+
+                this->ctEvent = this->scheduler->Schedule(deadline > now ? deadline - now : 0, [this]() { CounterExpired(); });
+            }
+
+            void Duart68681::CounterExpired() {
+                this->ctEvent = -1;
+
+                // Start the next period from the exact end of this one. The timer
+                // reloads the (possibly new) preload, the counter wraps to 0xFFFF.
+                this->ctStart += CounterCycles(this->ctPeriodTicks);
+                this->ctPeriodTicks = TimerMode() ? 2 * Preload() : 0x10000;
+                this->ctReady = true;
+
+                UpdateInterrupts();
+                ScheduleCounter();
+            }
+
+            void Duart68681::CancelEvent(int &event) {
+                if (event >= 0) {
+                    this->scheduler->Cancel(event);
+                    event = -1;
+                }
+            }
+
+            void Duart68681::UpdateInterrupts() {
+                bool asserted = (InterruptStatus() & this->imr) != 0;
+
+                if (asserted != this->irqAsserted) {
+                    this->irqAsserted = asserted;
+
+                    if (this->irq) {
+                        this->irq(asserted);
+                    }
+                }
+            }
+        }
+    }
+}
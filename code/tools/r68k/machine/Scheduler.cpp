@@ -0,0 +1,132 @@
+#include <thread>
+#include "Scheduler.h"
+
+// Don't bother sleeping for less than this, the host can't do it accurately anyway
+#define MIN_THROTTLE_SLEEP std::chrono::milliseconds(2)
+// If we fall further behind than this (e.g. blocked in a trap waiting for input)
+// just let it go rather than racing to catch up
+#define MAX_THROTTLE_LAG   std::chrono::milliseconds(100)
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            Scheduler::Scheduler(std::uint32_t clockHz, bool throttle) {
+                this->clockHz = clockHz;
+                this->throttle = throttle;
+                this->now = 0;
+                this->hostStart = std::chrono::steady_clock::now();
+                this->inSlice = false;
+                this->sliceEnd = 0;
+            }
+
+            std::uint64_t Scheduler::Current() const {
+                if (this->inSlice && this->sliceElapsed) {
+                    return this->now + this->sliceElapsed();
+                }
+
+                return this->now;
+            }
+
+            int Scheduler::Schedule(std::uint64_t delay, Callback callback, std::uint64_t period) {
+                Event event = { Current() + delay, period, callback, true };
+
+                if (this->inSlice && event.deadline < this->sliceEnd) {
+                    EndSlice();
+                }
+
+                for (std::size_t i = 0; i < this->events.size(); i++) {
+                    if (!this->events[i].active) {
+                        this->events[i] = event;
+                        return static_cast<int>(i);
+                    }
+                }
+
+                this->events.push_back(event);
+                return static_cast<int>(this->events.size() - 1);
+            }
+
+            void Scheduler::Cancel(int id) {
+                if (id >= 0 && static_cast<std::size_t>(id) < this->events.size()) {
+                    this->events[id].active = false;
+                    this->events[id].callback = nullptr;
+                }
+            }
+
+            std::uint64_t Scheduler::CyclesUntilNextEvent(std::uint64_t limit) const {
+                std::uint64_t result = limit;
+
+                for (const Event &event : this->events) {
+                    if (event.active) {
+                        std::uint64_t due = event.deadline > this->now ? event.deadline - this->now : 0;
+                        if (due < result) {
+                            result = due;
+                        }
+                    }
+                }
+
+                return result;
+            }
+
+            void Scheduler::SetSliceHooks(SliceElapsed elapsed, SliceEnd end) {
+                this->sliceElapsed = elapsed;
+                this->sliceEndHook = end;
+            }
+
+            std::uint64_t Scheduler::BeginSlice(std::uint64_t limit) {
+                std::uint64_t cycles = CyclesUntilNextEvent(limit);
+
+                if (cycles == 0) {
+                    cycles = 1;
+                }
+
+                this->inSlice = true;
+                this->sliceEnd = this->now + cycles;
+                return cycles;
+            }
+
+            void Scheduler::EndSlice() {
+                if (this->inSlice && this->sliceEndHook) {
+                    this->sliceEndHook();
+                }
+            }
+
+            void Scheduler::Advance(std::uint64_t cycles) {
+                this->inSlice = false;
+                this->now += cycles;
+
+                // Callbacks may schedule or cancel, so index rather than iterate,
+                // and don't hold references across the call.
+                for (std::size_t i = 0; i < this->events.size(); i++) {
+                    while (this->events[i].active && this->events[i].deadline <= this->now) {
+                        Callback callback = this->events[i].callback;
+
+                        if (this->events[i].period) {
+                            this->events[i].deadline += this->events[i].period;
+                        } else {
+                            this->events[i].active = false;
+                        }
+
+                        callback();
+                    }
+                }
+
+                if (this->throttle) {
+                    Throttle();
+                }
+            }
+
+            void Scheduler::Throttle() {
+                // Split to avoid overflow on long runs
+                std::chrono::nanoseconds emulated((this->now / this->clockHz) * 1000000000ULL
+                        + (this->now % this->clockHz) * 1000000000ULL / this->clockHz);
+                std::chrono::nanoseconds host = std::chrono::steady_clock::now() - this->hostStart;
+
+                if (emulated - host >= MIN_THROTTLE_SLEEP) {
+                    std::this_thread::sleep_for(emulated - host);
+                } else if (host - emulated > MAX_THROTTLE_LAG) {
+                    this->hostStart += host - emulated;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "SerialBackend.h"
+
+namespace rosco {
+    namespace m68k {
+        namespace emu {
+            bool StdioSerial::Receive(std::uint8_t &data) {
+                return read(STDIN_FILENO, &data, 1) == 1;
+            }
+
+            void StdioSerial::Send(std::uint8_t data) {
+                (void)!write(STDOUT_FILENO, &data, 1);
+            }
+
+            PtySerial::PtySerial() {
+                this->fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+                if (this->fd < 0) {
+                    return;
+                }
+
+                if (grantpt(this->fd) < 0 || unlockpt(this->fd) < 0 || ptsname(this->fd) == NULL) {
+                    close(this->fd);
+                    this->fd = -1;
+                    return;
+                }
+
+                this->name = ptsname(this->fd);
+
+                // Raw, so binary transfers (e.g. Kermit) get through untouched
+                struct termios tio;
+                if (tcgetattr(this->fd, &tio) == 0) {
+                    cfmakeraw(&tio);
+                    tcsetattr(this->fd, TCSANOW, &tio);
+                }
+
+                fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL, 0) | O_NONBLOCK);
+            }
+
+            PtySerial::~PtySerial() {
+                if (this->fd >= 0) {
+                    close(this->fd);
+                }
+            }
+
+            bool PtySerial::Receive(std::uint8_t &data) {
+                return this->fd >= 0 && read(this->fd, &data, 1) == 1;
+            }
+
+            void PtySerial::Send(std::uint8_t data) {
+                // Drop output while nothing has the other end open
+                if (this->fd >= 0) {
+                    (void)!write(this->fd, &data, 1);
+                }
+            }
+        }
+    }
+}
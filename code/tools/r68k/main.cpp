@@ -2,17 +2,22 @@
 #include <filesystem>
 #include <stdint.h>
 #include <unistd.h>
-#include <thread>
-#include <atomic>
+#include <getopt.h>
 #include <termios.h>
 #include <sys/select.h>
 #include <fcntl.h>
 #include <iomanip>
 #include <vector>
+#include <chrono>
+#include <cstring>
 
 #include "musashi/m68k.h"
 #include "musashi/m68kcpu.h"
 #include "AddressDecoder.h"
+#include "DiskImage.h"
+#include "Duart68681.h"
+#include "SerialBackend.h"
+#include "Scheduler.h"
 
 using namespace std;
 
@@ -24,8 +29,26 @@ using namespace std;
 #define PROMPT_ON  0x411
 #define LF_DISPLAY 0x412
 
+#define TICK_HZ           100
+#define DEFAULT_CLOCK_MHZ 10
+#define MAX_SLICE_CYCLES  100000
+
 struct termios originalTermios;
 
+// Emulated DUART (--duart), NULL if not in use
+static rosco::m68k::emu::Duart68681 *duart = NULL;
+
+// Set by the exit traps, checked by the main loop
+static bool exit_requested = false;
+static int exit_code = 0;
+
+static void request_exit(int code) {
+    m68k_pulse_halt();
+    m68k_end_timeslice();
+    exit_requested = true;
+    exit_code = code;
+}
+
 void init_term() {
     struct termios newTermios;
 
@@ -97,7 +120,67 @@ static char* print_unsigned(uint32_t num, uint8_t base) {
 
 extern "C" {
     rosco::m68k::emu::AddressDecoder* sys_mem;
-    std::fstream ifs("rosco_sd.bin", std::ios::binary | std::ios::ate | std::ios::in | std::ios::out);
+    bool decode_cache_enabled = true;
+    rosco::m68k::emu::DiskImage sd_image("rosco_sd.bin");
+
+    // Block transfers for the SD traps. a1 is the firmware's SD card struct,
+    // which must have been initialized by sd_init. A count of zero does
+    // nothing and succeeds - callers use it to check the traps are there.
+    static bool sd_read_blocks(uint32_t a1, uint32_t a2, uint32_t lba, uint32_t count) {
+        if (!sd_image.IsOpen() || m68k_read_memory_8(a1) == 0) {
+            cout << "!!! Not init" << endl;
+#ifdef DEBUG_LOG_IO
+            cerr << "!!! Not init" << endl;
+#endif
+            return false;
+        }
+
+        if (count == 0) {
+            return true;
+        }
+
+#ifdef DEBUG_LOG_IO
+        cerr << "READ " << hex << lba*512 << " x " << dec << count << endl;
+#endif
+
+        if (!sd_image.ReadBlocks(lba, count, sys_mem, a2)) {
+            cout << "!!! Bad Read" << endl;
+#ifdef DEBUG_LOG_IO
+            cerr << "!!! Bad Read" << endl;
+#endif
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool sd_write_blocks(uint32_t a1, uint32_t a2, uint32_t lba, uint32_t count) {
+        if (a2 >= 0xe00000 || !sd_image.IsOpen() || m68k_read_memory_8(a1) == 0) {
+            cout << "!!! Not init or out of bounds" << endl;
+#ifdef DEBUG_LOG_IO
+            cerr << "!!! Not init or out of bounds" << endl;
+#endif
+            return false;
+        }
+
+        if (count == 0) {
+            return true;
+        }
+
+#ifdef DEBUG_LOG_IO
+        cerr << "WRITE " << hex << lba*512 << " x " << dec << count << endl;
+#endif
+
+        if (!sd_image.WriteBlocks(lba, count, sys_mem, a2)) {
+            cout << "!!! Bad Write" << endl;
+#ifdef DEBUG_LOG_IO
+            cerr << "!!! Bad Write" << endl;
+#endif
+            return false;
+        }
+
+        return true;
+    }
 
     int illegal_instruction_handler(int __attribute__((unused)) opcode) {
         m68ki_cpu_core ctx;
@@ -165,9 +248,7 @@ extern "C" {
                     break;
                 case 3:
                     // prog_exit
-                    m68k_pulse_halt();
-                    tcsetattr(STDIN_FILENO, TCSANOW, &originalTermios);
-                    exit(m68k_read_memory_32(a7 + 4));       // assuming called from cstdlib - C will have stacked an exit code
+                    request_exit(m68k_read_memory_32(a7 + 4));       // assuming called from cstdlib - C will have stacked an exit code
                     break;
                 case 4:
                     // check_char
@@ -184,7 +265,7 @@ extern "C" {
                     break;
                 case 6:
                     // sd_init
-                    if (!ifs) {
+                    if (!sd_image.IsOpen()) {
                         m68k_set_reg(M68K_REG_D0, 1);
                     } else {
                         m68k_write_memory_8(a1+0, 1);		// Initialized
@@ -198,72 +279,19 @@ extern "C" {
                     break;
                 case 7:
                     // sd_read
-                    if (ifs && m68k_read_memory_8(a1) > 0) {
-                        std::vector<char> buf(512);
-
-                        ifs.clear();
-                        ifs.seekg(d1 * 512, std::ios::beg);
-                        ifs.read(&buf.front(), 512);
-#ifdef DEBUG_LOG_IO
-                        cerr << "READ " << hex << d1*512 << endl;
-#endif
-
-                        if (ifs.gcount() == 512) {
-                            for (auto data : buf) {
-                                m68k_write_memory_8(a2++, data);
-                            }
-
-                            m68k_set_reg(M68K_REG_D0, 1);		    // succeed
-                        } else {
-                            cout << "!!! Bad Read" << endl;
-#ifdef DEBUG_LOG_IO
-                            cerr << "!!! Bad Read" << endl;
-#endif
-                            m68k_set_reg(M68K_REG_D0, 0);		// fail
-                        }
-                    } else {						
-                        cout << "!!! Not init" << endl;
-#ifdef DEBUG_LOG_IO
-                        cerr << "!!! Not init" << endl;
-#endif
-                        m68k_set_reg(M68K_REG_D0, 0);		// fail
-                    }
-
+                    m68k_set_reg(M68K_REG_D0, sd_read_blocks(a1, a2, d1, 1) ? 1 : 0);
                     break;
                 case 8:
                     // sd_write
-                    if (a2 < 0xe00000 && ifs && m68k_read_memory_8(a1) > 0) {
-                        std::vector<char> buf(512);
-
-                        for (int i = 0; i < 512; i++) {
-                            buf[i] = m68k_read_memory_8(a2++);
-                        }
-
-                        ifs.clear();
-                        ifs.seekg(d1 * 512, std::ios::beg);
-                        ifs.write(&buf.front(), 512);
-
-#ifdef DEBUG_LOG_IO
-                        cerr << "WRITE " << hex << d1*512 << endl;
-#endif
-
-                        if (ifs.gcount() == 512) {
-                            m68k_set_reg(M68K_REG_D0, 1);		    // succeed
-                        } else {
-                            cout << "!!! Bad Write" << endl;
-#ifdef DEBUG_LOG_IO
-                            cerr << "!!! Bad Write" << endl;
-#endif
-                            m68k_set_reg(M68K_REG_D0, 0);		// fail
-                        }
-                    } else {						
-                        cout << "!!! Not init or out of bounds" << endl;
-#ifdef DEBUG_LOG_IO
-                        cerr << "!!! Not init or out of bounds" << endl;
-#endif
-                        m68k_set_reg(M68K_REG_D0, 0);		// fail
-                    }
-
+                    m68k_set_reg(M68K_REG_D0, sd_write_blocks(a1, a2, d1, 1) ? 1 : 0);
+                    break;
+                case 9:
+                    // sd_read_blocks
+                    m68k_set_reg(M68K_REG_D0, sd_read_blocks(a1, a2, d1, d2) ? 1 : 0);
+                    break;
+                case 10:
+                    // sd_write_blocks
+                    m68k_set_reg(M68K_REG_D0, sd_write_blocks(a1, a2, d1, d2) ? 1 : 0);
                     break;
                 // Start of Easy68k traps
                 case 0xD0:
@@ -377,9 +405,7 @@ extern "C" {
                     break;
                 case 0xD9:
                     // TERMINATE
-                    m68k_pulse_halt();
-                    tcsetattr(STDIN_FILENO, TCSANOW, &originalTermios);
-                    exit(0);
+                    request_exit(0);
 
                     break;
                 // case 0xDA:
@@ -507,7 +533,12 @@ extern "C" {
     int interrupt_ack_handler(unsigned int irq) {
         switch (irq) {
         case DUART_IRQ:
-            // DUART timer tick - vector to 0x45
+            if (duart) {
+                // Level triggered - stays asserted until the cause is cleared
+                return duart->Vector();
+            }
+
+            // Generated timer tick - vector to 0x45
             m68k_set_irq(0);
             return DUART_VEC;
         default:
@@ -517,24 +548,169 @@ extern "C" {
     }
 }
 
-std::atomic_bool is_done;
+// Names for the opcode groups (top 4 bits of the opcode word) in bench reports
+static const char *opcode_group_names[16] = {
+    "bitop_movep_immediate", "move_b", "move_l", "move_w",
+    "misc", "addq_subq_scc_dbcc", "bcc_bsr_bra", "moveq",
+    "or_div_sbcd", "sub_subx", "line_a", "cmp_eor",
+    "and_mul_abcd_exg", "add_addx", "shift_rotate", "line_f"
+};
+
+static const struct {
+    const char *name;
+    unsigned int type;
+} cpu_types[] = {
+    { "68000", M68K_CPU_TYPE_68000 },
+    { "68010", M68K_CPU_TYPE_68010 },
+    { "68020", M68K_CPU_TYPE_68020 },
+    { "68030", M68K_CPU_TYPE_68030 },
+    { "68040", M68K_CPU_TYPE_68040 },
+};
+
+static void write_bench_report(std::ostream &out, const char *binary, const char *cpu, int clock_mhz,
+                               uint64_t cycle_limit, uint64_t cycles, double wall_seconds) {
+    uint64_t instructions = 0;
+    for (int i = 0; i < 16; i++) {
+        instructions += m68k_get_instruction_count(i);
+    }
 
-void timer_interrupt() {
-    int i = 100;
+    unsigned long long atc_hits, atc_misses;
+    m68k_get_pmmu_atc_stats(&atc_hits, &atc_misses);
 
-    while (!is_done) {
-        if (i++ == 100) {
-            m68k_set_irq(DUART_IRQ);
-            i = 0;
+    out << "{" << endl;
+    out << "  \"binary\": \"";
+    for (const char *c = binary; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
         }
-
-        usleep(100);
+        out << *c;
     }
+    out << "\"," << endl;
+    out << "  \"cpu\": \"" << cpu << "\"," << endl;
+    out << "  \"clock_mhz\": " << clock_mhz << "," << endl;
+    out << "  \"cycle_limit\": " << cycle_limit << "," << endl;
+    out << "  \"exit_reason\": \"" << (exit_requested ? "prog_exit" : "cycle_limit") << "\"," << endl;
+    out << "  \"exit_code\": " << exit_code << "," << endl;
+    out << "  \"wall_seconds\": " << fixed << setprecision(6) << wall_seconds << "," << endl;
+    out << "  \"cycles\": " << cycles << "," << endl;
+    out << "  \"instructions\": " << instructions << "," << endl;
+    out << "  \"effective_mhz\": " << setprecision(3) << (wall_seconds > 0 ? cycles / wall_seconds / 1e6 : 0) << "," << endl;
+    out << "  \"mips\": " << (wall_seconds > 0 ? instructions / wall_seconds / 1e6 : 0) << "," << endl;
+    out << "  \"pmmu_atc\": { \"hits\": " << atc_hits << ", \"misses\": " << atc_misses << " }," << endl;
+    out << "  \"opcode_groups\": {" << endl;
+    for (int i = 0; i < 16; i++) {
+        out << "    \"" << opcode_group_names[i] << "\": " << m68k_get_instruction_count(i) << (i < 15 ? "," : "") << endl;
+    }
+    out << "  }" << endl;
+    out << "}" << endl;
+}
+
+static void usage() {
+    cout << "Usage: r68k [options] <binary>" << endl
+         << endl
+         << "  -p, --cpu=TYPE      CPU to emulate: 68000, 68010, 68020, 68030 or 68040 (default 68010)" << endl
+         << "  -c, --clock=MHZ     Emulated CPU clock in MHz (e.g. 8, 10, 12, 20; default " << DEFAULT_CLOCK_MHZ << ")" << endl
+         << "  -t, --throttle      Throttle emulation to real time at the given clock" << endl
+         << "                      (default is to run as fast as possible)" << endl
+         << "  -b, --bench[=FILE]  Benchmark mode: write a JSON report of emulation speed" << endl
+         << "                      to FILE (default stderr) when the program exits" << endl
+         << "  -n, --cycles=N      Stop after N emulated cycles (default: run until exit)" << endl
+         << "  -u, --duart[=HOST]  Emulate a 68681 DUART, with port A connected to HOST:" << endl
+         << "                      stdio (default) or pty. The DUART timer then provides" << endl
+         << "                      the system tick" << endl
+         << "      --duart-base=BOARD" << endl
+         << "                      Where the DUART is mapped: mbr2 (r2.x mainboard, 0x"
+         << hex << rosco::m68k::emu::Duart68681::BASE_MBR2 << ", default)" << endl
+         << "                      or r2 (r2 DUART board, 0x" << rosco::m68k::emu::Duart68681::BASE_R2 << dec << ")" << endl
+         << "  -D, --no-decode-cache" << endl
+         << "                      Don't cache decoded instructions (slower, for comparison)" << endl;
 }
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        cout << "Usage: r68k <binary>" << endl;
+    static struct option long_options[] = {
+        { "cpu",      required_argument, NULL, 'p' },
+        { "clock",    required_argument, NULL, 'c' },
+        { "throttle", no_argument,       NULL, 't' },
+        { "bench",    optional_argument, NULL, 'b' },
+        { "cycles",   required_argument, NULL, 'n' },
+        { "no-decode-cache", no_argument, NULL, 'D' },
+        { "duart",    optional_argument, NULL, 'u' },
+        { "duart-base", required_argument, NULL, 'U' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL,       0,                 NULL, 0   }
+    };
+
+    const char *cpu = "68010";
+    unsigned int cpu_type = M68K_CPU_TYPE_68010;
+    int clock_mhz = DEFAULT_CLOCK_MHZ;
+    bool throttle = false;
+    bool bench = false;
+    const char *bench_file = NULL;
+    uint64_t cycle_limit = 0;
+    const char *duart_host = NULL;
+    uint32_t duart_base = rosco::m68k::emu::Duart68681::BASE_MBR2;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "p:c:tb::n:Du::h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'p':
+            cpu = NULL;
+            for (auto &t : cpu_types) {
+                if (strcmp(optarg, t.name) == 0) {
+                    cpu = t.name;
+                    cpu_type = t.type;
+                }
+            }
+            if (!cpu) {
+                cerr << "Unsupported CPU: " << optarg << endl;
+                return 1;
+            }
+            break;
+        case 'c':
+            clock_mhz = atoi(optarg);
+            if (clock_mhz <= 0) {
+                cerr << "Bad clock speed: " << optarg << endl;
+                return 1;
+            }
+            break;
+        case 't':
+            throttle = true;
+            break;
+        case 'b':
+            bench = true;
+            bench_file = optarg;
+            break;
+        case 'n':
+            cycle_limit = strtoull(optarg, NULL, 0);
+            break;
+        case 'D':
+            decode_cache_enabled = false;
+            break;
+        case 'u':
+            duart_host = optarg ? optarg : "stdio";
+            if (strcmp(duart_host, "stdio") != 0 && strcmp(duart_host, "pty") != 0) {
+                cerr << "Unsupported DUART host connection: " << duart_host << endl;
+                return 1;
+            }
+            break;
+        case 'U':
+            if (strcmp(optarg, "mbr2") == 0) {
+                duart_base = rosco::m68k::emu::Duart68681::BASE_MBR2;
+            } else if (strcmp(optarg, "r2") == 0) {
+                duart_base = rosco::m68k::emu::Duart68681::BASE_R2;
+            } else {
+                cerr << "Unsupported DUART base: " << optarg << endl;
+                return 1;
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage();
         return 1;
     } else {
         init_term();
@@ -543,25 +719,80 @@ int main(int argc, char** argv) {
         path += "/firmware/rosco_m68k.rom";
 
         sys_mem = new rosco::m68k::emu::AddressDecoder(0x40000, 0x100000, path.string().c_str());
-        sys_mem->LoadMemoryFile(0x40000, argv[1]);
+        sys_mem->LoadMemoryFile(0x40000, argv[optind]);
+        sys_mem->SetWatchCallback(m68k_decode_cache_invalidate);
 
-        m68k_set_cpu_type(M68K_CPU_TYPE_68010);
+        m68k_set_cpu_type(cpu_type);
         m68k_init();
         m68k_pulse_reset();
 
-        m68ki_cpu_core ctx;
-        m68k_get_context(&ctx);
-        
-        std::thread timer_thread(timer_interrupt);
-        while (1) {
-            m68k_execute(100000);
-            m68k_get_context(&ctx);
+        rosco::m68k::emu::Scheduler scheduler(clock_mhz * 1000000, throttle);
+
+        // Let devices time events from (and cut short) the slice in progress
+        scheduler.SetSliceHooks([]() { return static_cast<uint64_t>(m68k_cycles_run()); },
+                                []() { m68k_end_timeslice(); });
+
+        std::unique_ptr<rosco::m68k::emu::SerialBackend> duart_backend;
+
+        if (duart_host) {
+            if (strcmp(duart_host, "pty") == 0) {
+                rosco::m68k::emu::PtySerial *pty = new rosco::m68k::emu::PtySerial();
+                duart_backend.reset(pty);
+
+                if (!pty->IsOpen()) {
+                    tcsetattr(STDIN_FILENO, TCSANOW, &originalTermios);
+                    cerr << "Failed to open a pty for the DUART" << endl;
+                    return 1;
+                }
+
+                cerr << "DUART port A is on " << pty->Name() << endl;
+            } else {
+                duart_backend.reset(new rosco::m68k::emu::StdioSerial());
+            }
+
+            duart = new rosco::m68k::emu::Duart68681(duart_base, &scheduler, [&scheduler](bool asserted) {
+                m68k_set_irq(asserted ? DUART_IRQ : 0);
+                if (asserted) {
+                    // Take it at the next instruction, not the end of the slice
+                    scheduler.EndSlice();
+                }
+            });
+            duart->Attach(0, duart_backend.get());
+            sys_mem->MapDevice(duart_base, rosco::m68k::emu::Duart68681::SIZE, duart);
+        } else {
+            // System tick, as the firmware would set up on the DUART / MFP timer
+            uint64_t tick_cycles = scheduler.CyclesForHz(TICK_HZ);
+            scheduler.Schedule(tick_cycles, []() { m68k_set_irq(DUART_IRQ); }, tick_cycles);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        while (!exit_requested && (cycle_limit == 0 || scheduler.Now() < cycle_limit)) {
+            uint64_t limit = MAX_SLICE_CYCLES;
+            if (cycle_limit != 0 && cycle_limit - scheduler.Now() < limit) {
+                limit = cycle_limit - scheduler.Now();
+            }
+
+            int slice = static_cast<int>(scheduler.BeginSlice(limit));
+            scheduler.Advance(m68k_execute(slice));
         }
 
-        is_done = true;
-        timer_thread.join();
+        std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+        tcsetattr(STDIN_FILENO, TCSANOW, &originalTermios);
+        cout << flush;
+
+        if (bench) {
+            if (bench_file) {
+                std::ofstream out(bench_file);
+                write_bench_report(out, argv[optind], cpu, clock_mhz, cycle_limit, scheduler.Now(), wall.count());
+            } else {
+                write_bench_report(cerr, argv[optind], cpu, clock_mhz, cycle_limit, scheduler.Now(), wall.count());
+            }
+        }
 
+        delete(duart);
         delete(sys_mem);
-        return 0;
+        return exit_code;
     }
 }
@@ -328,6 +328,26 @@ int m68k_execute(int num_cycles);
  */
 int m68k_cycles_run(void);              /* Number of cycles run so far */
 int m68k_cycles_remaining(void);        /* Number of cycles left */
+
+/* Number of instructions executed since reset in the given opcode group
+ * (the top 4 bits of the opcode word, 0-15).  Always zero unless
+ * M68K_COUNT_INSTRUCTIONS is enabled in m68kconf.h.
+ */
+unsigned long long m68k_get_instruction_count(unsigned int group);
+
+/* Tell the CPU that memory at address has been written, so any decoded
+ * instructions cached for its page must be dropped.  Only needed if
+ * M68K_DECODE_CACHE is enabled, for pages the host agreed to cache.
+ */
+void m68k_decode_cache_invalidate(unsigned int address);
+
+/* Drop all cached decoded instructions. */
+void m68k_decode_cache_flush(void);
+
+/* PMMU address translation cache hits and misses since reset.  The ATC
+ * is only used while the PMMU is enabled (M68K_EMULATE_PMMU, 68030/040).
+ */
+void m68k_get_pmmu_atc_stats(unsigned long long *hits, unsigned long long *misses);
 void m68k_modify_timeslice(int cycles); /* Modify cycles left */
 void m68k_end_timeslice(void);          /* End timeslice now */
 
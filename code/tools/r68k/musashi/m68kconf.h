@@ -33,6 +33,7 @@
 #define M68KCONF__HEADER
 
 int interrupt_ack_handler(unsigned int);
+int decode_cache_page_handler(unsigned int);
 
 /* Configuration switches.
  * Use OPT_SPECIFY_HANDLER for configuration options that allow callbacks.
@@ -166,6 +167,39 @@ int interrupt_ack_handler(unsigned int);
 #define M68K_INSTRUCTION_CALLBACK(pc) your_instruction_hook_function(pc)
 
 
+/* If ON, the CPU will snapshot D0-D7/A0-A7 before every instruction so that
+ * a bus error raised with m68k_pulse_bus_error() can roll back any registers
+ * the faulting instruction had already changed.  This costs a 64-byte copy
+ * on every instruction, so turn it OFF if the host never raises bus errors
+ * (r68k's AddressDecoder just returns 0 for unmapped addresses).  With it
+ * OFF, m68k_pulse_bus_error() still takes the exception, but registers are
+ * left as the faulting instruction left them.
+ */
+#define M68K_EMULATE_BUS_ERROR      OPT_OFF
+
+
+/* If ON, the CPU will count executed instructions by opcode group (the top
+ * 4 bits of the opcode word).  Read the counts with
+ * m68k_get_instruction_count().
+ */
+#define M68K_COUNT_INSTRUCTIONS     OPT_ON
+
+
+/* If ON, the CPU keeps a cache of decoded opcodes (handler, opcode word and
+ * cycle count) for each page of code it runs, so loops don't have to fetch
+ * and look up every opcode again each time round.  Only used while the PMMU
+ * is disabled, and can't be used with prefetch or address error emulation.
+ *
+ * The host MUST call m68k_decode_cache_invalidate() when memory in a cached
+ * page is written (by the CPU or otherwise).  With OPT_SPECIFY_HANDLER, the
+ * CPU calls M68K_DECODE_CACHE_PAGE_CALLBACK(address) before it starts caching
+ * a page; the host returns non-zero if it will report writes to that page,
+ * or zero to leave the page uncached.  With OPT_ON every page is cached.
+ */
+#define M68K_DECODE_CACHE           OPT_SPECIFY_HANDLER
+#define M68K_DECODE_CACHE_PAGE_CALLBACK(A)  decode_cache_page_handler(A)
+
+
 /* If ON, the CPU will emulate the 4-byte prefetch queue of a real 68000 */
 #define M68K_EMULATE_PREFETCH       OPT_OFF
 
@@ -45,6 +45,7 @@ extern unsigned char m68ki_cycles[][0x10000];
 extern void (*m68ki_instruction_jump_table[0x10000])(void); /* opcode handler jump table */
 extern void m68ki_build_opcode_table(void);
 
+#include <stdlib.h>
 #include "m68kops.h"
 #include "m68kcpu.h"
 
@@ -94,6 +95,59 @@ uint    m68ki_aerr_fc;
 
 jmp_buf m68ki_bus_error_jmp_buf;
 
+#if M68K_DECODE_CACHE
+/* Decoded opcode cache. Each page of code gets an array of entries, one per
+ * word, allocated when the CPU first executes from it.  This lives outside
+ * m68ki_cpu, like the jump table, so it's shared by all contexts.
+ */
+#define DECODE_PAGE_SHIFT   12
+#define DECODE_PAGE_SIZE    (1 << DECODE_PAGE_SHIFT)
+#define DECODE_PAGE_COUNT   (1 << (32 - DECODE_PAGE_SHIFT))
+
+/* Pages invalidated more often than this are probably mixing code and data,
+ * so stop caching them rather than thrash.
+ */
+#define DECODE_PAGE_MAX_INVALIDATIONS 16
+#define DECODE_PAGE_UNCACHEABLE       0x80
+
+typedef struct
+{
+	void (*handler)(void);  /* NULL if not decoded yet */
+	uint16 ir;
+	uint8 cycles;
+} m68ki_decoded_instr;
+
+static m68ki_decoded_instr *m68ki_decode_pages[DECODE_PAGE_COUNT];
+static uint8 m68ki_decode_page_flags[DECODE_PAGE_COUNT];
+
+/* Find the cache entry for the opcode at pc, setting up the page if needed.
+ * Returns NULL if the page can't be cached.
+ */
+static inline m68ki_decoded_instr *m68ki_decode_cache_entry(uint pc)
+{
+	uint page = pc >> DECODE_PAGE_SHIFT;
+	m68ki_decoded_instr *entries = m68ki_decode_pages[page];
+
+	if (!entries)
+	{
+		if ((m68ki_decode_page_flags[page] & DECODE_PAGE_UNCACHEABLE) ||
+			!m68ki_decode_cache_page(page << DECODE_PAGE_SHIFT))
+		{
+			m68ki_decode_page_flags[page] |= DECODE_PAGE_UNCACHEABLE;
+			return NULL;
+		}
+
+		entries = calloc(DECODE_PAGE_SIZE / 2, sizeof(m68ki_decoded_instr));
+		if (!entries)
+			return NULL;
+
+		m68ki_decode_pages[page] = entries;
+	}
+
+	return &entries[(pc & (DECODE_PAGE_SIZE - 1)) >> 1];
+}
+#endif /* M68K_DECODE_CACHE */
+
 /* Used by shift & rotate instructions */
 const uint8 m68ki_shift_8_table[65] =
 {
@@ -779,6 +833,9 @@ void m68k_set_instr_hook_callback(void  (*callback)(unsigned int pc))
 /* Set the CPU type. */
 void m68k_set_cpu_type(unsigned int cpu_type)
 {
+	/* Cached cycle counts are per CPU type */
+	m68k_decode_cache_flush();
+
 	switch(cpu_type)
 	{
 		case M68K_CPU_TYPE_68000:
@@ -972,7 +1029,6 @@ int m68k_execute(int num_cycles)
 		/* Main loop.  Keep going until we run out of clock cycles */
 		do
 		{
-			int i;
 			/* Set tracing accodring to T1. (T0 is done inside instruction) */
 			m68ki_trace_t1(); /* auto-disable (see m68kcpu.h) */
 
@@ -986,14 +1042,50 @@ int m68k_execute(int num_cycles)
 			REG_PPC = REG_PC;
 
 			/* Record previous D/A register state (in case of bus error) */
-			for (i = 15; i >= 0; i--){
-				REG_DA_SAVE[i] = REG_DA[i];
+			m68ki_save_da_regs(); /* auto-disable (see m68kcpu.h) */
+
+#if M68K_DECODE_CACHE
+			m68ki_decoded_instr *decoded = NULL;
+
+			if (!PMMU_ENABLED && !(REG_PC & 1))
+				decoded = m68ki_decode_cache_entry(ADDRESS_68K(REG_PC));
+
+			if (decoded)
+			{
+				/* Copy out first: the handler may write to (and so free) this page */
+				void (*handler)(void);
+				uint cycles;
+
+				if (!decoded->handler)
+				{
+					REG_IR = m68ki_read_imm_16();
+					decoded->ir = REG_IR;
+					decoded->handler = m68ki_instruction_jump_table[REG_IR];
+					decoded->cycles = CYC_INSTRUCTION[REG_IR];
+				}
+				else
+				{
+					REG_IR = decoded->ir;
+					REG_PC += 2;
+				}
+
+				handler = decoded->handler;
+				cycles = decoded->cycles;
+
+				handler();
+				USE_CYCLES(cycles);
+			}
+			else
+#endif /* M68K_DECODE_CACHE */
+			{
+				/* Read an instruction and call its handler */
+				REG_IR = m68ki_read_imm_16();
+				m68ki_instruction_jump_table[REG_IR]();
+				USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
 			}
 
-			/* Read an instruction and call its handler */
-			REG_IR = m68ki_read_imm_16();
-			m68ki_instruction_jump_table[REG_IR]();
-			USE_CYCLES(CYC_INSTRUCTION[REG_IR]);
+			/* Count it, if we're counting */
+			m68ki_count_instruction(); /* auto-disable (see m68kcpu.h) */
 
 			/* Trace m68k_exception, if necessary */
 			m68ki_exception_if_trace(); /* auto-disable (see m68kcpu.h) */
@@ -1020,6 +1112,52 @@ int m68k_cycles_remaining(void)
 	return GET_CYCLES();
 }
 
+unsigned long long m68k_get_instruction_count(unsigned int group)
+{
+	return group < 16 ? m68ki_cpu.instr_count[group] : 0;
+}
+
+void m68k_decode_cache_invalidate(unsigned int address)
+{
+#if M68K_DECODE_CACHE
+	uint page = ADDRESS_68K(address) >> DECODE_PAGE_SHIFT;
+
+	if (m68ki_decode_pages[page])
+	{
+		free(m68ki_decode_pages[page]);
+		m68ki_decode_pages[page] = NULL;
+
+		if (++m68ki_decode_page_flags[page] >= DECODE_PAGE_MAX_INVALIDATIONS)
+			m68ki_decode_page_flags[page] |= DECODE_PAGE_UNCACHEABLE;
+	}
+#else
+	(void)address;
+#endif /* M68K_DECODE_CACHE */
+}
+
+void m68k_decode_cache_flush(void)
+{
+#if M68K_DECODE_CACHE
+	uint page;
+
+	for (page = 0; page < DECODE_PAGE_COUNT; page++)
+	{
+		if (m68ki_decode_pages[page])
+		{
+			free(m68ki_decode_pages[page]);
+			m68ki_decode_pages[page] = NULL;
+		}
+		m68ki_decode_page_flags[page] = 0;
+	}
+#endif /* M68K_DECODE_CACHE */
+}
+
+void m68k_get_pmmu_atc_stats(unsigned long long *hits, unsigned long long *misses)
+{
+	if (hits) *hits = m68ki_cpu.mmu_atc_hits;
+	if (misses) *misses = m68ki_cpu.mmu_atc_misses;
+}
+
 /* Change the timeslice */
 void m68k_modify_timeslice(int cycles)
 {
@@ -1030,7 +1168,8 @@ void m68k_modify_timeslice(int cycles)
 
 void m68k_end_timeslice(void)
 {
-	m68ki_initial_cycles = GET_CYCLES();
+	/* Keep m68k_execute's return value as the cycles actually used */
+	m68ki_initial_cycles -= GET_CYCLES();
 	SET_CYCLES(0);
 }
 
@@ -1104,8 +1243,18 @@ void m68k_pulse_bus_error(void)
 /* Pulse the RESET line on the CPU */
 void m68k_pulse_reset(void)
 {
+	uint i;
+
 	/* Disable the PMMU on reset */
 	m68ki_cpu.pmmu_enabled = 0;
+	m68ki_cpu.mmu_tc &= ~0x80000000;
+	pmmu_atc_flush();
+	m68ki_cpu.mmu_atc_hits = 0;
+	m68ki_cpu.mmu_atc_misses = 0;
+
+	/* Start counting from zero */
+	for (i = 0; i < 16; i++)
+		m68ki_cpu.instr_count[i] = 0;
 
 	/* Clear all stop levels and eat up all remaining cycles */
 	CPU_STOPPED = 0;
@@ -551,6 +551,23 @@ typedef uint32 uint64;
 	#define m68ki_instr_hook(pc)
 #endif /* M68K_INSTRUCTION_HOOK */
 
+#if M68K_DECODE_CACHE
+	#if M68K_EMULATE_PREFETCH || M68K_EMULATE_ADDRESS_ERROR
+		#error "M68K_DECODE_CACHE can't be used with prefetch or address error emulation"
+	#endif
+	#if M68K_DECODE_CACHE == OPT_SPECIFY_HANDLER
+		#define m68ki_decode_cache_page(A) M68K_DECODE_CACHE_PAGE_CALLBACK(A)
+	#else
+		#define m68ki_decode_cache_page(A) 1
+	#endif
+#endif /* M68K_DECODE_CACHE */
+
+#if M68K_COUNT_INSTRUCTIONS
+	#define m68ki_count_instruction() m68ki_cpu.instr_count[REG_IR >> 12]++
+#else
+	#define m68ki_count_instruction()
+#endif /* M68K_COUNT_INSTRUCTIONS */
+
 #if M68K_MONITOR_PC
 	#if M68K_MONITOR_PC == OPT_SPECIFY_HANDLER
 		#define m68ki_pc_changed(A) M68K_SET_PC_CALLBACK(ADDRESS_68K(A))
@@ -667,6 +684,25 @@ extern jmp_buf m68ki_aerr_trap;
 	#define m68ki_check_address_error_010_less(ADDR, WRITE_MODE, FC)
 #endif /* M68K_ADDRESS_ERROR */
 
+/* Bus error register rollback */
+#if M68K_EMULATE_BUS_ERROR
+	#define m68ki_save_da_regs() \
+		do { \
+			int i_; \
+			for (i_ = 15; i_ >= 0; i_--) \
+				REG_DA_SAVE[i_] = REG_DA[i_]; \
+		} while (0)
+	#define m68ki_restore_da_regs() \
+		do { \
+			int i_; \
+			for (i_ = 15; i_ >= 0; i_--) \
+				REG_DA[i_] = REG_DA_SAVE[i_]; \
+		} while (0)
+#else
+	#define m68ki_save_da_regs()
+	#define m68ki_restore_da_regs()
+#endif /* M68K_EMULATE_BUS_ERROR */
+
 /* Logging */
 #if M68K_LOG_ENABLE
 	#include <stdio.h>
@@ -923,6 +959,17 @@ typedef union
 	double f;
 } fp_reg;
 
+/* PMMU address translation cache (direct mapped, power of two entries) */
+#define M68K_PMMU_ATC_SIZE 64
+
+typedef struct
+{
+	uint valid;
+	uint super;     /* Supervisor bit the translation was made with */
+	uint logical;   /* Logical page number */
+	uint physical;  /* Physical address of the start of the page */
+} m68ki_atc_entry;
+
 typedef struct
 {
 	uint cpu_type;     /* CPU Type: 68000, 68008, 68010, 68EC020, 68020, 68EC030, 68030, 68EC040, or 68040 */
@@ -986,6 +1033,15 @@ typedef struct
 	uint mmu_tc;
 	uint16 mmu_sr;
 
+	/* PMMU address translation cache */
+	m68ki_atc_entry mmu_atc[M68K_PMMU_ATC_SIZE];
+	uint mmu_atc_shift;  /* log2 of the page size it caches, 0 if disabled */
+	unsigned long long mmu_atc_hits;
+	unsigned long long mmu_atc_misses;
+
+	/* Instructions executed, by opcode group */
+	unsigned long long instr_count[16];
+
 	const uint8* cyc_instruction;
 	const uint8* cyc_exception;
 
@@ -1914,8 +1970,6 @@ extern jmp_buf m68ki_bus_error_jmp_buf;
 /* Exception for bus error */
 static inline void m68ki_exception_bus_error(void)
 {
-	int i;
-
 	/* If we were processing a bus error, address error, or reset,
 	 * while writing the stack frame, this is a catastrophic failure.
 	 * Halt the CPU
@@ -1931,9 +1985,7 @@ static inline void m68ki_exception_bus_error(void)
 	/* Use up some clock cycles and undo the instruction's cycles */
 	USE_CYCLES(CYC_EXCEPTION[EXCEPTION_BUS_ERROR] - CYC_INSTRUCTION[REG_IR]);
 
-	for (i = 15; i >= 0; i--){
-		REG_DA[i] = REG_DA_SAVE[i];
-	}
+	m68ki_restore_da_regs(); /* auto-disable (see m68kcpu.h) */
 
 	uint sr = m68ki_init_exception();
 
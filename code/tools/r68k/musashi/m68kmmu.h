@@ -8,9 +8,30 @@
 */
 
 /*
-	pmmu_translate_addr: perform 68851/68030-style PMMU address translation
+	pmmu_atc_flush: invalidate the address translation cache, and work out
+	the page size it should cache at from the current TC. That's the number
+	of address bits below the last table index, so every translation the
+	table walk can produce is linear within one cached page.
 */
-uint pmmu_translate_addr(uint addr_in)
+void pmmu_atc_flush(void)
+{
+	uint i, indexbits;
+
+	for (i = 0; i < M68K_PMMU_ATC_SIZE; i++)
+	{
+		m68ki_cpu.mmu_atc[i].valid = 0;
+	}
+
+	indexbits = ((m68ki_cpu.mmu_tc>>16) & 0xf) + ((m68ki_cpu.mmu_tc>>12) & 0xf)
+			  + ((m68ki_cpu.mmu_tc>>8) & 0xf) + ((m68ki_cpu.mmu_tc>>4) & 0xf);
+
+	m68ki_cpu.mmu_atc_shift = (indexbits > 0 && indexbits < 32) ? 32 - indexbits : 0;
+}
+
+/*
+	pmmu_walk_tables: perform 68851/68030-style PMMU address translation
+*/
+static uint pmmu_walk_tables(uint addr_in)
 {
 	uint32 addr_out, tbl_entry = 0, tbl_entry2, tamode = 0, tbmode = 0, tcmode = 0;
 	uint root_aptr, root_limit, tofs, is, abits, bbits, cbits;
@@ -171,6 +192,42 @@ uint pmmu_translate_addr(uint addr_in)
 	return addr_out;
 }
 
+/*
+	pmmu_translate_addr: translate through the ATC, walking the tables on a miss
+*/
+uint pmmu_translate_addr(uint addr_in)
+{
+	uint shift = m68ki_cpu.mmu_atc_shift;
+	uint super = FLAG_S ? 1 : 0;
+	uint page, offset, addr_out;
+	m68ki_atc_entry *entry;
+
+	if (!shift)
+	{
+		return pmmu_walk_tables(addr_in);
+	}
+
+	page = addr_in >> shift;
+	offset = addr_in & ((1 << shift) - 1);
+	entry = &m68ki_cpu.mmu_atc[(page ^ (page >> 6)) & (M68K_PMMU_ATC_SIZE - 1)];
+
+	if (entry->valid && entry->logical == page && entry->super == super)
+	{
+		m68ki_cpu.mmu_atc_hits++;
+		return entry->physical + offset;
+	}
+
+	m68ki_cpu.mmu_atc_misses++;
+	addr_out = pmmu_walk_tables(addr_in);
+
+	entry->valid = 1;
+	entry->super = super;
+	entry->logical = page;
+	entry->physical = addr_out - offset;
+
+	return addr_out;
+}
+
 /*
 
 	m68881_mmu_ops: COP 0 MMU opcode handling
@@ -208,12 +265,13 @@ void m68881_mmu_ops(void)
 				}
 				else if ((modes & 0xe200) == 0x2000)	// PFLUSH
 				{
-					fprintf(stderr,"680x0: unhandled PFLUSH PC=%x\n", REG_PC);
+					// No selective flush, just drop the whole ATC
+					pmmu_atc_flush();
 					return;
 				}
 				else if (modes == 0xa000)	// PFLUSHR
 				{
-					fprintf(stderr,"680x0: unhandled PFLUSHR\n");
+					pmmu_atc_flush();
 					return;
 				}
 				else if (modes == 0x2800)	// PVALID (FORMAT 1)
@@ -273,18 +331,21 @@ void m68881_mmu_ops(void)
 										{
 											m68ki_cpu.pmmu_enabled = 0;
 										}
+										pmmu_atc_flush();
 										break;
 
 									case 2:	// supervisor root pointer
 										temp64 = READ_EA_64(ea);
 										m68ki_cpu.mmu_srp_limit = (temp64>>32) & 0xffffffff;
 										m68ki_cpu.mmu_srp_aptr = temp64 & 0xffffffff;
+										pmmu_atc_flush();
 										break;
 
 									case 3:	// CPU root pointer
 										temp64 = READ_EA_64(ea);
 										m68ki_cpu.mmu_crp_limit = (temp64>>32) & 0xffffffff;
 										m68ki_cpu.mmu_crp_aptr = temp64 & 0xffffffff;
+										pmmu_atc_flush();
 										break;
 
 									default:
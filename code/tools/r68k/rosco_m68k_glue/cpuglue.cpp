@@ -11,11 +11,17 @@ extern "C" {
 #endif
 
 extern rosco::m68k::emu::AddressDecoder *sys_mem;
+extern bool decode_cache_enabled;
 
 void resetMachineHandler() {
     sys_mem->reset();
 }
 
+/* Musashi wants to cache decoded code from a page; watch it for writes */
+int decode_cache_page_handler(unsigned int address) {
+    return decode_cache_enabled && sys_mem->WatchPage(address);
+}
+
 void instructionHook() {
 	m68ki_cpu_core ctx;
 	m68k_get_context(&ctx);